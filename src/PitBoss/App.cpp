@@ -1,14 +1,20 @@
 #include <SPIFFS.h>
 #include <PitBoss/App.h>
 #include <PitBoss/TimeHelper.h>
-#include <PitBoss/TemperatureHelper.h>
+#include <PitBoss/Temperature.h>
+#if CONFIG_PM_ENABLE
+#include <driver/gpio.h>
+#endif
 
 namespace PitBoss {
 
 void App::setup() {
+  this->_bootedAt = esp_timer_get_time();
   Serial.begin(App::BAUD_RATE);
+  this->_scheduler.begin();
   this->_display.setup();
   this->initLog();
+  this->initHeapMonitor();
   this->setState(ApplicationStates::State::BOOTING);
   if (!this->initSPIFFS()) {
     this->_log->fatal(F("Unable to initialize SPIFFS."));
@@ -20,11 +26,14 @@ void App::setup() {
     this->setState(ApplicationStates::State::FATAL_ERROR);
     return;
   }
+  this->_display.setBusClock(this->_config.displayI2cClock);
   this->initButton();
   this->initWebServer();
   this->initNtp();
   this->initWifi();
+  this->initTelemetry();
   this->initThermocouple();
+  this->initTasks();
 }
 
 void App::initLog() {
@@ -42,37 +51,211 @@ bool App::initSPIFFS() {
   return SPIFFS.begin(false);
 }
 
+/**
+ * Parses the config file in place: the document's strings point into
+ * _configBody, and the config copies out what it keeps.
+ */
 bool App::initConfig() {
+  // A reset between saveConfig()'s remove and rename leaves only the new one.
+  if (!SPIFFS.exists(App::DEFAULT_CONFIG_FILE_PATH) && SPIFFS.exists(App::CONFIG_TEMP_FILE_PATH)) {
+    SPIFFS.rename(App::CONFIG_TEMP_FILE_PATH, App::DEFAULT_CONFIG_FILE_PATH);
+  }
   File configFile = SPIFFS.open(App::DEFAULT_CONFIG_FILE_PATH);
-  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> configJson;
-  String configBuffer;
   if (configFile) {
-    while (configFile.available()) {
-      configBuffer += configFile.readString();
-    }
-    DeserializationError err = deserializeJson(configJson, configBuffer);
-    if (err == DeserializationError::Ok) {
-      auto errors = this->_config.fromJson(configJson);
-      if (!errors.empty()) {
-        for (const auto& it : errors) {
-          const String& expectString(it);
-          this->_log->fatal(F("Config error: %s"), expectString.c_str());
-        }
-        return false;
-      }
-    } else {
+    size_t length = configFile.read(reinterpret_cast<uint8_t*>(this->_configBody), sizeof(this->_configBody));
+    if (configFile.available()) {
+      this->_log->fatal(F("Config file larger than %d bytes"), Config::CONFIG_FILE_MAX_SIZE);
+      return false;
+    }
+    StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> configJson;
+    DeserializationError err = deserializeJson(configJson, this->_configBody, length);
+    if (err != DeserializationError::Ok) {
       this->_log->fatal(F("Unable to parse config file: %s"), err.c_str());
       return false;
     }
+    ConfigErrors errors;
+    this->_config.fromJson(configJson.as<JsonObjectConst>(), errors);
+    for (size_t i = 0; i < errors.count; i++) {
+      this->_log->fatal(F("Config error: %s"), errors.messages[i]);
+    }
+    if (!errors.empty()) {
+      return false;
+    }
   } else {
     this->_log->warning(F("Unable to locate config file, using defaults"));
   }
-  configBuffer.clear();
-  serializeJsonPretty(this->_config.toJson(), configBuffer);
-  this->_log->notice(F("Using config: \n%s"), configBuffer.c_str());
+  this->_bootConfig = this->_config;
+  this->_loopConfig = this->_config;
+  this->_uiConfig = this->_config;
+  this->_configSnapshot.publish(this->_config);
+  this->_loopConfigVersion = this->_configSnapshot.version();
+  this->_uiConfigVersion = this->_configSnapshot.version();
+  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> configJson;
+  this->_config.toJson(configJson);
+  serializeJsonPretty(configJson, this->_configBody, sizeof(this->_configBody));
+  this->_log->notice(F("Using config: \n%s"), this->_configBody);
   return true;
 }
 
+/**
+ * {"logLevel":4,"wifiCountry":"US","ntpServer":"pool.ntp.org",...}
+ *
+ * X-Restart-Required is set while fields that are only read at boot differ
+ * from what the firmware booted with.
+ */
+void App::sendConfig(AsyncWebServerRequest* request) {
+  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json;
+  this->_config.toJson(json);
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(200);
+  if (this->_bootConfig.changes(this->_config) & ConfigSubsystems::Subsystem::RESTART) {
+    response->addHeader("X-Restart-Required", "true");
+  }
+  auto bytesWritten = serializeJson(json, *response);
+  if (bytesWritten == 0) {
+    delete response;
+    this->_log->error(F("Serialization failure."));
+    request->send(500);
+    return;
+  }
+  request->send(response);
+}
+
+// Collects a POST /config body, which may arrive in several pieces.
+void App::receiveConfig(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+  if (index == 0) {
+    this->_configBodyRequest = request;
+    this->_configBodyLength = 0;
+  }
+  if (this->_configBodyRequest != request || total > sizeof(this->_configBody)) {
+    return;
+  }
+  memcpy(this->_configBody + index, data, len);
+  this->_configBodyLength = index + len;
+}
+
+// The received body over the current config, or false having sent why not.
+bool App::parseConfig(AsyncWebServerRequest* request, Config& config) {
+  bool received = this->_configBodyRequest == request;
+  this->_configBodyRequest = nullptr;
+  if (request->contentLength() > sizeof(this->_configBody)) {
+    request->send(413, "text/plain", "Config too large");
+    return false;
+  }
+  if (!received) {
+    request->send(400, "text/plain", "Expected a JSON object");
+    return false;
+  }
+  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json;
+  auto err = deserializeJson(json, this->_configBody, this->_configBodyLength);
+  if (err != DeserializationError::Ok || !json.is<JsonObject>()) {
+    request->send(400, "text/plain", err != DeserializationError::Ok ? err.c_str() : "Expected a JSON object");
+    return false;
+  }
+  config = this->_config;
+  ConfigErrors errors;
+  config.fromJson(json.as<JsonObjectConst>(), errors);
+  if (!errors.empty()) {
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    response->setCode(400);
+    for (size_t i = 0; i < errors.count; i++) {
+      response->println(errors.messages[i]);
+    }
+    request->send(response);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * POST /config takes any of the keys GET /config returns and leaves the rest
+ * as they are. A valid config is saved, then published for the loop and UI
+ * tasks to re-apply what changed; the read interval, chip selects and WiFi
+ * country only apply after a restart.
+ */
+void App::updateConfig(AsyncWebServerRequest* request) {
+  Config config;
+  if (!this->parseConfig(request, config)) {
+    return;
+  }
+  if (!this->saveConfig(config)) {
+    request->send(500, "text/plain", "Unable to save config");
+    return;
+  }
+  this->_config = config;
+  this->_configSnapshot.publish(config);
+  this->_scheduler.wake();
+  this->_uiScheduler.wake();
+  this->_log->notice(F("Config updated."));
+  this->sendConfig(request);
+}
+
+bool App::saveConfig(const Config& config) {
+  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json;
+  config.toJson(json);
+  File file = SPIFFS.open(App::CONFIG_TEMP_FILE_PATH, FILE_WRITE);
+  if (!file || serializeJsonPretty(json, file) == 0) {
+    this->_log->error(F("Unable to write config file."));
+    return false;
+  }
+  file.close();
+  SPIFFS.remove(App::DEFAULT_CONFIG_FILE_PATH);
+  if (!SPIFFS.rename(App::CONFIG_TEMP_FILE_PATH, App::DEFAULT_CONFIG_FILE_PATH)) {
+    this->_log->error(F("Unable to replace config file."));
+    return false;
+  }
+  return true;
+}
+
+// What POST /config changed, on the loop task.
+void App::applyConfig() {
+  auto version = this->_configSnapshot.version();
+  if (version == this->_loopConfigVersion) {
+    return;
+  }
+  Config config;
+  bool torn;
+  while (!this->_configSnapshot.tryRead(config, torn)) {
+    // Preempted the web server mid-publish; let it finish.
+    vTaskDelay(1);
+  }
+  auto changes = this->_loopConfig.changes(config);
+  if (changes & ConfigSubsystems::Subsystem::LOG) {
+    this->_log->setLevel(config.logLevel);
+  }
+  if (changes & ConfigSubsystems::Subsystem::TELEMETRY) {
+    this->configureTelemetry(config);
+  }
+  if ((changes & ConfigSubsystems::Subsystem::SAMPLING)
+      && !this->_thermocouple.updateFilter(config.filter, config.thermocoupleOversampling)) {
+    this->_log->error(F("Sampling update queue full, filter config not applied."));
+  }
+  this->_loopConfig = config;
+  this->_loopConfigVersion = version;
+}
+
+// What POST /config changed, on the UI task.
+void App::applyUiConfig() {
+  auto version = this->_configSnapshot.version();
+  if (version == this->_uiConfigVersion) {
+    return;
+  }
+  Config config;
+  bool torn;
+  while (!this->_configSnapshot.tryRead(config, torn)) {
+    vTaskDelay(1);
+  }
+  auto changes = this->_uiConfig.changes(config);
+  this->_uiConfig = config;
+  this->_uiConfigVersion = version;
+  if (changes & ConfigSubsystems::Subsystem::DISPLAY) {
+    this->_display.setBusClock(config.displayI2cClock);
+  }
+  if ((changes & ConfigSubsystems::Subsystem::NTP) && this->_state == ApplicationStates::State::READY) {
+    this->configureNtp(config);
+  }
+}
+
 void App::initButton() {
   this->_button.begin();
   this->_display.onState(StatefulDisplayStates::State::ON, [this](){
@@ -86,54 +269,108 @@ void App::initButton() {
       .DelayAfter(5000);
   });
   esp_sleep_enable_ext0_wakeup(App::POWER_BUTTON_PIN,0);
+  attachInterruptArg(digitalPinToInterrupt(App::POWER_BUTTON_PIN), App::onButtonInterrupt, this, CHANGE);
+#if CONFIG_PM_ENABLE
+  // Edge interrupts are not delivered in light sleep; the level wakes it.
+  gpio_wakeup_enable(App::POWER_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+void IRAM_ATTR App::onButtonInterrupt(void* arg) {
+  static_cast<App*>(arg)->_uiScheduler.wakeFromISR();
+}
+
+void App::initHeapMonitor() {
+  for (auto name : ProcessSites::NAMES) {
+    this->_heapMonitor.addSite(name, true);
+  }
+  this->onState(ApplicationStates::State::READY, [this](){
+    this->_heapMonitor.settleAfter(App::HEAP_SETTLE_MS);
+  });
+  HeapMonitor::arm();
+}
+
+/**
+ * Registers a handler whose allocations the heap monitor counts, and whose
+ * latency /metrics reports, per request. The latency is the handler's own:
+ * streamed responses go out after it returns.
+ */
+void App::route(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction handler,
+                ArBodyHandlerFunction body) {
+  auto site = this->_heapMonitor.addSite(uri, false);
+  if (this->_routeCount == App::MAX_ROUTES) {
+    this->_log->error(F("Route table full, %s not measured."), uri);
+    this->_webServer.on(uri, method, [this, site, handler](AsyncWebServerRequest *request){
+      HeapMonitor::Scope scope(this->_heapMonitor, site);
+      handler(request);
+    }, nullptr, body);
+    return;
+  }
+  auto& metrics = this->_routes[this->_routeCount++];
+  metrics.uri = uri;
+  metrics.method = method;
+  this->_webServer.on(uri, method, [this, site, &metrics, handler](AsyncWebServerRequest *request){
+    HeapMonitor::Scope scope(this->_heapMonitor, site);
+    Histogram::Timer timer(metrics.latency);
+    handler(request);
+  }, nullptr, body);
 }
 
 void App::initWebServer() {
   this->_webServer.onNotFound([](AsyncWebServerRequest *request){
-    Log.notice("404");
+    SystemLog.notice("404");
   });
-  this->_webServer.on("/", [](AsyncWebServerRequest *request){
+  this->route("/", HTTP_ANY, [](AsyncWebServerRequest *request){
     request->redirect("/temperature");
   });
-  this->_webServer.on("/temperature", HTTP_GET, [this](AsyncWebServerRequest *request){
-    double coldJunction = 0;
-    double hotJunction = 0;
-    if (!this->_thermocouple.readThermocouple(coldJunction, hotJunction)) {
-      request->send(500);
-      return;
+  this->_thermocouple.onSample([this](const ThermocoupleSample& sample){
+    this->renderTemperature(sample);
+  });
+  this->route("/temperature", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendTemperature(request);
+  });
+  this->route("/events", HTTP_GET, [this](AsyncWebServerRequest *request){
+    request->send(this->_events.subscribe(request));
+  });
+  this->route("/history", HTTP_GET, [this](AsyncWebServerRequest *request){
+    uint32_t since = 0;
+    uint32_t step = 1;
+    if (request->hasParam("since")) {
+      since = request->getParam("since")->value().toInt();
     }
-    AsyncResponseStream *response = request->beginResponseStream("application/json");
-    StaticJsonDocument<256> json;
-    json["time"] = getTime();
-    json["coldJunction"] = celsiusToFarenheit(coldJunction);
-    json["hotJunction"] = celsiusToFarenheit(hotJunction);
-    auto debug = json.createNestedObject("debug");
-    debug["heap"] = ESP.getFreeHeap();
-    debug["rssi"] = this->_wifi.getSignalStrength();
-    debug["ssid"] = this->_wifi.getSSID();
-    response->setCode(200);
-    auto bytesWritten = serializeJson(json, *response);
-    if (bytesWritten == 0) {
-      this->_log->error(F("Serialization failure."));
-      request->send(500);
-      return;
+    if (request->hasParam("step")) {
+      step = std::max(1L, request->getParam("step")->value().toInt());
     }
-    request->send(response);
+    request->send(this->beginHistoryResponse(request, since, step));
   });
-  this->_webServer.on("/config", HTTP_GET, [this](AsyncWebServerRequest *request){
-    AsyncResponseStream *response = request->beginResponseStream("application/json");
-    auto config = this->_config.toJson();
-    response->setCode(200);
-    auto bytesWritten = serializeJson(config, *response);
-    if (bytesWritten == 0) {
-      this->_log->error(F("Serialization failure."));
-      request->send(500);
-      return;
+  this->route("/log", HTTP_GET, [this](AsyncWebServerRequest *request){
+    uint64_t fromMs = 0;
+    uint64_t toMs = UINT64_MAX;
+    if (request->hasParam("from")) {
+      fromMs = strtoull(request->getParam("from")->value().c_str(), nullptr, 10);
     }
-    request->send(response);
+    if (request->hasParam("to")) {
+      toMs = strtoull(request->getParam("to")->value().c_str(), nullptr, 10);
+    }
+    request->send(this->beginLogResponse(request, fromMs, toMs));
+  });
+  this->route("/calibration", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendCalibration(request);
+  });
+  this->route("/calibration", HTTP_POST, [this](AsyncWebServerRequest *request){
+    this->captureCalibration(request);
+  });
+  this->route("/calibration", HTTP_DELETE, [this](AsyncWebServerRequest *request){
+    this->clearCalibration(request);
   });
-  this->_webServer.on("/config", HTTP_POST, [this](AsyncWebServerRequest *request){
-    request->send(501, "text/plain", "Not implemented");
+  this->route("/config", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendConfig(request);
+  });
+  this->route("/config", HTTP_POST, [this](AsyncWebServerRequest *request){
+    this->updateConfig(request);
+  }, [this](AsyncWebServerRequest *request, uint8_t* data, size_t len, size_t index, size_t total){
+    this->receiveConfig(request, data, len, index, total);
   });
   this->onState(ApplicationStates::State::READY, [this](){
     this->_log->notice(F("Starting web server"));
@@ -148,20 +385,50 @@ void App::initWebServer() {
 
 void App::initNtp() {
   this->onState(ApplicationStates::State::READY, [this](){
-    if (!this->_config.ntpServer.equals(Config::DEFAULT_NTP_SERVER)) {
-      configTime(this->_config.gmtOffset, this->_config.dstOffset, this->_config.ntpServer.c_str(), Config::DEFAULT_NTP_SERVER, WiFi.gatewayIP().toString().c_str());
-    } else {
-      configTime(this->_config.gmtOffset, this->_config.dstOffset, Config::DEFAULT_NTP_SERVER, WiFi.gatewayIP().toString().c_str());
-    }
+    this->configureNtp(this->_uiConfig);
     this->_log->notice(F("Got time: %s"), getTime().c_str());
     this->_display.startTime();
   });
 }
 
+void App::configureNtp(const Config& config) {
+  if (strcmp(config.ntpServer, Config::DEFAULT_NTP_SERVER) != 0) {
+    configTime(config.gmtOffset, config.dstOffset, config.ntpServer, Config::DEFAULT_NTP_SERVER, WiFi.gatewayIP().toString().c_str());
+  } else {
+    configTime(config.gmtOffset, config.dstOffset, Config::DEFAULT_NTP_SERVER, WiFi.gatewayIP().toString().c_str());
+  }
+}
+
+// The probes stay as they were at boot.
+void App::configureTelemetry(const Config& config) {
+  this->_telemetry.configure(
+    (uint32_t) (ESP.getEfuseMac() >> 16),
+    config.telemetryPort,
+    config.telemetryInterval,
+    config.telemetryBatch,
+    this->_bootConfig.thermocoupleProbes
+  );
+}
+
+void App::initTelemetry() {
+  this->configureTelemetry(this->_config);
+  this->_wifi.onState(StatefulWiFiStates::State::CONNECTED, [this](){
+    this->sendCommand(SensingCommands::Command::ENABLE_TELEMETRY);
+  });
+  this->_wifi.onState(StatefulWiFiStates::State::DISCONNECTED, [this](){
+    this->sendCommand(SensingCommands::Command::DISABLE_TELEMETRY);
+  });
+  this->_thermocouple.onSample([this](const ThermocoupleSample& sample){
+    this->_telemetry.append(sample);
+  });
+}
+
 void App::initWifi() {
+  WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info){
+    this->_uiScheduler.wake();
+  });
   this->_wifi.onState(StatefulWiFiStates::State::CONNECTED, [this](){
     this->setState(ApplicationStates::State::READY);
-    this->_udp.connect(WiFi.localIP(), 8888);
     this->_display.updateWiFi(StatefulWiFiStates::State::CONNECTED,
                               WiFi.localIP(),
                               this->_wifi.getSSID(),
@@ -179,24 +446,491 @@ void App::initWifi() {
     this->setState(ApplicationStates::State::FATAL_ERROR);
     this->_display.updateWiFi(StatefulWiFiStates::State::ERROR);
   });
+  // Only as the signal moves, rather than asking the driver every pass.
+  this->_wifi.onLinkChange([this](const LinkEvent& event){
+    this->publishNetworkStatus();
+    if (event.level != LinkLevels::Level::DOWN) {
+      this->_display.updateWiFi(StatefulWiFiStates::State::CONNECTED,
+                                WiFi.localIP(),
+                                this->_wifi.getSSID(),
+                                event.quality);
+    }
+    if (!this->_linkEvents.push(event)) {
+      this->_log->warning(F("Link event queue full, dropped a link event."));
+    }
+    this->_scheduler.wake();
+  });
+  this->_wifi.configureCountry(this->_config.wifiCountry);
   this->_wifi.setup();
 }
 
+/**
+ * Renders /temperature once per sample on the loop task; requests until the
+ * next sample are served the same bytes.
+ */
+void App::renderTemperature(const ThermocoupleSample& sample) {
+  TemperatureResponse response;
+  response.sequence = sample.sequence;
+  size_t faulted = 0;
+  for (size_t i = 0; i < sample.probes; i++) {
+    if (sample.frames[i].faults()) {
+      faulted++;
+    }
+  }
+  if (faulted == sample.probes) {
+    response.code = 500;
+    response.length = snprintf(response.body, sizeof(response.body), "%s", MAX31855Frame::describe(sample.frames[0].faults()));
+    this->_temperatureResponse.publish(response);
+    return;
+  }
+  char time[64];
+  // Formatted in place, as ArduinoJson would copy them otherwise.
+  char temperatures[ThermocoupleSample::MAX_PROBES][3][16];
+  formatTime(time, sizeof(time), "%c", ::time(nullptr));
+  StaticJsonDocument<App::TEMPERATURE_RESPONSE_SIZE> json;
+  json["time"] = time;
+  auto probes = json.createNestedArray("probes");
+  for (size_t i = 0; i < sample.probes; i++) {
+    auto probe = probes.createNestedObject();
+    auto& frame = sample.frames[i];
+    auto faults = frame.faults();
+    if (faults) {
+      probe["fault"] = MAX31855Frame::describe(faults);
+      continue;
+    }
+    frame.coldJunction().to<TemperatureUnits::Fahrenheit>().format(temperatures[i][0], sizeof(temperatures[i][0]));
+    sample.hotJunctions[i].to<TemperatureUnits::Fahrenheit>().format(temperatures[i][1], sizeof(temperatures[i][1]));
+    frame.hotJunction().to<TemperatureUnits::Fahrenheit>().format(temperatures[i][2], sizeof(temperatures[i][2]));
+    probe["coldJunction"] = serialized((const char*) temperatures[i][0]);
+    probe["hotJunction"] = serialized((const char*) temperatures[i][1]);
+    probe["rawHotJunction"] = serialized((const char*) temperatures[i][2]);
+  }
+  // The pit probe's, as before there were others.
+  if (sample.frames[0].faults()) {
+    json["fault"] = MAX31855Frame::describe(sample.frames[0].faults());
+  } else {
+    json["coldJunction"] = serialized((const char*) temperatures[0][0]);
+    json["hotJunction"] = serialized((const char*) temperatures[0][1]);
+    json["rawHotJunction"] = serialized((const char*) temperatures[0][2]);
+  }
+  auto debug = json.createNestedObject("debug");
+  debug["heap"] = ESP.getFreeHeap();
+  NetworkStatus networkStatus = {};
+  this->_networkStatus.read(networkStatus);
+  debug["rssi"] = networkStatus.signalStrength;
+  debug["ssid"] = networkStatus.ssid;
+  auto samplingStats = this->_thermocouple.getSamplingStats();
+  auto sampling = debug.createNestedObject("sampling");
+  sampling["samples"] = samplingStats.samples;
+  sampling["reads"] = samplingStats.reads;
+  sampling["missedDeadlines"] = samplingStats.missedDeadlines;
+  sampling["droppedSamples"] = samplingStats.droppedSamples;
+  sampling["maxJitterUs"] = samplingStats.maxJitterUs;
+  FilterStageStats filterStats[ThermocoupleFilter::STAGES];
+  auto stages = this->_thermocouple.getFilterStats(filterStats, ThermocoupleFilter::STAGES);
+  auto filter = debug.createNestedObject("filter");
+  for (size_t i = 0; i < stages; i++) {
+    if (filterStats[i].enabled) {
+      filter[filterStats[i].name] = filterStats[i].meanCycles;
+    }
+  }
+  auto dutyCycleStats = this->_scheduler.getStats();
+  auto dutyCycle = debug.createNestedObject("dutyCycle");
+  dutyCycle["wakeups"] = dutyCycleStats.wakeups;
+  dutyCycle["awakeUs"] = dutyCycleStats.awakeUs;
+  dutyCycle["asleepUs"] = dutyCycleStats.asleepUs;
+  response.code = 200;
+  response.length = serializeJson(json, response.body, sizeof(response.body));
+  if (response.length == 0 || response.length >= sizeof(response.body) - 1) {
+    this->_log->error(F("Serialization failure."));
+    response.code = 500;
+    response.length = 0;
+  }
+  this->_temperatureResponse.publish(response);
+}
+
+/**
+ * Serves the cached render with an ETag of the sample it came from, so
+ * clients polling faster than the read interval get a 304 instead.
+ */
+void App::sendTemperature(AsyncWebServerRequest* request) {
+  TemperatureResponse cached;
+  bool torn;
+  while (!this->_temperatureResponse.tryRead(cached, torn)) {
+    if (!torn) {
+      request->send(503, "text/plain", "Thermocouple not sampled yet");
+      return;
+    }
+    // Preempted the loop task mid-render; let it finish.
+    vTaskDelay(1);
+  }
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long) this->_bootNonce, (unsigned long) cached.sequence);
+  AsyncWebServerResponse* response;
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+    response = request->beginResponse(304);
+  } else {
+    cached.body[cached.length] = '\0';
+    response = request->beginResponse(cached.code, cached.code == 200 ? "application/json" : "text/plain", cached.body);
+  }
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
+
+/**
+ * Compact JSON for one sample, as pushed to /events subscribers:
+ *
+ * {"timestamp":123456,"coldJunction":66.31,"hotJunction":230.90,"rawHotJunction":231.35,
+ *  "probes":[{"coldJunction":66.31,"hotJunction":230.90,"rawHotJunction":231.35},
+ *            {"fault":"thermocouple open circuit"}]}
+ *
+ * The timestamp is milliseconds since boot; hotJunction is filtered. The
+ * top-level temperatures (or fault) are the pit probe's, probes[0].
+ */
+size_t App::serializeSample(const ThermocoupleSample& sample, char* buffer, size_t size) {
+  auto timestampMs = (unsigned long) (sample.timestamp / 1000);
+  size_t n = snprintf(buffer, size, "{\"timestamp\":%lu,", timestampMs);
+  size_t length = n < size ? App::serializeProbe(sample, 0, buffer + n, size - n) : 0;
+  if (!length) {
+    return 0;
+  }
+  n += length;
+  n += snprintf(buffer + n, size - n, ",\"probes\":[");
+  for (size_t i = 0; i < sample.probes; i++) {
+    if (n + 2 >= size) {
+      return 0;
+    }
+    if (i) {
+      buffer[n++] = ',';
+    }
+    buffer[n++] = '{';
+    length = App::serializeProbe(sample, i, buffer + n, size - n);
+    if (!length || n + length + 1 >= size) {
+      return 0;
+    }
+    n += length;
+    buffer[n++] = '}';
+  }
+  if (n + 3 > size) {
+    return 0;
+  }
+  n += snprintf(buffer + n, size - n, "]}");
+  return n;
+}
+
+/**
+ * The fields of one probe of a sample, without braces; 0 if they do not fit:
+ *
+ * "coldJunction":66.31,"hotJunction":230.90,"rawHotJunction":231.35
+ * "fault":"thermocouple open circuit"
+ */
+size_t App::serializeProbe(const ThermocoupleSample& sample, size_t probe, char* buffer, size_t size) {
+  static const size_t MAX_TEMPERATURES_LENGTH = 72;
+  auto& frame = sample.frames[probe];
+  auto faults = frame.faults();
+  if (faults) {
+    size_t n = snprintf(buffer, size, "\"fault\":\"%s\"", MAX31855Frame::describe(faults));
+    return n < size ? n : 0;
+  }
+  if (size < MAX_TEMPERATURES_LENGTH) {
+    return 0;
+  }
+  size_t n = snprintf(buffer, size, "\"coldJunction\":");
+  n += frame.coldJunction().to<TemperatureUnits::Fahrenheit>().format(buffer + n, size - n);
+  n += snprintf(buffer + n, size - n, ",\"hotJunction\":");
+  n += sample.hotJunctions[probe].to<TemperatureUnits::Fahrenheit>().format(buffer + n, size - n);
+  n += snprintf(buffer + n, size - n, ",\"rawHotJunction\":");
+  n += frame.hotJunction().to<TemperatureUnits::Fahrenheit>().format(buffer + n, size - n);
+  return n;
+}
+
+/**
+ * Streams the history as it is read out of the ring, one chunk at a time:
+ *
+ * {"interval":2000,"bootEpoch":1615037000,"next":123456,
+ *  "samples":[[121456,225.50,66.31],[123456,null,null]]}
+ *
+ * Sample timestamps are milliseconds since boot (add bootEpoch * 1000 for
+ * wall time once NTP has synced, otherwise bootEpoch is 0). Temperatures are
+ * hot then cold junction in Farenheit, null for a fault or missed sample.
+ * Passing "next" back as `since` fetches only what is new.
+ */
+AsyncWebServerResponse* App::beginHistoryResponse(AsyncWebServerRequest* request, uint32_t since, uint32_t step) {
+  static const size_t MAX_HEADER_LENGTH = 96;
+  static const size_t MAX_SAMPLE_LENGTH = 40;
+  const TemperatureHistory* history = &this->_history;
+  uint32_t end = history->end();
+  uint32_t cursor = std::max(history->begin(), history->sequenceAt(since));
+  time_t now = time(nullptr);
+  unsigned long bootEpoch = now > MIN_VALID_EPOCH ? now - millis() / 1000 : 0;
+  bool headerSent = false;
+  bool footerSent = false;
+  bool firstSample = true;
+  return request->beginChunkedResponse("application/json", [=](uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+    auto out = reinterpret_cast<char*>(buffer);
+    size_t n = 0;
+    if (!headerSent) {
+      if (maxLen < MAX_HEADER_LENGTH) {
+        return 0;
+      }
+      n += snprintf(out, maxLen, "{\"interval\":%lu,\"bootEpoch\":%lu,\"next\":%lu,\"samples\":[",
+                    (unsigned long) history->intervalMs(), bootEpoch, (unsigned long) history->timestampMs(end));
+      headerSent = true;
+    }
+    while (cursor < end && maxLen - n > MAX_SAMPLE_LENGTH) {
+      TemperatureHistory::Record record;
+      if (!history->read(cursor, record)) {
+        // Lapped by the writer while streaming; resume at the oldest record.
+        auto oldest = history->begin();
+        if (cursor >= oldest) {
+          break;
+        }
+        cursor = oldest;
+        continue;
+      }
+      n += snprintf(out + n, maxLen - n, firstSample ? "[%lu," : ",[%lu,", (unsigned long) history->timestampMs(cursor));
+      firstSample = false;
+      if (record.valid()) {
+        n += MAX31855Frame::hotJunctionFromRaw(record.hotJunction).to<TemperatureUnits::Fahrenheit>().format(out + n, maxLen - n);
+        out[n++] = ',';
+        n += MAX31855Frame::coldJunctionFromRaw(record.coldJunctionRaw()).to<TemperatureUnits::Fahrenheit>().format(out + n, maxLen - n);
+        out[n++] = ']';
+      } else {
+        n += snprintf(out + n, maxLen - n, "null,null]");
+      }
+      cursor += step;
+    }
+    if (cursor >= end && !footerSent && maxLen - n >= 2) {
+      out[n++] = ']';
+      out[n++] = '}';
+      footerSent = true;
+    }
+    return n;
+  });
+}
+
+/**
+ * Exports the on-flash log as CSV, decoding one segment at a time:
+ *
+ * timestamp,hotJunction,coldJunction
+ * 1615037000000,230.90,66.31
+ *
+ * Timestamps are milliseconds since the epoch, or since that boot for
+ * samples taken before NTP synced. Faulted samples have empty temperatures.
+ */
+AsyncWebServerResponse* App::beginLogResponse(AsyncWebServerRequest* request, uint64_t fromMs, uint64_t toMs) {
+  static const size_t MAX_ROW_LENGTH = 48;
+  auto scanner = std::make_shared<TemperatureLog::Scanner>(this->_temperatureLog.scan(fromMs, toMs));
+  bool headerSent = false;
+  return request->beginChunkedResponse("text/csv", [=](uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+    auto out = reinterpret_cast<char*>(buffer);
+    size_t n = 0;
+    if (!headerSent) {
+      n += snprintf(out, maxLen, "timestamp,hotJunction,coldJunction\n");
+      headerSent = true;
+    }
+    TemperatureLog::Entry entry;
+    while (maxLen - n > MAX_ROW_LENGTH && scanner->next(entry)) {
+      n += snprintf(out + n, maxLen - n, "%llu,", (unsigned long long) entry.timestampMs);
+      if (entry.faults == MAX31855Faults::Fault::NONE) {
+        n += MAX31855Frame::hotJunctionFromRaw(entry.hotJunction).to<TemperatureUnits::Fahrenheit>().format(out + n, maxLen - n);
+        out[n++] = ',';
+        n += MAX31855Frame::coldJunctionFromRaw(entry.coldJunction).to<TemperatureUnits::Fahrenheit>().format(out + n, maxLen - n);
+      } else {
+        out[n++] = ',';
+      }
+      out[n++] = '\n';
+    }
+    return n;
+  });
+}
+
 void App::initThermocouple() {
+  if (!this->_history.begin(this->_config.thermocoupleReadInterval)) {
+    this->_log->error(F("Unable to allocate temperature history."));
+  }
+  this->_temperatureLog.begin(this->_config.thermocoupleReadInterval);
+  this->_thermocouple.configureReadInterval(this->_config.thermocoupleReadInterval);
+  this->_thermocouple.configureProbes(this->_config.thermocoupleCsPins, this->_config.thermocoupleProbes);
+  this->loadCalibration();
+  for (size_t i = 0; i < this->_thermocouple.getProbeCount(); i++) {
+    this->_thermocouple.configureCalibration(i, this->_calibrations[i]);
+  }
+  this->_thermocouple.configureFilter(this->_config.filter, this->_config.thermocoupleOversampling);
+  this->_thermocouple.onSample([this](const ThermocoupleSample& sample){
+    this->_history.append(sample);
+    this->_temperatureLog.append(sample);
+    char data[EventStream::MAX_EVENT_SIZE];
+    if (App::serializeSample(sample, data, sizeof(data))) {
+      this->_events.publish("temperature", data);
+    }
+  });
+  this->_thermocouple.onSampleQueued([this](){
+    this->_scheduler.wake();
+  });
   this->_thermocouple.onState(StatefulThermocoupleStates::State::READY, [this](){
     if (this->_thermocouple.getPreviousState() == StatefulThermocoupleStates::State::ERROR) {
       this->_log->notice(F("Thermocouple has been reconnected."));
     }
-    this->setState(this->_wifi.getState() == StatefulWiFiStates::State::CONNECTED ? ApplicationStates::State::READY : ApplicationStates::State::DISCONNECTED);
+    this->_thermocoupleStates.push(StatefulThermocoupleStates::State::READY);
+    this->_uiScheduler.wake();
   });
   this->_thermocouple.onState(StatefulThermocoupleStates::State::ERROR, [this](){
-    this->_log->notice(F("Thermocouple has been disconnected. Will continue polling for reconnection."));
-    this->setState(ApplicationStates::State::THERMOCOUPLE_ERROR);
-    this->_display.updateThermocouple(StatefulThermocoupleStates::State::ERROR);
+    this->_log->notice(F("Thermocouple fault: %s. Will continue polling for reconnection."), MAX31855Frame::describe(this->_thermocouple.getFaults()));
+    this->_thermocoupleStates.push(StatefulThermocoupleStates::State::ERROR);
+    this->_uiScheduler.wake();
   });
   this->_thermocouple.setup();
 }
 
+/**
+ * Calibration is kept apart from the config, as it is captured on the device
+ * rather than written by hand:
+ *
+ * {"probes":[{"nist":true,"points":[[0.25,0.00],[99.50,100.00]]},{"nist":false,"points":[]}]}
+ *
+ * Points are [measured, actual] in Celsius, measured after the NIST
+ * correction if it is on.
+ */
+void App::loadCalibration() {
+  File file = SPIFFS.open(App::CALIBRATION_FILE_PATH);
+  if (!file) {
+    return;
+  }
+  String buffer;
+  while (file.available()) {
+    buffer += file.readString();
+  }
+  StaticJsonDocument<App::CALIBRATION_FILE_MAX_SIZE> json;
+  auto err = deserializeJson(json, buffer);
+  if (err != DeserializationError::Ok) {
+    this->_log->error(F("Unable to parse calibration file: %s"), err.c_str());
+    return;
+  }
+  JsonArray probes = json["probes"].as<JsonArray>();
+  for (size_t i = 0; i < probes.size() && i < ThermocoupleSample::MAX_PROBES; i++) {
+    auto& calibration = this->_calibrations[i];
+    calibration.nist = probes[i]["nist"].as<bool>();
+    JsonArray points = probes[i]["points"].as<JsonArray>();
+    for (size_t j = 0; j < points.size(); j++) {
+      if (!calibration.add(CalibrationPoint{
+        Celsius::fromCentiDegrees(lroundf(points[j][0].as<float>() * 100)).scaled(),
+        Celsius::fromCentiDegrees(lroundf(points[j][1].as<float>() * 100)).scaled()
+      })) {
+        this->_log->error(F("Probe %u: too many calibration points, keeping %u."), i, ProbeCalibration::MAX_POINTS);
+        break;
+      }
+    }
+    if (calibration.enabled()) {
+      this->_log->notice(F("Probe %u: %u calibration points%s."), i, calibration.points, calibration.nist ? ", NIST corrected" : "");
+    }
+  }
+}
+
+void App::calibrationToJson(StaticJsonDocument<App::CALIBRATION_FILE_MAX_SIZE>& json) {
+  auto probes = json.createNestedArray("probes");
+  for (size_t i = 0; i < this->_thermocouple.getProbeCount(); i++) {
+    const auto& calibration = this->_calibrations[i];
+    auto probe = probes.createNestedObject();
+    probe["nist"] = calibration.nist;
+    auto points = probe.createNestedArray("points");
+    for (size_t j = 0; j < calibration.points; j++) {
+      auto point = points.createNestedArray();
+      point.add(Celsius::fromScaled(calibration.point[j].measured).centiDegrees() / 100.0);
+      point.add(Celsius::fromScaled(calibration.point[j].actual).centiDegrees() / 100.0);
+    }
+  }
+}
+
+bool App::saveCalibration() {
+  StaticJsonDocument<App::CALIBRATION_FILE_MAX_SIZE> json;
+  this->calibrationToJson(json);
+  File file = SPIFFS.open(App::CALIBRATION_FILE_PATH, FILE_WRITE);
+  if (!file || serializeJson(json, file) == 0) {
+    this->_log->error(F("Unable to write calibration file."));
+    return false;
+  }
+  return true;
+}
+
+void App::sendCalibration(AsyncWebServerRequest* request) {
+  StaticJsonDocument<App::CALIBRATION_FILE_MAX_SIZE> json;
+  this->calibrationToJson(json);
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(200);
+  serializeJson(json, *response);
+  request->send(response);
+}
+
+/**
+ * POST /calibration?probe=n&actual=c records the probe's newest reading as
+ * having been c Celsius; hold it at a known temperature (an ice bath, boiling
+ * water) until it settles first. ?nist=true or false turns the NIST
+ * correction on or off instead, which drops the probe's points, as they were
+ * measured the other way.
+ */
+void App::captureCalibration(AsyncWebServerRequest* request) {
+  size_t probe = request->hasParam("probe") ? request->getParam("probe")->value().toInt() : 0;
+  if (probe >= this->_thermocouple.getProbeCount()) {
+    request->send(400, "text/plain", "No such probe");
+    return;
+  }
+  ProbeCalibration calibration = this->_calibrations[probe];
+  if (request->hasParam("nist")) {
+    calibration = ProbeCalibration();
+    calibration.nist = request->getParam("nist")->value() == "true";
+  } else if (request->hasParam("actual")) {
+    ThermocoupleSample sample;
+    if (!this->_thermocouple.getSnapshot(sample) || sample.frames[probe].faults()) {
+      request->send(409, "text/plain", "Probe not reading");
+      return;
+    }
+    auto& frame = sample.frames[probe];
+    double measured = calibration.linearize(
+      (double) frame.hotJunction().scaled() / Celsius::SCALE,
+      (double) frame.coldJunction().scaled() / Celsius::SCALE
+    );
+    double actual = request->getParam("actual")->value().toFloat();
+    if (!calibration.add(CalibrationPoint{(int32_t) lround(measured * Celsius::SCALE), (int32_t) lround(actual * Celsius::SCALE)})) {
+      request->send(409, "text/plain", "Calibration full");
+      return;
+    }
+  } else {
+    request->send(400, "text/plain", "Expected actual or nist");
+    return;
+  }
+  if (!this->_thermocouple.updateCalibration(probe, calibration)) {
+    request->send(503, "text/plain", "Calibration busy");
+    return;
+  }
+  this->_calibrations[probe] = calibration;
+  if (!this->saveCalibration()) {
+    request->send(500, "text/plain", "Unable to save calibration");
+    return;
+  }
+  this->sendCalibration(request);
+}
+
+// DELETE /calibration?probe=n returns the probe to the MAX31855's own reading.
+void App::clearCalibration(AsyncWebServerRequest* request) {
+  size_t probe = request->hasParam("probe") ? request->getParam("probe")->value().toInt() : 0;
+  if (probe >= this->_thermocouple.getProbeCount()) {
+    request->send(400, "text/plain", "No such probe");
+    return;
+  }
+  if (!this->_thermocouple.updateCalibration(probe, ProbeCalibration())) {
+    request->send(503, "text/plain", "Calibration busy");
+    return;
+  }
+  this->_calibrations[probe] = ProbeCalibration();
+  if (!this->saveCalibration()) {
+    request->send(500, "text/plain", "Unable to save calibration");
+    return;
+  }
+  this->sendCalibration(request);
+}
+
 void App::splashScreen() {
   auto splashFile = SPIFFS.open(App::SPLASH_PATH);
   String splashBuffer;
@@ -208,33 +942,174 @@ void App::splashScreen() {
   }
 }
 
+void App::initTasks() {
+  this->_sensingTask = xTaskGetCurrentTaskHandle();
+  this->_uiScheduler.begin();
+  this->publishNetworkStatus();
+  xTaskCreatePinnedToCore(
+    App::uiTask,
+    "ui",
+    App::UI_TASK_STACK,
+    this,
+    App::UI_TASK_PRIORITY,
+    &this->_uiTask,
+    App::UI_TASK_CORE
+  );
+  this->route("/tasks", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendTasks(request);
+  });
+  this->route("/heap", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendHeap(request);
+  });
+  this->route("/wifi", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendWifi(request);
+  });
+  this->route("/metrics", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendMetrics(request);
+  });
+  this->route("/logs", HTTP_GET, [this](AsyncWebServerRequest *request){
+    this->sendLogs(request);
+  });
+}
+
+// Only from the UI task, or during setup() before it starts.
+void App::sendCommand(SensingCommands::Command command) {
+  if (!this->_commands.push(command)) {
+    this->_log->error(F("Sensing command queue full, dropped command %d."), command);
+  }
+  this->_scheduler.wake();
+}
+
+void App::processCommands() {
+  SensingCommands::Command command;
+  while (this->_commands.pop(command)) {
+    switch (command) {
+      case SensingCommands::Command::ENABLE_TELEMETRY:
+        this->_telemetry.setEnabled(true);
+        if (auto sent = SleepLog::drain()) {
+          this->_log->notice(F("Sent %u readings logged while asleep."), (unsigned) sent);
+        }
+        break;
+      case SensingCommands::Command::DISABLE_TELEMETRY:
+        this->_telemetry.setEnabled(false);
+        break;
+      case SensingCommands::Command::DEEP_SLEEP:
+        this->_temperatureLog.flush();
+        if (SleepLog::enter(this->_loopConfig, this->_bootConfig.thermocoupleCsPins, this->_bootConfig.thermocoupleProbes,
+                            App::POWER_BUTTON_PIN, this->_history.end())) {
+          this->_log->notice(F("Logging every %d ms while asleep."), this->_loopConfig.sleepLogInterval);
+        }
+        this->_log->flush(App::LOG_FLUSH_TIMEOUT_MS);
+        esp_deep_sleep_start();
+      case SensingCommands::Command::RESTART:
+        this->_temperatureLog.flush();
+        this->_log->flush(App::LOG_FLUSH_TIMEOUT_MS);
+        ESP.restart();
+    }
+  }
+}
+
+/**
+ * As a wifi event, e.g.
+ *
+ * {"level":"good","rssi":-61,"quality":78,"degraded":false}
+ */
+void App::processLinkEvents() {
+  LinkEvent event;
+  while (this->_linkEvents.pop(event)) {
+    char data[96];
+    snprintf(data, sizeof(data), "{\"level\":\"%s\",\"rssi\":%d,\"quality\":%u,\"degraded\":%s}",
+             LinkLevels::NAMES[event.level], event.rssi, event.quality, event.degraded ? "true" : "false");
+    this->_events.publish("wifi", data);
+  }
+}
+
+// The sensing side, on the loop task.
 void App::process() {
+  Histogram::Timer loopTimer(this->_loopTime);
+  {
+    HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::COMMANDS);
+    Histogram::Timer timer(this->_processTimes[ProcessSites::Site::COMMANDS]);
+    this->processCommands();
+    this->processLinkEvents();
+    this->applyConfig();
+  }
+  HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::THERMOCOUPLE);
+  Histogram::Timer timer(this->_processTimes[ProcessSites::Site::THERMOCOUPLE]);
+  this->_thermocouple.process();
+}
+
+void App::uiTask(void* parameters) {
+  auto self = static_cast<App*>(parameters);
+  for (;;) {
+    self->processUi();
+    self->_uiScheduler.sleepUntil(self->getNextUiDeadline());
+  }
+}
+
+void App::processThermocoupleState(StatefulThermocoupleStates::State state) {
+  this->_thermocoupleState = state;
+  if (state == StatefulThermocoupleStates::State::READY) {
+    this->setState(this->_wifi.getState() == StatefulWiFiStates::State::CONNECTED ? ApplicationStates::State::READY : ApplicationStates::State::DISCONNECTED);
+  } else {
+    this->setState(ApplicationStates::State::THERMOCOUPLE_ERROR);
+    this->_display.updateThermocouple(StatefulThermocoupleStates::State::ERROR);
+  }
+}
+
+void App::publishNetworkStatus() {
+  NetworkStatus status;
+  status.signalStrength = this->_wifi.getSignalStrength();
+  snprintf(status.ssid, sizeof(status.ssid), "%s", this->_wifi.getSSID());
+  this->_networkStatus.publish(status);
+}
+
+// WiFi, display, LED and button, on the UI task.
+void App::processUi() {
   if (this->_state == ApplicationStates::State::FATAL_ERROR) {
     return;
   }
-  this->_powerLED.Update();
-  this->_thermocouple.process();
-  this->_wifi.process();
-  if (this->_wifi.getState() == StatefulWiFiStates::State::CONNECTED) {
-    this->_display.updateWiFi(
-      StatefulWiFiStates::State::CONNECTED,
-      WiFi.localIP(),
-      this->_wifi.getSSID(),
-      this->_wifi.getSignalStrength()
-    );
-    this->_udp.broadcast("wazzap");
-  }
-  if (this->_thermocouple.getState() == StatefulThermocoupleStates::State::READY) {
-    double coldJunction;
-    double hotJunction;
-    this->_thermocouple.getTemperatures(coldJunction, hotJunction);
-    this->_display.updateThermocouple(
-      StatefulThermocoupleStates::State::READY,
-      coldJunction,
-      hotJunction
-    );
+  Histogram::Timer loopTimer(this->_uiLoopTime);
+  {
+    HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::UI_EVENTS);
+    Histogram::Timer timer(this->_processTimes[ProcessSites::Site::UI_EVENTS]);
+    StatefulThermocoupleStates::State thermocoupleState;
+    while (this->_thermocoupleStates.pop(thermocoupleState)) {
+      this->processThermocoupleState(thermocoupleState);
+    }
+    this->applyUiConfig();
   }
-  this->_display.process();
+  {
+    HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::LED);
+    Histogram::Timer timer(this->_processTimes[ProcessSites::Site::LED]);
+    this->_powerLED.Update();
+  }
+  {
+    HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::WIFI);
+    Histogram::Timer timer(this->_processTimes[ProcessSites::Site::WIFI]);
+    this->_wifi.process();
+  }
+  {
+    HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::DISPLAY);
+    Histogram::Timer timer(this->_processTimes[ProcessSites::Site::DISPLAY]);
+    Celsius coldJunction;
+    Celsius hotJunction;
+    if (this->_thermocoupleState == StatefulThermocoupleStates::State::READY
+        && this->_thermocouple.getTemperatures(coldJunction, hotJunction)) {
+      this->_display.updateThermocouple(
+        StatefulThermocoupleStates::State::READY,
+        coldJunction,
+        hotJunction
+      );
+    }
+    for (size_t i = 1; i < this->_thermocouple.getProbeCount(); i++) {
+      bool ready = this->_thermocouple.getTemperatures(coldJunction, hotJunction, i);
+      this->_display.updateProbe(i, ready, hotJunction);
+    }
+    this->_display.process();
+  }
+  HeapMonitor::Scope scope(this->_heapMonitor, ProcessSites::Site::BUTTON);
+  Histogram::Timer timer(this->_processTimes[ProcessSites::Site::BUTTON]);
   this->_button.read();
   if (this->_button.isPressed()) {
     if (this->_display.getState() == StatefulDisplayStates::State::OFF) {
@@ -248,13 +1123,320 @@ void App::process() {
     this->_sleepEnable = false;
     this->_log->notice(F("Going to sleep."));
     this->_display.sleep();
-    esp_deep_sleep_start();
+    this->sendCommand(SensingCommands::Command::DEEP_SLEEP);
   }
   if (this->_button.pressedFor(App::LONG_PRESS_MS)) {
     this->_log->notice(F("Resetting."));
     this->_wifi.forgetSSID();
-    ESP.restart();
+    this->sendCommand(SensingCommands::Command::RESTART);
+    // The sensing task restarts; stay out of its way until it does.
+    vTaskSuspend(nullptr);
+  }
+}
+
+/**
+ * Per-task stack and CPU figures for sizing. CPU load counts the time each
+ * task was not waiting, so it includes time it was preempted by higher
+ * priority tasks on its core.
+ */
+size_t App::getTaskStats(TaskStats* stats, size_t size) const {
+  struct {
+    TaskHandle_t handle;
+    uint64_t busyUs;
+  } tasks[] = {
+    {this->_thermocouple.getSamplingTask(), this->_thermocouple.getSamplingBusyMicros()},
+    {this->_sensingTask, this->_scheduler.getStats().awakeUs},
+    {this->_uiTask, this->_uiScheduler.getStats().awakeUs},
+    {this->_display.getFlushTask(), this->_display.getStats().flushUs},
+  };
+  auto elapsedUs = std::max<int64_t>(1, esp_timer_get_time() - this->_bootedAt);
+  size_t n = 0;
+  for (const auto& task : tasks) {
+    if (!task.handle || n >= size) {
+      continue;
+    }
+    auto& out = stats[n++];
+    out.name = pcTaskGetName(task.handle);
+    out.core = xTaskGetAffinity(task.handle);
+    out.priority = uxTaskPriorityGet(task.handle);
+    out.stackFree = uxTaskGetStackHighWaterMark(task.handle);
+    out.cpuLoad = (uint16_t) std::min<uint64_t>(1000, task.busyUs * 1000 / elapsedUs);
+  }
+  return n;
+}
+
+/**
+ * {"uptimeMs":123456,"tasks":[{"name":"ui","core":0,"priority":2,
+ *  "stackFree":3120,"cpuLoad":1.2}]}
+ *
+ * cpuLoad is percent of one core since boot.
+ */
+void App::sendTasks(AsyncWebServerRequest* request) {
+  TaskStats stats[App::TASK_COUNT];
+  auto count = this->getTaskStats(stats, App::TASK_COUNT);
+  StaticJsonDocument<512> json;
+  json["uptimeMs"] = millis();
+  auto tasks = json.createNestedArray("tasks");
+  for (size_t i = 0; i < count; i++) {
+    auto task = tasks.createNestedObject();
+    task["name"] = stats[i].name;
+    task["core"] = stats[i].core;
+    task["priority"] = stats[i].priority;
+    task["stackFree"] = stats[i].stackFree;
+    task["cpuLoad"] = stats[i].cpuLoad / 10.0;
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(200);
+  serializeJson(json, *response);
+  request->send(response);
+}
+
+// Queued samples, commands and config updates wake the loop task as they
+// are posted.
+unsigned long App::getNextDeadline() {
+  if (!this->_commands.empty() || this->_configSnapshot.version() != this->_loopConfigVersion) {
+    return millis();
+  }
+  return this->_thermocouple.getNextDeadline();
+}
+
+/**
+ * Earliest millis() at which any part of processUi() has work. Thermocouple
+ * state changes, WiFi events and the button interrupt wake it early.
+ */
+unsigned long App::getNextUiDeadline() {
+  if (this->_state == ApplicationStates::State::FATAL_ERROR) {
+    return Process::IDLE;
+  }
+  unsigned long now = millis();
+  if (!this->_thermocoupleStates.empty() || this->_configSnapshot.version() != this->_uiConfigVersion) {
+    return now;
+  }
+  unsigned long deadline = this->_wifi.getNextDeadline();
+  deadline = LoopScheduler::earliest(deadline, this->_display.getNextDeadline(), now);
+  if (this->_powerLED.IsRunning()) {
+    deadline = LoopScheduler::earliest(deadline, now + App::LED_FRAME_MS, now);
+  }
+  if (this->_button.isPressed() || now - this->_button.lastChange() < App::BUTTON_SETTLE_MS) {
+    deadline = LoopScheduler::earliest(deadline, now + App::BUTTON_POLL_MS, now);
+  }
+  return deadline;
+}
+
+void App::idle() {
+  this->_scheduler.sleepUntil(this->getNextDeadline());
+}
+
+/**
+ * {"tracking":true,"settled":true,"freeHeap":181234,"minFreeHeap":170112,
+ *  "largestFreeBlock":110580,"sites":[{"name":"wifi","calls":52113,
+ *  "allocations":3,"steadyState":0}]}
+ *
+ * largestFreeBlock against freeHeap shows fragmentation; sites are only
+ * counted in builds with PITBOSS_HEAP_TRACKING.
+ */
+void App::sendHeap(AsyncWebServerRequest* request) {
+  HeapSiteStats stats[HeapMonitor::MAX_SITES];
+  auto count = this->_heapMonitor.getSiteStats(stats, HeapMonitor::MAX_SITES);
+  StaticJsonDocument<JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(HeapMonitor::MAX_SITES) + HeapMonitor::MAX_SITES * JSON_OBJECT_SIZE(4)> json;
+  json["tracking"] = HeapMonitor::TRACKING;
+  json["settled"] = this->_heapMonitor.isSettled();
+  json["freeHeap"] = ESP.getFreeHeap();
+  json["minFreeHeap"] = ESP.getMinFreeHeap();
+  json["largestFreeBlock"] = ESP.getMaxAllocHeap();
+  auto sites = json.createNestedArray("sites");
+  for (size_t i = 0; i < count; i++) {
+    auto site = sites.createNestedObject();
+    site["name"] = stats[i].name;
+    site["calls"] = stats[i].calls;
+    site["allocations"] = stats[i].allocations;
+    site["steadyState"] = stats[i].steadyStateAllocations;
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(200);
+  serializeJson(json, *response);
+  request->send(response);
+}
+
+/**
+ * The link as last sampled, with the smoothed RSSI of the last minute, e.g.
+ *
+ * {"ssid":"comcats-outside","level":"good","rssi":-61,"quality":78,
+ *  "degraded":false,"minRssi":-70,"maxRssi":-55,"averageRssi":-62,
+ *  "samples":1800,"proactiveReconnects":0,"history":[-62,-61,...]}
+ */
+void App::sendWifi(AsyncWebServerRequest* request) {
+  auto stats = this->_wifi.getLinkStats();
+  StaticJsonDocument<JSON_OBJECT_SIZE(11) + JSON_ARRAY_SIZE(LinkStats::HISTORY_SIZE)> json;
+  json["ssid"] = this->_wifi.getSSID();
+  json["level"] = LinkLevels::NAMES[stats.link.level];
+  json["rssi"] = stats.link.rssi;
+  json["quality"] = stats.link.quality;
+  json["degraded"] = stats.link.degraded;
+  json["minRssi"] = stats.minRssi;
+  json["maxRssi"] = stats.maxRssi;
+  json["averageRssi"] = stats.averageRssi;
+  json["samples"] = stats.samples;
+  json["proactiveReconnects"] = this->_wifi.getProactiveReconnects();
+  auto history = json.createNestedArray("history");
+  for (size_t i = 0; i < stats.historyLength; i++) {
+    history.add(stats.history[i]);
+  }
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->setCode(200);
+  serializeJson(json, *response);
+  request->send(response);
+}
+
+/**
+ * Counters and latency histograms in the Prometheus text format, e.g.
+ *
+ * pitboss_http_request_seconds_bucket{route="/temperature",method="GET",le="0.000256"} 40
+ *
+ * Every figure is kept as it happens in fixed counters, so a scrape only
+ * reads and prints them.
+ */
+void App::sendMetrics(AsyncWebServerRequest* request) {
+  auto methodName = [](WebRequestMethodComposite method){
+    switch (method) {
+      case HTTP_GET: return "GET";
+      case HTTP_POST: return "POST";
+      case HTTP_DELETE: return "DELETE";
+      case HTTP_PUT: return "PUT";
+      case HTTP_PATCH: return "PATCH";
+      default: return "ANY";
+    }
+  };
+  static const char* const FAULT_NAMES[ThermocoupleProbe::FAULT_TYPES] = {
+    "open_circuit", "short_to_gnd", "short_to_vcc", "no_response",
+  };
+  char labels[96];
+  AsyncResponseStream *response = request->beginResponseStream("text/plain; version=0.0.4");
+  response->setCode(200);
+  MetricsWriter metrics(*response);
+
+  metrics.describe("pitboss_uptime_seconds", "gauge", "Time since boot.");
+  metrics.value("pitboss_uptime_seconds", nullptr, (esp_timer_get_time() - this->_bootedAt) / 1000000);
+
+  metrics.describe("pitboss_loop_iteration_seconds", "histogram", "One pass of a task's loop, sleep excluded.");
+  metrics.histogram("pitboss_loop_iteration_seconds", "task=\"loop\"", this->_loopTime);
+  metrics.histogram("pitboss_loop_iteration_seconds", "task=\"ui\"", this->_uiLoopTime);
+
+  metrics.describe("pitboss_process_seconds", "histogram", "One call of a process within a loop pass.");
+  for (size_t i = 0; i < ProcessSites::COUNT; i++) {
+    snprintf(labels, sizeof(labels), "process=\"%s\"", ProcessSites::NAMES[i]);
+    metrics.histogram("pitboss_process_seconds", labels, this->_processTimes[i]);
+  }
+
+  metrics.describe("pitboss_spi_read_seconds", "histogram", "One SPI sweep of every thermocouple probe.");
+  metrics.histogram("pitboss_spi_read_seconds", nullptr, this->_thermocouple.getSpiLatency());
+
+  metrics.describe("pitboss_display_flush_seconds", "histogram", "One I2C transfer of a frame to the display.");
+  metrics.histogram("pitboss_display_flush_seconds", nullptr, this->_display.getFlushLatency());
+
+  metrics.describe("pitboss_http_request_seconds", "histogram", "Time in a route's handler.");
+  for (size_t i = 0; i < this->_routeCount; i++) {
+    const auto& route = this->_routes[i];
+    snprintf(labels, sizeof(labels), "route=\"%s\",method=\"%s\"", route.uri, methodName(route.method));
+    metrics.histogram("pitboss_http_request_seconds", labels, route.latency);
+  }
+
+  metrics.describe("pitboss_heap_free_bytes", "gauge", "Free heap.");
+  metrics.value("pitboss_heap_free_bytes", nullptr, ESP.getFreeHeap());
+  metrics.describe("pitboss_heap_min_free_bytes", "gauge", "Least free heap since boot.");
+  metrics.value("pitboss_heap_min_free_bytes", nullptr, ESP.getMinFreeHeap());
+  metrics.describe("pitboss_heap_largest_free_block_bytes", "gauge", "Largest block the heap can allocate.");
+  metrics.value("pitboss_heap_largest_free_block_bytes", nullptr, ESP.getMaxAllocHeap());
+
+  metrics.describe("pitboss_wifi_reconnects_total", "counter", "WiFi connections after the first.");
+  metrics.value("pitboss_wifi_reconnects_total", nullptr, this->_wifi.getReconnects());
+  auto wifi = this->_wifi.getConnectStats();
+  metrics.describe("pitboss_wifi_connects_total", "counter", "WiFi connections, by how they were made.");
+  for (size_t i = 0; i < WiFiConnectMethods::COUNT; i++) {
+    snprintf(labels, sizeof(labels), "method=\"%s\"", WiFiConnectMethods::NAMES[i]);
+    metrics.value("pitboss_wifi_connects_total", labels, wifi.connects[i]);
+  }
+  metrics.describe("pitboss_wifi_fallbacks_total", "counter", "Direct WiFi connects that timed out and scanned.");
+  metrics.value("pitboss_wifi_fallbacks_total", nullptr, wifi.fallbacks);
+  metrics.describe("pitboss_wifi_last_connect_milliseconds", "gauge", "From boot or a drop until the last connection.");
+  metrics.value("pitboss_wifi_last_connect_milliseconds", nullptr, wifi.lastConnectMs);
+  metrics.describe("pitboss_wifi_max_connect_milliseconds", "gauge", "Longest from boot or a drop until connected.");
+  metrics.value("pitboss_wifi_max_connect_milliseconds", nullptr, wifi.maxConnectMs);
+  metrics.describe("pitboss_wifi_connect_milliseconds_total", "counter", "Time spent connecting, over every connection.");
+  metrics.value("pitboss_wifi_connect_milliseconds_total", nullptr, wifi.totalConnectMs);
+  auto link = this->_wifi.getLinkStats();
+  metrics.describe("pitboss_wifi_rssi_dbm", "gauge", "Smoothed RSSI of the link, 0 while down.");
+  metrics.signedValue("pitboss_wifi_rssi_dbm", nullptr, link.link.rssi);
+  metrics.describe("pitboss_wifi_link_level", "gauge", "Link level: 0 down, 1 poor, 2 fair, 3 good, 4 excellent.");
+  metrics.value("pitboss_wifi_link_level", nullptr, link.link.level);
+  metrics.describe("pitboss_wifi_rssi_samples", "gauge", "RSSI samples of the current link.");
+  metrics.value("pitboss_wifi_rssi_samples", nullptr, link.samples);
+  metrics.describe("pitboss_wifi_proactive_reconnects_total", "counter", "Links dropped for having degraded.");
+  metrics.value("pitboss_wifi_proactive_reconnects_total", nullptr, this->_wifi.getProactiveReconnects());
+
+  auto sleepLog = SleepLog::getStats();
+  metrics.describe("pitboss_sleep_log_wakes_total", "counter", "Deep sleep wakes that logged a reading, by whether they uploaded.");
+  metrics.value("pitboss_sleep_log_wakes_total", "uplink=\"false\"", sleepLog.wakes - sleepLog.uplinkWakes);
+  metrics.value("pitboss_sleep_log_wakes_total", "uplink=\"true\"", sleepLog.uplinkWakes);
+  metrics.describe("pitboss_sleep_log_awake_microseconds_total", "counter", "Time from wake to sleep, by whether the wake uploaded.");
+  metrics.value("pitboss_sleep_log_awake_microseconds_total", "uplink=\"false\"", sleepLog.readingAwakeUs);
+  metrics.value("pitboss_sleep_log_awake_microseconds_total", "uplink=\"true\"", sleepLog.uplinkAwakeUs);
+  metrics.describe("pitboss_sleep_log_max_awake_microseconds", "gauge", "Longest wake that did not upload.");
+  metrics.value("pitboss_sleep_log_max_awake_microseconds", nullptr, sleepLog.maxReadingAwakeUs);
+  metrics.describe("pitboss_sleep_log_asleep_microseconds_total", "counter", "Time in deep sleep between logged readings.");
+  metrics.value("pitboss_sleep_log_asleep_microseconds_total", nullptr, sleepLog.asleepUs);
+  metrics.describe("pitboss_sleep_log_uplinks_total", "counter", "Batches of logged readings sent.");
+  metrics.value("pitboss_sleep_log_uplinks_total", nullptr, sleepLog.uplinks);
+  metrics.describe("pitboss_sleep_log_failed_uplinks_total", "counter", "Batches of logged readings that could not be sent.");
+  metrics.value("pitboss_sleep_log_failed_uplinks_total", nullptr, sleepLog.failedUplinks);
+  metrics.describe("pitboss_sleep_log_alarms_total", "counter", "Pit temperature crossing an alarm threshold while asleep.");
+  metrics.value("pitboss_sleep_log_alarms_total", nullptr, sleepLog.alarms);
+  metrics.describe("pitboss_sleep_log_dropped_total", "counter", "Logged readings overwritten before they were sent.");
+  metrics.value("pitboss_sleep_log_dropped_total", nullptr, sleepLog.dropped);
+  metrics.describe("pitboss_sleep_log_pending", "gauge", "Logged readings waiting to be sent.");
+  metrics.value("pitboss_sleep_log_pending", nullptr, sleepLog.pending);
+  metrics.describe("pitboss_sleep_log_energy_microjoules", "gauge", "Modelled energy per logged reading, awake and asleep.");
+  metrics.value("pitboss_sleep_log_energy_microjoules", "state=\"awake\"", sleepLog.wakes ? sleepLog.awakeEnergyUj / sleepLog.wakes : 0);
+  metrics.value("pitboss_sleep_log_energy_microjoules", "state=\"asleep\"", sleepLog.wakes ? sleepLog.asleepEnergyUj / sleepLog.wakes : 0);
+
+  metrics.describe("pitboss_log_records_total", "counter", "Log calls at or above the log level.");
+  metrics.value("pitboss_log_records_total", nullptr, this->_log->getRecords());
+  metrics.describe("pitboss_log_dropped_total", "counter", "Log records dropped because the ring was full.");
+  metrics.value("pitboss_log_dropped_total", nullptr, this->_log->getDropped());
+
+  metrics.describe("pitboss_thermocouple_faults_total", "counter", "Reads that faulted, by probe and fault.");
+  for (size_t i = 0; i < this->_thermocouple.getProbeCount(); i++) {
+    const auto& probe = this->_thermocouple.getProbe(i);
+    for (size_t fault = 0; fault < ThermocoupleProbe::FAULT_TYPES; fault++) {
+      snprintf(labels, sizeof(labels), "probe=\"%u\",type=\"%s\"", (unsigned) i, FAULT_NAMES[fault]);
+      metrics.value("pitboss_thermocouple_faults_total", labels, probe.getFaultCount(1 << fault));
+    }
   }
+  request->send(response);
 }
 
-}
\ No newline at end of file
+
+/**
+ * The log records still in the ring, oldest first, as they went to Serial
+ * but stamped with milliseconds since boot:
+ *
+ * 5012 N: Starting web server
+ *
+ * X-Log-Dropped counts the records lost to a full ring since boot.
+ */
+void App::sendLogs(AsyncWebServerRequest* request) {
+  char dropped[12];
+  snprintf(dropped, sizeof(dropped), "%lu", (unsigned long) this->_log->getDropped());
+  AsyncResponseStream *response = request->beginResponseStream("text/plain");
+  response->setCode(200);
+  response->addHeader("X-Log-Dropped", dropped);
+  auto position = this->_log->oldest();
+  while (this->_log->read(position, this->_logEntry)) {
+    response->printf("%lu %c: ", (unsigned long) this->_logEntry.record.timestampMs, AsyncLog::levelLetter(this->_logEntry.record.level));
+    this->_logEntry.printMessage(response);
+    response->print('\n');
+  }
+  request->send(response);
+}
+
+}
@@ -6,7 +6,6 @@
 #include <PitBoss/StatefulLED.h>
 #include <PitBoss/Stateful.h>
 #include <FS.h>
-#include <Adafruit_MAX31855.h>
 #include <vector>
 #include <map>
 #include <functional>
@@ -14,11 +13,22 @@
 #include <jled.h>
 #include <JC_Button_ESP.h>
 #include <ctime>
+#include <esp_system.h>
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
 #include <PitBoss/Process.h>
 #include <PitBoss/StatefulWiFi.h>
 #include "StatefulThermocouple.h"
+#include "TemperatureHistory.h"
+#include "TemperatureLog.h"
+#include "EventStream.h"
+#include "Snapshot.h"
+#include "Telemetry.h"
+#include "SleepLog.h"
+#include "LoopScheduler.h"
+#include "SpscQueue.h"
+#include "HeapMonitor.h"
+#include "Metrics.h"
 #include "Logger.h"
 #include "StatefulDisplay.h"
 #include "AsyncUDP.h"
@@ -35,11 +45,60 @@ enum State {
   FATAL_ERROR,
   THERMOCOUPLE_ERROR,
 };
+static const size_t COUNT = THERMOCOUPLE_ERROR + 1;
 
 }
 
+// Requests from the UI task to the sensing task.
+namespace SensingCommands {
+
+enum Command {
+  ENABLE_TELEMETRY,
+  DISABLE_TELEMETRY,
+  // Flush the temperature log, then sleep (logging, if configured) or restart.
+  DEEP_SLEEP,
+  RESTART,
+};
+
+}
+
+// Heap monitor sites for the processes, registered first and in this order.
+namespace ProcessSites {
+
+enum Site {
+  COMMANDS,
+  THERMOCOUPLE,
+  UI_EVENTS,
+  LED,
+  WIFI,
+  DISPLAY,
+  BUTTON,
+};
+static const size_t COUNT = BUTTON + 1;
+static const char* const NAMES[COUNT] = {"commands", "thermocouple", "ui events", "led", "wifi", "display", "button"};
+
+}
+
+struct TaskStats {
+  const char* name;
+  BaseType_t core;
+  UBaseType_t priority;
+  // Least stack ever left free, in bytes.
+  uint32_t stackFree;
+  // Share of the core the task has kept busy since boot, in tenths of a percent.
+  uint16_t cpuLoad;
+};
+
+/**
+ * The Arduino loop task is the sensing task: it consumes samples and keeps
+ * the history, log, events and telemetry, on the core the sampling task is
+ * pinned to. WiFi, the display, the LED and the button run on a UI task on
+ * the other core, next to the WiFi stack, so a slow portal call or display
+ * flush never holds up a sample. The two exchange state only through
+ * snapshots and SpscQueues, each woken by the other when it posts.
+ */
 class App :
-  public Stateful<ApplicationStates::State>,
+  public Stateful<ApplicationStates::State, ApplicationStates::COUNT>,
   public Process,
   public Logger
 {
@@ -55,36 +114,127 @@ class App :
   static const int LONG_PRESS_MS = 10 * 1000;
   static const gpio_num_t POWER_BUTTON_PIN = GPIO_NUM_0;
   static const gpio_num_t POWER_LED_PIN = GPIO_NUM_4;
+  // The button is polled while held and until it has settled after a change;
+  // otherwise its interrupt wakes the loop.
+  static const unsigned long BUTTON_POLL_MS = 10;
+  static const unsigned long BUTTON_SETTLE_MS = 50;
+  // JLed has no deadline of its own; effects are stepped at this rate.
+  static const unsigned long LED_FRAME_MS = 20;
 
-  static const gpio_num_t THERMOCOUPLE_CS_PIN = GPIO_NUM_5;
   static const int THERMOCOUPLE_STARTUP_DELAY_MS = 100;
 
   constexpr static const char* SPLASH_PATH = "/splash.txt";
   constexpr static const char* DEFAULT_CONFIG_FILE_PATH = "/config.json";
+  // Written whole, then renamed over the config.
+  constexpr static const char* CONFIG_TEMP_FILE_PATH = "/config.json.tmp";
+  constexpr static const char* CALIBRATION_FILE_PATH = "/calibration.json";
+  static const size_t CALIBRATION_FILE_MAX_SIZE = 2048;
   static const int SERVER_PORT = 80;
+  static const size_t TEMPERATURE_RESPONSE_SIZE = 1024;
 
+  static const uint32_t UI_TASK_STACK = 6144;
+  static const UBaseType_t UI_TASK_PRIORITY = 2;
+  static const BaseType_t UI_TASK_CORE = PRO_CPU_NUM;
+  static const size_t TASK_COUNT = 4;
+  // For the log to reach Serial before a restart or deep sleep.
+  static const unsigned long LOG_FLUSH_TIMEOUT_MS = 500;
+  // From first connecting until allocations count as steady state.
+  static const unsigned long HEAP_SETTLE_MS = 10 * 1000;
+  static const size_t MAX_ROUTES = 16;
+
+  // Requests served by one route() handler, and how long each took.
+  struct RouteMetrics {
+    const char* uri;
+    WebRequestMethodComposite method;
+    Histogram latency;
+  };
+
+  // /temperature as rendered for the newest sample, served until the next.
+  struct TemperatureResponse {
+    uint32_t sequence;
+    uint16_t code;
+    uint16_t length;
+    char body[TEMPERATURE_RESPONSE_SIZE];
+  };
+
+  // As accepted, owned by the web server once running; the tasks each take
+  // theirs from _configSnapshot.
   Config _config;
+  // As the firmware booted with, for the fields only a restart applies.
+  Config _bootConfig;
+  Snapshot<Config> _configSnapshot;
+  Config _loopConfig;
+  uint32_t _loopConfigVersion = 0;
+  Config _uiConfig;
+  uint32_t _uiConfigVersion = 0;
+  // The config file at boot, then POST /config bodies, one at a time.
+  char _configBody[Config::CONFIG_FILE_MAX_SIZE];
+  size_t _configBodyLength = 0;
+  AsyncWebServerRequest* _configBodyRequest = nullptr;
   StatefulWiFi _wifi;
   StatefulThermocouple _thermocouple;
+  // Owned by the web server once running.
+  ProbeCalibration _calibrations[ThermocoupleSample::MAX_PROBES];
+  LogEntry _logEntry;
+  TemperatureHistory _history;
+  TemperatureLog _temperatureLog;
+  EventStream _events;
+  Snapshot<TemperatureResponse> _temperatureResponse;
+  // What the UI task knows of the network, for the sensing task's renders.
+  struct NetworkStatus {
+    int signalStrength;
+    char ssid[33];
+  };
+
+  // Keeps ETags from one boot matching another's.
+  uint32_t _bootNonce = esp_random();
   AsyncWebServer _webServer;
   StatefulDisplay _display;
   Button _button;
   JLed _powerLED;
   boolean _sleepEnable = false;
   AsyncUDP _udp;
+  Telemetry _telemetry;
+  LoopScheduler _scheduler;
+  LoopScheduler _uiScheduler;
+  TaskHandle_t _sensingTask = nullptr;
+  TaskHandle_t _uiTask = nullptr;
+  int64_t _bootedAt = 0;
+  SpscQueue<SensingCommands::Command, 4> _commands;
+  // From the UI task, for the sensing task to publish as events.
+  SpscQueue<LinkEvent, 4> _linkEvents;
+  SpscQueue<StatefulThermocoupleStates::State, 4> _thermocoupleStates;
+  // The UI task's view of the thermocouple, fed from _thermocoupleStates.
+  StatefulThermocoupleStates::State _thermocoupleState = StatefulThermocoupleStates::State::ERROR;
+  Snapshot<NetworkStatus> _networkStatus;
+  HeapMonitor _heapMonitor;
+  Histogram _loopTime;
+  Histogram _uiLoopTime;
+  Histogram _processTimes[ProcessSites::COUNT];
+  RouteMetrics _routes[MAX_ROUTES];
+  size_t _routeCount = 0;
  public:
   void process() override;
   void setup() override;
+  unsigned long getNextDeadline() override;
+  // Sleeps the loop task until the next deadline or a wakeup event.
+  void idle();
+  DutyCycleStats getDutyCycleStats() const {
+    return this->_scheduler.getStats();
+  }
+  size_t getTaskStats(TaskStats* stats, size_t size) const;
 
   App() :
-    Logger(&Log),
+    Logger(&SystemLog),
     _config(),
-    _wifi(&Log, _config.logLevel > LOG_LEVEL_SILENT, _config.wifiCountry, "pitboss-"),
-    _thermocouple(&Log, THERMOCOUPLE_STARTUP_DELAY_MS, _config.thermocoupleReadInterval, THERMOCOUPLE_CS_PIN),
+    _wifi(&SystemLog, _config.logLevel > LOG_LEVEL_SILENT, _config.wifiCountry, "pitboss-"),
+    _thermocouple(&SystemLog, THERMOCOUPLE_STARTUP_DELAY_MS, _config.thermocoupleReadInterval),
     _webServer(SERVER_PORT),
     _display(DISPLAY_WIDTH, DISPLAY_HEIGHT, &Wire, DISPLAY_I2C_ADDRESS, SCREEN_TIMEOUT_MS),
     _button(POWER_BUTTON_PIN),
-    _powerLED(POWER_LED_PIN)
+    _powerLED(POWER_LED_PIN),
+    _telemetry(&_udp),
+    _heapMonitor(&SystemLog)
   {}
 
  protected:
@@ -93,10 +243,50 @@ class App :
   void initLog();
   bool initConfig();
   void initButton();
+  static void IRAM_ATTR onButtonInterrupt(void* arg);
+  void initHeapMonitor();
   void initWebServer();
+  void route(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction handler,
+             ArBodyHandlerFunction body = nullptr);
+  void sendConfig(AsyncWebServerRequest* request);
+  void receiveConfig(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total);
+  bool parseConfig(AsyncWebServerRequest* request, Config& config);
+  void updateConfig(AsyncWebServerRequest* request);
+  bool saveConfig(const Config& config);
+  void applyConfig();
+  void applyUiConfig();
+  void configureNtp(const Config& config);
+  void configureTelemetry(const Config& config);
   void initThermocouple();
+  void loadCalibration();
+  void calibrationToJson(StaticJsonDocument<App::CALIBRATION_FILE_MAX_SIZE>& json);
+  bool saveCalibration();
+  void sendCalibration(AsyncWebServerRequest* request);
+  void captureCalibration(AsyncWebServerRequest* request);
+  void clearCalibration(AsyncWebServerRequest* request);
+  AsyncWebServerResponse* beginHistoryResponse(AsyncWebServerRequest* request, uint32_t since, uint32_t step);
+  AsyncWebServerResponse* beginLogResponse(AsyncWebServerRequest* request, uint64_t fromMs, uint64_t toMs);
+  static size_t serializeSample(const ThermocoupleSample& sample, char* buffer, size_t size);
+  static size_t serializeProbe(const ThermocoupleSample& sample, size_t probe, char* buffer, size_t size);
+  void renderTemperature(const ThermocoupleSample& sample);
+  void sendTemperature(AsyncWebServerRequest* request);
   void initNtp();
   void initWifi();
+  void initTelemetry();
+  void initTasks();
+  void sendCommand(SensingCommands::Command command);
+  void processCommands();
+  void processLinkEvents();
+  static void uiTask(void* parameters);
+  virtual void processUi();
+  unsigned long getNextUiDeadline();
+  void processThermocoupleState(StatefulThermocoupleStates::State state);
+  void publishNetworkStatus();
+  void sendTasks(AsyncWebServerRequest* request);
+  void sendHeap(AsyncWebServerRequest* request);
+  void sendWifi(AsyncWebServerRequest* request);
+  void sendMetrics(AsyncWebServerRequest* request);
+  void sendLogs(AsyncWebServerRequest* request);
 
 };
 
@@ -0,0 +1,326 @@
+#include <PitBoss/AsyncLog.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace PitBoss {
+
+AsyncLog SystemLog;
+
+AsyncLog::AsyncLog() {
+  for (size_t i = 0; i < AsyncLog::CAPACITY; i++) {
+    this->_slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+void AsyncLog::begin(int level, Print* output, bool showLevel) {
+  this->_output = output;
+  this->_showLevel = showLevel;
+  this->_level = level;
+  if (!this->_drainTask) {
+    xTaskCreatePinnedToCore(
+      AsyncLog::drainTask,
+      "log",
+      AsyncLog::DRAIN_TASK_STACK,
+      this,
+      AsyncLog::DRAIN_TASK_PRIORITY,
+      &this->_drainTask,
+      AsyncLog::DRAIN_TASK_CORE
+    );
+  }
+}
+
+void AsyncLog::commit(LogRecord& record, const char** strings) {
+  size_t lengths[LogRecord::MAX_ARGUMENTS] = {};
+  size_t length = 0;
+  for (size_t i = 0; i < record.arguments; i++) {
+    if (record.types[i] != LogArgumentTypes::Type::STRING) {
+      continue;
+    }
+    if (length == LogEntry::MAX_TEXT) {
+      // No room left: point at the previous string's terminator instead.
+      record.argument[i].string = length - 1;
+      continue;
+    }
+    lengths[i] = strnlen(strings[i], LogEntry::MAX_TEXT - length - 1);
+    record.argument[i].string = length;
+    length += lengths[i] + 1;
+  }
+  record.textLength = length;
+  record.slots = 1 + (length + AsyncLog::TEXT_BYTES - 1) / AsyncLog::TEXT_BYTES;
+  this->_records++;
+
+  // Claims the slots if the last is free for this lap, in which case the
+  // drain task has released every one before it too.
+  uint32_t position = this->_head.load(std::memory_order_relaxed);
+  for (;;) {
+    uint32_t last = position + record.slots - 1;
+    auto sequence = this->slot(last).sequence.load(std::memory_order_acquire);
+    auto lag = (int32_t) (sequence - last);
+    if (lag == 0) {
+      if (this->_head.compare_exchange_weak(position, position + record.slots, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      this->_dropped++;
+      return;
+    } else {
+      position = this->_head.load(std::memory_order_relaxed);
+    }
+  }
+  // Orders the claim before the writes, for read().
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t words[AsyncLog::SLOT_WORDS];
+  for (size_t s = 1; s < record.slots; s++) {
+    memset(words, 0, sizeof(words));
+    auto text = reinterpret_cast<char*>(words + 1);
+    size_t from = (s - 1) * AsyncLog::TEXT_BYTES;
+    size_t to = from + AsyncLog::TEXT_BYTES;
+    for (size_t i = 0; i < record.arguments; i++) {
+      if (record.types[i] != LogArgumentTypes::Type::STRING || !lengths[i]) {
+        continue;
+      }
+      size_t start = record.argument[i].string;
+      size_t end = start + lengths[i];
+      if (end <= from || start >= to) {
+        continue;
+      }
+      size_t skip = start < from ? from - start : 0;
+      size_t offset = start > from ? start - from : 0;
+      memcpy(text + offset, strings[i] + skip, std::min(end, to) - std::max(start, from));
+    }
+    auto& slot = this->slot(position + s);
+    for (size_t w = 0; w < AsyncLog::SLOT_WORDS; w++) {
+      slot.words[w].store(words[w], std::memory_order_relaxed);
+    }
+    slot.sequence.store(position + s + 1, std::memory_order_release);
+  }
+  // The header last, so the drain task finds the text written.
+  memset(words, 0, sizeof(words));
+  memcpy(words, &record, sizeof(record));
+  auto& header = this->slot(position);
+  for (size_t w = 0; w < AsyncLog::SLOT_WORDS; w++) {
+    header.words[w].store(words[w], std::memory_order_relaxed);
+  }
+  header.sequence.store(position + 1, std::memory_order_release);
+  if (this->_drainTask) {
+    xTaskNotifyGive(this->_drainTask);
+  }
+}
+
+void AsyncLog::copy(uint32_t position, LogEntry& entry) const {
+  uint32_t words[AsyncLog::SLOT_WORDS];
+  const auto& header = this->slot(position);
+  for (size_t w = 0; w < AsyncLog::SLOT_WORDS; w++) {
+    words[w] = header.words[w].load(std::memory_order_relaxed);
+  }
+  memcpy(&entry.record, words, sizeof(entry.record));
+  size_t slots = std::min<size_t>(entry.record.slots, AsyncLog::MAX_SLOTS);
+  for (size_t s = 1; s < slots; s++) {
+    const auto& slot = this->slot(position + s);
+    for (size_t w = 0; w < AsyncLog::SLOT_WORDS; w++) {
+      words[w] = slot.words[w].load(std::memory_order_relaxed);
+    }
+    size_t from = (s - 1) * AsyncLog::TEXT_BYTES;
+    memcpy(entry.text + from, words + 1, std::min(AsyncLog::TEXT_BYTES, LogEntry::MAX_TEXT - from));
+  }
+  entry.text[LogEntry::MAX_TEXT - 1] = '\0';
+}
+
+uint32_t AsyncLog::oldest() const {
+  uint32_t head = this->_head.load(std::memory_order_acquire);
+  return head - std::min<uint32_t>(head, AsyncLog::CAPACITY);
+}
+
+/**
+ * Copies the record out, then checks no producer had claimed its slots for
+ * the next lap meanwhile; if one had, the copy may be torn, and the reader
+ * skips ahead to what is still in the ring.
+ */
+bool AsyncLog::read(uint32_t& position, LogEntry& entry) const {
+  for (;;) {
+    uint32_t head = this->_head.load(std::memory_order_acquire);
+    if (head - position > AsyncLog::CAPACITY) {
+      position = head - AsyncLog::CAPACITY;
+    }
+    if (position == head) {
+      return false;
+    }
+    auto sequence = this->slot(position).sequence.load(std::memory_order_acquire);
+    if (sequence != position + 1 && sequence != position + AsyncLog::CAPACITY) {
+      // Still being written.
+      position++;
+      continue;
+    }
+    this->copy(position, entry);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (this->_head.load(std::memory_order_relaxed) - position > AsyncLog::CAPACITY) {
+      continue;
+    }
+    if (!entry.record.slots) {
+      // Text of a record that started before position.
+      position++;
+      continue;
+    }
+    position += entry.record.slots;
+    return true;
+  }
+}
+
+bool AsyncLog::flush(unsigned long timeoutMs) {
+  auto start = millis();
+  while (this->_tail.load(std::memory_order_acquire) != this->_head.load(std::memory_order_acquire)) {
+    if (!this->_drainTask || millis() - start >= timeoutMs) {
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+void AsyncLog::print(const LogEntry& entry) {
+  if (!this->_output) {
+    return;
+  }
+  if (this->_prefix) {
+    this->_prefix(this->_output);
+  }
+  if (this->_showLevel) {
+    this->_output->print(AsyncLog::levelLetter(entry.record.level));
+    this->_output->print(": ");
+  }
+  entry.printMessage(this->_output);
+  if (this->_suffix) {
+    this->_suffix(this->_output);
+  }
+}
+
+// Drains, then sleeps until the next record is committed.
+void AsyncLog::drainTask(void* parameters) {
+  auto self = static_cast<AsyncLog*>(parameters);
+  static LogEntry entry;
+  for (;;) {
+    for (;;) {
+      auto tail = self->_tail.load(std::memory_order_relaxed);
+      if (self->slot(tail).sequence.load(std::memory_order_acquire) != tail + 1) {
+        break;
+      }
+      self->copy(tail, entry);
+      self->print(entry);
+      for (size_t s = 0; s < entry.record.slots; s++) {
+        self->slot(tail + s).sequence.store(tail + s + AsyncLog::CAPACITY, std::memory_order_release);
+      }
+      self->_tail.store(tail + entry.record.slots, std::memory_order_release);
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+/**
+ * printf for the record's arguments, one conversion at a time. Flags, width
+ * and precision are kept; the length modifier is replaced to match how the
+ * argument was stored, so %d of a uint8_t and %lu of a size_t both work.
+ */
+void LogEntry::printMessage(Print* out) const {
+  const char* format = this->record.format;
+  size_t next = 0;
+  char buffer[64];
+  while (*format) {
+    const char* literal = format;
+    while (*format && *format != '%') {
+      format++;
+    }
+    if (format != literal) {
+      out->write(reinterpret_cast<const uint8_t*>(literal), format - literal);
+    }
+    if (!*format) {
+      break;
+    }
+    if (format[1] == '%') {
+      out->write('%');
+      format += 2;
+      continue;
+    }
+    char spec[16];
+    size_t n = 0;
+    spec[n++] = *format++;
+    while (*format && strchr("-+ #0123456789.", *format) && n < sizeof(spec) - 4) {
+      spec[n++] = *format++;
+    }
+    while (*format && strchr("hlLqjzt", *format)) {
+      format++;
+    }
+    char conversion = *format;
+    if (!conversion) {
+      break;
+    }
+    format++;
+    if (next >= this->record.arguments || next >= LogRecord::MAX_ARGUMENTS) {
+      out->write(reinterpret_cast<const uint8_t*>(spec), n);
+      out->write(conversion);
+      continue;
+    }
+    auto type = this->record.types[next];
+    const auto& argument = this->record.argument[next++];
+    int64_t integer = type == LogArgumentTypes::Type::INT ? argument.i
+      : type == LogArgumentTypes::Type::UINT ? (int64_t) argument.u
+      : type == LogArgumentTypes::Type::DOUBLE ? (int64_t) argument.d
+      : 0;
+    const char* string = type == LogArgumentTypes::Type::STRING && argument.string < LogEntry::MAX_TEXT
+      ? this->text + argument.string
+      : nullptr;
+    int length;
+    switch (conversion) {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+        spec[n++] = conversion;
+        spec[n] = '\0';
+        length = snprintf(buffer, sizeof(buffer), spec, (long long) integer);
+        break;
+      case 'c':
+        spec[n++] = 'c';
+        spec[n] = '\0';
+        length = snprintf(buffer, sizeof(buffer), spec, (int) integer);
+        break;
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+        spec[n++] = conversion;
+        spec[n] = '\0';
+        length = snprintf(buffer, sizeof(buffer), spec,
+                          type == LogArgumentTypes::Type::DOUBLE ? argument.d : (double) integer);
+        break;
+      case 's':
+        if (!string) {
+          string = "?";
+        }
+        if (n == 1) {
+          out->print(string);
+          continue;
+        }
+        spec[n++] = 's';
+        spec[n] = '\0';
+        length = snprintf(buffer, sizeof(buffer), spec, string);
+        break;
+      default:
+        out->write(reinterpret_cast<const uint8_t*>(spec), n);
+        out->write(conversion);
+        continue;
+    }
+    if (length > 0) {
+      out->write(reinterpret_cast<const uint8_t*>(buffer), std::min<size_t>(length, sizeof(buffer) - 1));
+    }
+  }
+}
+
+}
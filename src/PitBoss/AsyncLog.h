@@ -0,0 +1,254 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoLog.h>
+#include <Print.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace PitBoss {
+
+namespace LogArgumentTypes {
+
+enum Type : uint8_t {
+  INT,
+  UINT,
+  DOUBLE,
+  STRING,
+};
+
+}
+
+union LogArgument {
+  int64_t i;
+  uint64_t u;
+  double d;
+  // Offset of the copy in the record's text.
+  uint32_t string;
+};
+
+/**
+ * A log call as recorded, unformatted: the format string by pointer (they
+ * are all literals), numbers as they were passed, and strings copied into
+ * the text slots that follow, since they may not outlive the call.
+ */
+struct LogRecord {
+  static const size_t MAX_ARGUMENTS = 6;
+
+  // Slots the record takes, this and its text; 0 marks a text slot.
+  uint8_t slots;
+  uint8_t level;
+  uint8_t arguments;
+  LogArgumentTypes::Type types[MAX_ARGUMENTS];
+  uint16_t textLength;
+  uint32_t timestampMs;
+  const char* format;
+  LogArgument argument[MAX_ARGUMENTS];
+};
+
+/**
+ * A record read back out of the ring: what the drain task prints and /logs
+ * serves.
+ */
+struct LogEntry {
+  static const size_t MAX_TEXT = 1024;
+
+  LogRecord record;
+  char text[MAX_TEXT];
+
+  // The message, formatted printf-style.
+  void printMessage(Print* out) const;
+};
+
+/**
+ * ArduinoLog's interface, without its cost at the call site. A call appends
+ * a LogRecord to a lock-free ring, claiming its slots with one compare and
+ * swap, and a low priority task formats the records and writes them to
+ * Serial later. When the ring is full the record is dropped and counted
+ * rather than waiting for the serial port. Drained records stay in the ring
+ * until their slots are reused, so the newest are there for /logs.
+ *
+ * Any task may log; ISRs may not.
+ */
+class AsyncLog {
+ public:
+  static const size_t CAPACITY = 128;
+  // printf with floats needs the room.
+  static const uint32_t DRAIN_TASK_STACK = 3072;
+  static const UBaseType_t DRAIN_TASK_PRIORITY = 1;
+  static const BaseType_t DRAIN_TASK_CORE = PRO_CPU_NUM;
+
+ protected:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "AsyncLog capacity must be a power of two");
+
+  static const size_t SLOT_WORDS = (sizeof(LogRecord) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  // The first word of a text slot is the zero that marks it as one.
+  static const size_t TEXT_BYTES = (SLOT_WORDS - 1) * sizeof(uint32_t);
+  static const size_t MAX_SLOTS = 1 + (LogEntry::MAX_TEXT + TEXT_BYTES - 1) / TEXT_BYTES;
+  static_assert(MAX_SLOTS <= CAPACITY, "AsyncLog records must fit the ring");
+
+  /**
+   * A slot at position p holds sequence p while free for it, p + 1 once
+   * written and p + CAPACITY once drained, which is free for the next lap.
+   * Its contents are atomic words, so /logs may copy a slot while it is
+   * being reused and notice afterwards.
+   */
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> words[SLOT_WORDS];
+  };
+
+  int _level = LOG_LEVEL_SILENT;
+  bool _showLevel = true;
+  Print* _output = nullptr;
+  printfunction _prefix = nullptr;
+  printfunction _suffix = nullptr;
+  TaskHandle_t _drainTask = nullptr;
+  Slot _slots[CAPACITY];
+  // Next position to claim.
+  std::atomic<uint32_t> _head{0};
+  // Next position to drain, written by the drain task only.
+  std::atomic<uint32_t> _tail{0};
+  std::atomic<uint32_t> _records{0};
+  std::atomic<uint32_t> _dropped{0};
+
+ public:
+  AsyncLog();
+
+  // Starts the drain task.
+  void begin(int level, Print* output, bool showLevel = true);
+  void setLevel(int level) {
+    this->_level = level;
+  }
+  int getLevel() const {
+    return this->_level;
+  }
+  void setPrefix(printfunction f) {
+    this->_prefix = f;
+  }
+  void setSuffix(printfunction f) {
+    this->_suffix = f;
+  }
+
+  template<class T, typename... Args> void fatal(T msg, Args... args) {
+    this->append(LOG_LEVEL_FATAL, msg, args...);
+  }
+  template<class T, typename... Args> void error(T msg, Args... args) {
+    this->append(LOG_LEVEL_ERROR, msg, args...);
+  }
+  template<class T, typename... Args> void warning(T msg, Args... args) {
+    this->append(LOG_LEVEL_WARNING, msg, args...);
+  }
+  template<class T, typename... Args> void notice(T msg, Args... args) {
+    this->append(LOG_LEVEL_NOTICE, msg, args...);
+  }
+  template<class T, typename... Args> void trace(T msg, Args... args) {
+    this->append(LOG_LEVEL_TRACE, msg, args...);
+  }
+  template<class T, typename... Args> void verbose(T msg, Args... args) {
+    this->append(LOG_LEVEL_VERBOSE, msg, args...);
+  }
+
+  // Waits for the drain task to write out everything logged so far, as
+  // before a restart. False if it did not within the timeout.
+  bool flush(unsigned long timeoutMs);
+
+  // Records logged, dropped ones included.
+  uint32_t getRecords() const {
+    return this->_records;
+  }
+  // Records dropped because the ring was full.
+  uint32_t getDropped() const {
+    return this->_dropped;
+  }
+
+  // ArduinoLog's letter for a level.
+  static char levelLetter(uint8_t level) {
+    return level >= LOG_LEVEL_FATAL && level <= LOG_LEVEL_VERBOSE ? "FEWNTV"[level - 1] : '?';
+  }
+
+  // The oldest position that may still hold a record, for read().
+  uint32_t oldest() const;
+  // Reads the record at or after position that is still in the ring and
+  // advances position past it; false once there are no more.
+  bool read(uint32_t& position, LogEntry& entry) const;
+
+ protected:
+  static const char* formatOf(const char* msg) {
+    return msg;
+  }
+  static const char* formatOf(const __FlashStringHelper* msg) {
+    return reinterpret_cast<const char*>(msg);
+  }
+
+  template<typename T>
+  static typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value) || std::is_enum<T>::value>::type
+  encode(LogRecord& record, const char** strings, T value) {
+    record.types[record.arguments] = LogArgumentTypes::Type::INT;
+    record.argument[record.arguments].i = (int64_t) value;
+  }
+  template<typename T>
+  static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+  encode(LogRecord& record, const char** strings, T value) {
+    record.types[record.arguments] = LogArgumentTypes::Type::UINT;
+    record.argument[record.arguments].u = (uint64_t) value;
+  }
+  template<typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value>::type
+  encode(LogRecord& record, const char** strings, T value) {
+    record.types[record.arguments] = LogArgumentTypes::Type::DOUBLE;
+    record.argument[record.arguments].d = value;
+  }
+  static void encode(LogRecord& record, const char** strings, const char* value) {
+    record.types[record.arguments] = LogArgumentTypes::Type::STRING;
+    strings[record.arguments] = value ? value : "(null)";
+  }
+  static void encode(LogRecord& record, const char** strings, const __FlashStringHelper* value) {
+    AsyncLog::encode(record, strings, reinterpret_cast<const char*>(value));
+  }
+
+  static void encodeAll(LogRecord& record, const char** strings) {}
+  template<typename T, typename... Args>
+  static void encodeAll(LogRecord& record, const char** strings, T value, Args... args) {
+    if (record.arguments == LogRecord::MAX_ARGUMENTS) {
+      return;
+    }
+    AsyncLog::encode(record, strings, value);
+    record.arguments++;
+    AsyncLog::encodeAll(record, strings, args...);
+  }
+
+  template<class T, typename... Args> void append(int level, T msg, Args... args) {
+    if (level > this->_level) {
+      return;
+    }
+    LogRecord record = {};
+    record.level = level;
+    record.timestampMs = millis();
+    record.format = AsyncLog::formatOf(msg);
+    const char* strings[LogRecord::MAX_ARGUMENTS] = {};
+    AsyncLog::encodeAll(record, strings, args...);
+    this->commit(record, strings);
+  }
+
+  // Copies the strings into the text and the record into the ring.
+  void commit(LogRecord& record, const char** strings);
+  Slot& slot(uint32_t position) {
+    return this->_slots[position & (AsyncLog::CAPACITY - 1)];
+  }
+  const Slot& slot(uint32_t position) const {
+    return this->_slots[position & (AsyncLog::CAPACITY - 1)];
+  }
+  void copy(uint32_t position, LogEntry& entry) const;
+  void print(const LogEntry& entry);
+  static void drainTask(void* parameters);
+};
+
+// Every component logs here; ArduinoLog's Log is left unused.
+extern AsyncLog SystemLog;
+
+}
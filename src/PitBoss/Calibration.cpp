@@ -0,0 +1,149 @@
+#include <PitBoss/Calibration.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace PitBoss {
+
+namespace {
+
+// NIST ITS-90 type K reference functions (NIST Monograph 175): EMF in mV of
+// a junction at t C against one at 0 C, and its inverse.
+const double EMF_BELOW_ZERO[] = {
+  0.0, 0.394501280250E-01, 0.236223735980E-04, -0.328589067840E-06,
+  -0.499048287770E-08, -0.675090591730E-10, -0.574103274280E-12,
+  -0.310888728940E-14, -0.104516093650E-16, -0.198892668780E-19,
+  -0.163226974860E-22,
+};
+const double EMF_ABOVE_ZERO[] = {
+  -0.176004136860E-01, 0.389212049750E-01, 0.185587700320E-04,
+  -0.994575928740E-07, 0.318409457190E-09, -0.560728448890E-12,
+  0.560750590590E-15, -0.320207200030E-18, 0.971511471520E-22,
+  -0.121047212750E-25,
+};
+const double EMF_EXPONENTIAL[] = {0.118597600000E+00, -0.118343200000E-03, 0.126968600000E+03};
+
+const double TEMPERATURE_BELOW_ZERO[] = {
+  0.0, 2.5173462E+01, -1.1662878E+00, -1.0833638E+00, -8.9773540E-01,
+  -3.7342377E-01, -8.6632643E-02, -1.0450598E-02, -5.1920577E-04,
+};
+const double TEMPERATURE_TO_500[] = {
+  0.0, 2.508355E+01, 7.860106E-02, -2.503131E-01, 8.315270E-02,
+  -1.228034E-02, 9.804036E-04, -4.413030E-05, 1.057734E-06, -1.052755E-08,
+};
+const double TEMPERATURE_ABOVE_500[] = {
+  -1.318058E+02, 4.830222E+01, -1.646031E+00, 5.464731E-02, -9.650715E-04,
+  8.802193E-06, -3.110810E-08,
+};
+const double EMF_AT_500 = 20.644;
+
+// The range the reference functions cover, -270 C to 1372 C.
+const double MIN_EMF = -6.458;
+const double MAX_EMF = 54.886;
+const double MIN_TEMPERATURE = -270.0;
+const double MAX_TEMPERATURE = 1372.0;
+// What the MAX31855 itself works in.
+const double MIN_COLD_JUNCTION = -40.0;
+const double MAX_COLD_JUNCTION = 125.0;
+const double SEEBECK_MV = 0.041276;
+
+template<size_t N>
+double polynomial(const double (&coefficients)[N], double x) {
+  double y = 0;
+  for (size_t i = N; i-- > 0;) {
+    y = y * x + coefficients[i];
+  }
+  return y;
+}
+
+double thermocoupleEmf(double celsius) {
+  if (celsius < 0) {
+    return polynomial(EMF_BELOW_ZERO, celsius);
+  }
+  double offset = celsius - EMF_EXPONENTIAL[2];
+  return polynomial(EMF_ABOVE_ZERO, celsius) + EMF_EXPONENTIAL[0] * exp(EMF_EXPONENTIAL[1] * offset * offset);
+}
+
+// The inverse functions stop at -200 C; below that this extrapolates.
+double thermocoupleTemperature(double emf) {
+  if (emf < 0) {
+    return polynomial(TEMPERATURE_BELOW_ZERO, emf);
+  }
+  if (emf < EMF_AT_500) {
+    return polynomial(TEMPERATURE_TO_500, emf);
+  }
+  return polynomial(TEMPERATURE_ABOVE_500, emf);
+}
+
+int32_t toScaled(double celsius) {
+  return (int32_t) lround(celsius * Celsius::SCALE);
+}
+
+}
+
+bool ProbeCalibration::add(CalibrationPoint point) {
+  for (size_t i = 0; i < this->points; i++) {
+    if (std::abs(this->point[i].measured - point.measured) < Celsius::SCALE) {
+      this->point[i] = point;
+      return true;
+    }
+  }
+  if (this->points == ProbeCalibration::MAX_POINTS) {
+    return false;
+  }
+  size_t i = this->points;
+  for (; i > 0 && this->point[i - 1].measured > point.measured; i--) {
+    this->point[i] = this->point[i - 1];
+  }
+  this->point[i] = point;
+  this->points++;
+  return true;
+}
+
+double ProbeCalibration::linearize(double hotJunction, double coldJunction) const {
+  if (!this->nist) {
+    return hotJunction;
+  }
+  return thermocoupleTemperature((hotJunction - coldJunction) * SEEBECK_MV + thermocoupleEmf(coldJunction));
+}
+
+double ProbeCalibration::correct(double hotJunction, double coldJunction) const {
+  double measured = this->linearize(hotJunction, coldJunction);
+  if (this->points == 0) {
+    return measured;
+  }
+  auto degrees = [](int32_t scaled){
+    return (double) scaled / Celsius::SCALE;
+  };
+  if (this->points == 1) {
+    return measured + degrees(this->point[0].actual - this->point[0].measured);
+  }
+  size_t i = 1;
+  for (; i < this->points - 1u && degrees(this->point[i].measured) < measured; i++);
+  const auto& from = this->point[i - 1];
+  const auto& to = this->point[i];
+  double slope = degrees(to.actual - from.actual) / degrees(to.measured - from.measured);
+  return degrees(from.actual) + (measured - degrees(from.measured)) * slope;
+}
+
+void CalibrationTable::compile(const ProbeCalibration& calibration) {
+  this->_enabled = calibration.enabled();
+  this->_nist = calibration.nist;
+  if (!this->_enabled) {
+    return;
+  }
+  if (!this->_nist) {
+    this->_table.compile(toScaled(MIN_TEMPERATURE), toScaled(MAX_TEMPERATURE), [&](int64_t hotJunction){
+      return toScaled(calibration.correct((double) hotJunction / Celsius::SCALE, 0));
+    });
+    return;
+  }
+  this->_coldJunctionEmf.compile(toScaled(MIN_COLD_JUNCTION), toScaled(MAX_COLD_JUNCTION), [](int64_t coldJunction){
+    return (int32_t) lround(thermocoupleEmf((double) coldJunction / Celsius::SCALE) * 1000);
+  });
+  // Keyed by total EMF, so correct() sees it as a reading over a 0 C junction.
+  this->_table.compile((int32_t) (MIN_EMF * 1000), (int32_t) (MAX_EMF * 1000), [&](int64_t emf){
+    return toScaled(calibration.correct((double) emf / 1000 / SEEBECK_MV, 0));
+  });
+}
+
+}
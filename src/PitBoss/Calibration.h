@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <PitBoss/Temperature.h>
+
+namespace PitBoss {
+
+/**
+ * A reading taken with the probe at a known temperature: measured is what the
+ * probe read (after the NIST correction, if on), actual what it should have.
+ * Both in Celsius::SCALE units.
+ */
+struct CalibrationPoint {
+  int32_t measured;
+  int32_t actual;
+};
+
+/**
+ * One probe's calibration as configured: the NIST ITS-90 type K correction
+ * for the MAX31855's linear approximation, then a piecewise-linear fit
+ * through the points (an offset for one point, none for none). Beyond the
+ * outermost points the outer segments carry on.
+ */
+struct ProbeCalibration {
+  static const size_t MAX_POINTS = 8;
+
+  bool nist = false;
+  uint8_t points = 0;
+  // By measured, ascending.
+  CalibrationPoint point[MAX_POINTS] = {};
+
+  bool enabled() const {
+    return this->nist || this->points;
+  }
+
+  // Adds a point, or replaces the one within a degree of its measured
+  // temperature. False if full.
+  bool add(CalibrationPoint point);
+
+  // The calibrated temperature for a MAX31855 reading, the slow way: in
+  // double precision, for building tables and capturing points.
+  double correct(double hotJunction, double coldJunction) const;
+  // The NIST correction alone, as captured points are measured.
+  double linearize(double hotJunction, double coldJunction) const;
+};
+
+/**
+ * A function sampled at SEGMENTS + 1 evenly spaced keys, a power of two
+ * apart so a lookup is a shift, a mask and a multiply. Keys outside the
+ * table extrapolate from its end segments.
+ */
+template<size_t SEGMENTS>
+class PiecewiseLinear {
+ protected:
+  int32_t _origin = 0;
+  uint8_t _shift = 0;
+  int32_t _values[SEGMENTS + 1] = {};
+
+ public:
+  // Samples f over at least [from, to].
+  template<typename T_function>
+  void compile(int32_t from, int32_t to, T_function f) {
+    this->_shift = 0;
+    while (((int64_t) SEGMENTS << this->_shift) < (int64_t) to - from) {
+      this->_shift++;
+    }
+    this->_origin = from;
+    for (size_t i = 0; i <= SEGMENTS; i++) {
+      this->_values[i] = f((int64_t) from + ((int64_t) i << this->_shift));
+    }
+  }
+
+  int32_t apply(int32_t key) const {
+    int64_t offset = (int64_t) key - this->_origin;
+    int64_t segment = offset >> this->_shift;
+    segment = segment < 0 ? 0 : segment >= (int64_t) SEGMENTS ? SEGMENTS - 1 : segment;
+    int64_t fraction = offset - (segment << this->_shift);
+    int32_t from = this->_values[segment];
+    int32_t to = this->_values[segment + 1];
+    return from + (int32_t) (((int64_t) (to - from) * fraction) >> this->_shift);
+  }
+};
+
+/**
+ * A ProbeCalibration compiled for the sampling task. With the NIST
+ * correction the table is keyed by thermocouple EMF in microvolts, recovered
+ * from the MAX31855's linear reading plus the cold junction's own EMF (a
+ * second, smaller table); without, by the reading itself. Either way a
+ * sample costs two or three table lookups and no floating point.
+ */
+class CalibrationTable {
+ public:
+  static const size_t SEGMENTS = 128;
+  static const size_t COLD_JUNCTION_SEGMENTS = 16;
+
+ protected:
+  // The MAX31855's Seebeck coefficient, 41.276 uV/C, in microvolts per
+  // Celsius::SCALE unit as a 32 bit fraction.
+  static const int64_t MICROVOLTS_Q32 = 17727907;
+
+  bool _enabled = false;
+  bool _nist = false;
+  PiecewiseLinear<SEGMENTS> _table;
+  PiecewiseLinear<COLD_JUNCTION_SEGMENTS> _coldJunctionEmf;
+
+ public:
+  // At config load or when a point is captured; slow.
+  void compile(const ProbeCalibration& calibration);
+
+  bool enabled() const {
+    return this->_enabled;
+  }
+
+  int32_t apply(int32_t hotJunction, int32_t coldJunction) const {
+    if (!this->_enabled) {
+      return hotJunction;
+    }
+    if (!this->_nist) {
+      return this->_table.apply(hotJunction);
+    }
+    int32_t emf = (int32_t) (((int64_t) (hotJunction - coldJunction) * CalibrationTable::MICROVOLTS_Q32) >> 32);
+    return this->_table.apply(emf + this->_coldJunctionEmf.apply(coldJunction));
+  }
+};
+
+}
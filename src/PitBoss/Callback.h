@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace PitBoss {
+
+template <typename T_signature, size_t STORAGE = 2 * sizeof(void*)>
+class Callback;
+
+/**
+ * Non-allocating stand-in for std::function. The callable is copied into
+ * STORAGE bytes held inline, so it must be small and trivially copyable: a
+ * lambda capturing `this` and a pointer or two, a function pointer. Larger
+ * captures fail to compile rather than fall back to the heap.
+ */
+template <typename R, typename... Args, size_t STORAGE>
+class Callback<R(Args...), STORAGE> {
+ protected:
+  alignas(void*) unsigned char _storage[STORAGE];
+  R (*_invoke)(const void*, Args...) = nullptr;
+
+ public:
+  Callback() = default;
+
+  template <typename T_callable>
+  Callback(const T_callable& callable) {
+    static_assert(sizeof(T_callable) <= STORAGE, "Callback capture too large; capture a pointer instead");
+    static_assert(alignof(T_callable) <= alignof(void*), "Callback capture over-aligned");
+    static_assert(std::is_trivially_copyable<T_callable>::value && std::is_trivially_destructible<T_callable>::value,
+                  "Callback captures are copied bytewise and never destroyed");
+    new (this->_storage) T_callable(callable);
+    this->_invoke = [](const void* storage, Args... args) -> R {
+      return (*static_cast<const T_callable*>(storage))(std::forward<Args>(args)...);
+    };
+  }
+
+  explicit operator bool() const {
+    return this->_invoke != nullptr;
+  }
+
+  R operator()(Args... args) const {
+    return this->_invoke(this->_storage, std::forward<Args>(args)...);
+  }
+};
+
+}
@@ -1,66 +1,258 @@
 #include <PitBoss/Config.h>
 #include <WiFiManager.h>
-#include <map>
-#include <vector>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 
 namespace PitBoss {
 
-std::vector<String> Config::fromJson(StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json) {
-  std::vector<String> errors;
-  if (json.containsKey(Config::jsonKeys::LOG_LEVEL)) {
-    this->logLevel = json[Config::jsonKeys::LOG_LEVEL].as<int>();
+namespace {
+
+const wifi_country_t* const COUNTRIES[] = {&WM_COUNTRY_US, &WM_COUNTRY_CN, &WM_COUNTRY_JP};
+
+const ConfigField FIELDS[] = {
+  {Config::jsonKeys::LOG_LEVEL, ConfigTypes::Type::INT, offsetof(Config, logLevel),
+   LOG_LEVEL_SILENT, LOG_LEVEL_VERBOSE, LOG_LEVEL_VERBOSE, nullptr, ConfigSubsystems::Subsystem::LOG},
+  {Config::jsonKeys::WIFI_COUNTRY, ConfigTypes::Type::COUNTRY, offsetof(Config, wifiCountry),
+   0, 0, 0, "US", ConfigSubsystems::Subsystem::RESTART},
+  {Config::jsonKeys::NTP_SERVER, ConfigTypes::Type::STRING, offsetof(Config, ntpServer),
+   0, Config::MAX_NTP_SERVER_LENGTH, 0, Config::DEFAULT_NTP_SERVER, ConfigSubsystems::Subsystem::NTP},
+  {Config::jsonKeys::GMT_OFFSET, ConfigTypes::Type::INT, offsetof(Config, gmtOffset),
+   -12 * 3600, 14 * 3600, 0, nullptr, ConfigSubsystems::Subsystem::NTP},
+  {Config::jsonKeys::DST_OFFSET, ConfigTypes::Type::INT, offsetof(Config, dstOffset),
+   -2 * 3600, 2 * 3600, 0, nullptr, ConfigSubsystems::Subsystem::NTP},
+  {Config::jsonKeys::THERMOCOUPLE_READ_INTERVAL_MS, ConfigTypes::Type::INT, offsetof(Config, thermocoupleReadInterval),
+   MAX31855Bus::CONVERSION_MS, 3600 * 1000, Config::DEFAULT_THERMOCOUPLE_READ_INTERVAL, nullptr, ConfigSubsystems::Subsystem::RESTART},
+  {Config::jsonKeys::TELEMETRY_PORT, ConfigTypes::Type::INT, offsetof(Config, telemetryPort),
+   0, 65535, Config::DEFAULT_TELEMETRY_PORT, nullptr, ConfigSubsystems::Subsystem::TELEMETRY},
+  {Config::jsonKeys::TELEMETRY_INTERVAL_MS, ConfigTypes::Type::INT, offsetof(Config, telemetryInterval),
+   0, 3600 * 1000, 0, nullptr, ConfigSubsystems::Subsystem::TELEMETRY},
+  {Config::jsonKeys::TELEMETRY_BATCH, ConfigTypes::Type::INT, offsetof(Config, telemetryBatch),
+   1, 255, 1, nullptr, ConfigSubsystems::Subsystem::TELEMETRY},
+  {Config::jsonKeys::DISPLAY_I2C_CLOCK, ConfigTypes::Type::INT, offsetof(Config, displayI2cClock),
+   Config::MIN_DISPLAY_I2C_CLOCK, Config::MAX_DISPLAY_I2C_CLOCK, Config::DEFAULT_DISPLAY_I2C_CLOCK, nullptr, ConfigSubsystems::Subsystem::DISPLAY},
+  {Config::jsonKeys::THERMOCOUPLE_OVERSAMPLING, ConfigTypes::Type::INT, offsetof(Config, thermocoupleOversampling),
+   0, 1000, 1, nullptr, ConfigSubsystems::Subsystem::SAMPLING},
+  {Config::jsonKeys::THERMOCOUPLE_CS_PINS, ConfigTypes::Type::PINS, offsetof(Config, thermocoupleCsPins),
+   0, Config::MAX_GPIO, Config::DEFAULT_THERMOCOUPLE_CS_PIN, nullptr, ConfigSubsystems::Subsystem::RESTART},
+  {Config::jsonKeys::FILTER_MEDIAN, ConfigTypes::Type::INT, offsetof(Config, filter.median),
+   0, FilterConfig::MAX_MEDIAN, 0, nullptr, ConfigSubsystems::Subsystem::SAMPLING},
+  {Config::jsonKeys::FILTER_EMA_ALPHA, ConfigTypes::Type::FLOAT, offsetof(Config, filter.emaAlpha),
+   0, 1, 0, nullptr, ConfigSubsystems::Subsystem::SAMPLING},
+  {Config::jsonKeys::FILTER_KALMAN_PROCESS_NOISE, ConfigTypes::Type::FLOAT, offsetof(Config, filter.kalmanProcessNoise),
+   0, 1e6f, 0.01f, nullptr, ConfigSubsystems::Subsystem::SAMPLING},
+  {Config::jsonKeys::FILTER_KALMAN_MEASUREMENT_NOISE, ConfigTypes::Type::FLOAT, offsetof(Config, filter.kalmanMeasurementNoise),
+   0, 1e6f, 0, nullptr, ConfigSubsystems::Subsystem::SAMPLING},
+  {Config::jsonKeys::SLEEP_LOG_INTERVAL_MS, ConfigTypes::Type::INT, offsetof(Config, sleepLogInterval),
+   0, Config::MAX_SLEEP_LOG_INTERVAL, 0, nullptr, ConfigSubsystems::Subsystem::NONE},
+  {Config::jsonKeys::SLEEP_LOG_BATCH, ConfigTypes::Type::INT, offsetof(Config, sleepLogBatch),
+   1, Config::MAX_SLEEP_LOG_BATCH, Config::DEFAULT_SLEEP_LOG_BATCH, nullptr, ConfigSubsystems::Subsystem::NONE},
+  {Config::jsonKeys::SLEEP_LOG_ALARM_LOW, ConfigTypes::Type::FLOAT, offsetof(Config, sleepLogAlarmLow),
+   -200, 1350, 0, nullptr, ConfigSubsystems::Subsystem::NONE},
+  {Config::jsonKeys::SLEEP_LOG_ALARM_HIGH, ConfigTypes::Type::FLOAT, offsetof(Config, sleepLogAlarmHigh),
+   -200, 1350, 0, nullptr, ConfigSubsystems::Subsystem::NONE},
+};
+
+template<typename T>
+T& valueOf(Config& config, const ConfigField& field) {
+  return *reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(&config) + field.offset);
+}
+
+template<typename T>
+const T& valueOf(const Config& config, const ConfigField& field) {
+  return *reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(&config) + field.offset);
+}
+
+bool inRange(const ConfigField& field, double value) {
+  return value >= field.min && value <= field.max;
+}
+
+const ConfigField* findField(const char* key) {
+  for (const auto& field : FIELDS) {
+    if (strcmp(field.key, key) == 0) {
+      return &field;
+    }
   }
-  if (json.containsKey(Config::jsonKeys::WIFI_COUNTRY)) {
-    std::map<const char*, wifi_country_t> wifiCountries;
-    wifiCountries[WM_COUNTRY_US.cc] = WM_COUNTRY_US;
-    wifiCountries[WM_COUNTRY_CN.cc] = WM_COUNTRY_CN;
-    wifiCountries[WM_COUNTRY_JP.cc] = WM_COUNTRY_JP;
-    const char* countryCode = json[Config::jsonKeys::WIFI_COUNTRY];
-    wifi_country_t* country = Config::getCountryFromCode(countryCode);
-    if (!country) {
-      auto temp = String(F("Unknown country: %s"));
-      char buffer[temp.length() + sizeof(countryCode)];
-      sprintf(buffer, temp.c_str(), countryCode);
-      errors.push_back(String(buffer));
+  return nullptr;
+}
+
+void parseField(Config& config, const ConfigField& field, JsonVariantConst value, ConfigErrors& errors) {
+  switch (field.type) {
+    case ConfigTypes::Type::INT:
+      if (!value.is<int>()) {
+        errors.add("%s must be an integer", field.key);
+      } else if (!inRange(field, value.as<int>())) {
+        errors.add("%s out of range %.0f to %.0f: %d", field.key, field.min, field.max, value.as<int>());
+      } else {
+        valueOf<int>(config, field) = value.as<int>();
+      }
+      break;
+    case ConfigTypes::Type::FLOAT:
+      if (!value.is<float>()) {
+        errors.add("%s must be a number", field.key);
+      } else if (!inRange(field, value.as<float>())) {
+        errors.add("%s out of range %g to %g: %g", field.key, field.min, field.max, value.as<float>());
+      } else {
+        valueOf<float>(config, field) = value.as<float>();
+      }
+      break;
+    case ConfigTypes::Type::STRING: {
+      const char* text = value.as<const char*>();
+      if (!text) {
+        errors.add("%s must be a string", field.key);
+      } else if (strlen(text) >= (size_t) field.max) {
+        errors.add("%s longer than %.0f characters", field.key, field.max - 1);
+      } else {
+        strcpy(&valueOf<char>(config, field), text);
+      }
+      break;
+    }
+    case ConfigTypes::Type::COUNTRY: {
+      const char* code = value.as<const char*>();
+      const wifi_country_t* country = code ? Config::getCountryFromCode(code) : nullptr;
+      if (!country) {
+        errors.add("Unknown country: %s", code ? code : "?");
+      } else {
+        valueOf<wifi_country_t>(config, field) = *country;
+      }
+      break;
+    }
+    case ConfigTypes::Type::PINS: {
+      JsonArrayConst pins = value.as<JsonArrayConst>();
+      if (!value.is<JsonArrayConst>() || pins.size() < 1 || pins.size() > MAX31855Bus::MAX_DEVICES) {
+        errors.add("%s must number 1 to %u", field.key, (unsigned) MAX31855Bus::MAX_DEVICES);
+        break;
+      }
+      for (size_t i = 0; i < pins.size(); i++) {
+        if (!pins[i].is<int>() || !inRange(field, pins[i].as<int>())) {
+          errors.add("%s out of range %.0f to %.0f: %d", field.key, field.min, field.max, pins[i].as<int>());
+          return;
+        }
+      }
+      auto csPins = &valueOf<int>(config, field);
+      for (size_t i = 0; i < pins.size(); i++) {
+        csPins[i] = pins[i].as<int>();
+      }
+      config.thermocoupleProbes = pins.size();
+      break;
     }
   }
-  if (json.containsKey(Config::jsonKeys::NTP_SERVER)) {
-    this->ntpServer = json[Config::jsonKeys::NTP_SERVER].as<char *>();
+}
+
+bool sameValue(const Config& a, const Config& b, const ConfigField& field) {
+  switch (field.type) {
+    case ConfigTypes::Type::INT:
+      return valueOf<int>(a, field) == valueOf<int>(b, field);
+    case ConfigTypes::Type::FLOAT:
+      return valueOf<float>(a, field) == valueOf<float>(b, field);
+    case ConfigTypes::Type::STRING:
+      return strcmp(&valueOf<char>(a, field), &valueOf<char>(b, field)) == 0;
+    case ConfigTypes::Type::COUNTRY:
+      return strncmp(valueOf<wifi_country_t>(a, field).cc, valueOf<wifi_country_t>(b, field).cc, sizeof(wifi_country_t::cc)) == 0;
+    case ConfigTypes::Type::PINS:
+      return a.thermocoupleProbes == b.thermocoupleProbes
+        && memcmp(&valueOf<int>(a, field), &valueOf<int>(b, field), a.thermocoupleProbes * sizeof(int)) == 0;
+  }
+  return false;
+}
+
+}
+
+void ConfigErrors::add(const char* format, ...) {
+  if (this->count == ConfigErrors::MAX_ERRORS) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  vsnprintf(this->messages[this->count++], ConfigErrors::MAX_LENGTH, format, args);
+  va_end(args);
+}
+
+Config::Config() {
+  for (const auto& field : FIELDS) {
+    switch (field.type) {
+      case ConfigTypes::Type::INT:
+        valueOf<int>(*this, field) = (int) field.defaultValue;
+        break;
+      case ConfigTypes::Type::FLOAT:
+        valueOf<float>(*this, field) = field.defaultValue;
+        break;
+      case ConfigTypes::Type::STRING:
+        snprintf(&valueOf<char>(*this, field), (size_t) field.max, "%s", field.defaultText);
+        break;
+      case ConfigTypes::Type::COUNTRY:
+        valueOf<wifi_country_t>(*this, field) = *Config::getCountryFromCode(field.defaultText);
+        break;
+      case ConfigTypes::Type::PINS:
+        memset(this->thermocoupleCsPins, 0, sizeof(this->thermocoupleCsPins));
+        valueOf<int>(*this, field) = (int) field.defaultValue;
+        this->thermocoupleProbes = 1;
+        break;
+    }
   }
-  if (json.containsKey(Config::jsonKeys::THERMOCOUPLE_READ_INTERVAL_MS)) {
-    this->thermocoupleReadInterval = json[Config::jsonKeys::THERMOCOUPLE_READ_INTERVAL_MS].as<int>();
+}
+
+void Config::fromJson(JsonObjectConst json, ConfigErrors& errors) {
+  for (auto pair : json) {
+    if (!findField(pair.key().c_str())) {
+      errors.add("Unknown key: %s", pair.key().c_str());
+    }
   }
-  if (json.containsKey(Config::jsonKeys::GMT_OFFSET)) {
-    this->gmtOffset = json[Config::jsonKeys::GMT_OFFSET].as<int>();
+  for (const auto& field : FIELDS) {
+    JsonVariantConst value = json[field.key];
+    if (!value.isNull()) {
+      parseField(*this, field, value, errors);
+    }
   }
-  if (json.containsKey(Config::jsonKeys::DST_OFFSET)) {
-    this->dstOffset = json[Config::jsonKeys::DST_OFFSET].as<int>();
+}
+
+void Config::toJson(JsonDocument& json) const {
+  for (const auto& field : FIELDS) {
+    switch (field.type) {
+      case ConfigTypes::Type::INT:
+        json[field.key] = valueOf<int>(*this, field);
+        break;
+      case ConfigTypes::Type::FLOAT:
+        json[field.key] = valueOf<float>(*this, field);
+        break;
+      case ConfigTypes::Type::STRING:
+        json[field.key] = (const char*) &valueOf<char>(*this, field);
+        break;
+      case ConfigTypes::Type::COUNTRY: {
+        // cc need not be terminated, so this one is copied.
+        char code[sizeof(wifi_country_t::cc) + 1] = {};
+        memcpy(code, valueOf<wifi_country_t>(*this, field).cc, sizeof(wifi_country_t::cc));
+        json[field.key] = (char*) code;
+        break;
+      }
+      case ConfigTypes::Type::PINS: {
+        JsonArray pins = json.createNestedArray(field.key);
+        for (int i = 0; i < this->thermocoupleProbes; i++) {
+          pins.add((&valueOf<int>(*this, field))[i]);
+        }
+        break;
+      }
+    }
   }
-  return errors;
 }
 
-wifi_country_t *Config::getCountryFromCode(const String &code) {
-  wifi_country_t* country = nullptr;
-  std::map<String, wifi_country_t> wifiCountries;
-  wifiCountries[WM_COUNTRY_US.cc] = WM_COUNTRY_US;
-  wifiCountries[WM_COUNTRY_CN.cc] = WM_COUNTRY_CN;
-  wifiCountries[WM_COUNTRY_JP.cc] = WM_COUNTRY_JP;
-  auto pos = wifiCountries.find(code);
-  if (pos != wifiCountries.end()) {
-    country = &(wifiCountries[code]);
+uint8_t Config::changes(const Config& other) const {
+  uint8_t subsystems = ConfigSubsystems::Subsystem::NONE;
+  for (const auto& field : FIELDS) {
+    if (!sameValue(*this, other, field)) {
+      subsystems |= field.subsystems;
+    }
   }
-  return country;
+  return subsystems;
 }
 
-StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> Config::toJson() {
-  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json;
-  json[Config::jsonKeys::LOG_LEVEL] = this->logLevel;
-  json[Config::jsonKeys::WIFI_COUNTRY] = this->wifiCountry.cc;
-  json[Config::jsonKeys::NTP_SERVER] = this->ntpServer;
-  json[Config::jsonKeys::GMT_OFFSET] = this->gmtOffset;
-  json[Config::jsonKeys::DST_OFFSET] = this->dstOffset;
-  json[Config::jsonKeys::THERMOCOUPLE_READ_INTERVAL_MS] = this->thermocoupleReadInterval;
-  return json;
+const wifi_country_t* Config::getCountryFromCode(const char* code) {
+  for (auto country : COUNTRIES) {
+    if (strncmp(country->cc, code, sizeof(country->cc)) == 0) {
+      return country;
+    }
+  }
+  return nullptr;
 }
 
-}
\ No newline at end of file
+}
@@ -3,13 +3,97 @@
 #include <ArduinoJson.h>
 #include <WiFiManager.h>
 #include <ArduinoLog.h>
+#include <cstddef>
+#include <cstdint>
+#include <PitBoss/Filter.h>
+#include <PitBoss/MAX31855.h>
 
 namespace PitBoss {
 
+namespace ConfigTypes {
+
+enum Type : uint8_t {
+  INT,
+  FLOAT,
+  // A NUL terminated char array.
+  STRING,
+  // A wifi_country_t, by its code.
+  COUNTRY,
+  // thermocoupleCsPins, as many as thermocoupleProbes.
+  PINS,
+};
+
+}
+
+// What re-applies a field once it changes.
+namespace ConfigSubsystems {
+
+enum Subsystem : uint8_t {
+  NONE = 0,
+  LOG = 1 << 0,
+  NTP = 1 << 1,
+  TELEMETRY = 1 << 2,
+  DISPLAY = 1 << 3,
+  // Oversampling and the filters.
+  SAMPLING = 1 << 4,
+  // Read once at boot.
+  RESTART = 1 << 5,
+};
+
+}
+
+/**
+ * One key of config.json. Numbers must lie within min and max; strings must
+ * fit in max bytes with their terminator; pins must each lie within min and
+ * max, and number 1 to MAX31855Bus::MAX_DEVICES.
+ */
+struct ConfigField {
+  const char* key;
+  ConfigTypes::Type type;
+  // Of the value in Config.
+  size_t offset;
+  float min;
+  float max;
+  // For numbers and pins.
+  float defaultValue;
+  // For strings and countries.
+  const char* defaultText;
+  uint8_t subsystems;
+};
+
+// What was wrong with a config, one message per field.
+struct ConfigErrors {
+  static const size_t MAX_ERRORS = 8;
+  static const size_t MAX_LENGTH = 80;
+
+  char messages[MAX_ERRORS][MAX_LENGTH];
+  size_t count = 0;
+
+  void add(const char* format, ...);
+  bool empty() const {
+    return this->count == 0;
+  }
+};
+
+/**
+ * Every field is described once, in the table in Config.cpp, which parsing,
+ * validation, serialization and change detection all walk. A Config is
+ * plain data, so it can be copied whole and published in a Snapshot.
+ */
 struct Config {
   constexpr static const char* DEFAULT_NTP_SERVER = "pool.ntp.org";
   constexpr static const int DEFAULT_THERMOCOUPLE_READ_INTERVAL = 2000;
+  constexpr static const int DEFAULT_THERMOCOUPLE_CS_PIN = 5;
+  constexpr static const int MAX_GPIO = 39;
+  constexpr static const int DEFAULT_TELEMETRY_PORT = 8888;
+  constexpr static const int DEFAULT_DISPLAY_I2C_CLOCK = 400000;
+  constexpr static const int MIN_DISPLAY_I2C_CLOCK = 100000;
+  constexpr static const int MAX_DISPLAY_I2C_CLOCK = 1000000;
   constexpr static const int CONFIG_FILE_MAX_SIZE = 1024;
+  constexpr static const size_t MAX_NTP_SERVER_LENGTH = 64;
+  constexpr static const int MAX_SLEEP_LOG_INTERVAL = 3600 * 1000;
+  constexpr static const int MAX_SLEEP_LOG_BATCH = 128;
+  constexpr static const int DEFAULT_SLEEP_LOG_BATCH = 30;
   struct jsonKeys {
     constexpr static const char* WIFI_COUNTRY = "wifiCountry";
     constexpr static const char* NTP_SERVER = "ntpServer";
@@ -17,19 +101,59 @@ struct Config {
     constexpr static const char* DST_OFFSET = "dstOffset";
     constexpr static const char* LOG_LEVEL = "logLevel";
     constexpr static const char* THERMOCOUPLE_READ_INTERVAL_MS = "thermocoupleReadInterval";
+    constexpr static const char* TELEMETRY_PORT = "telemetryPort";
+    constexpr static const char* TELEMETRY_INTERVAL_MS = "telemetryInterval";
+    constexpr static const char* TELEMETRY_BATCH = "telemetryBatch";
+    constexpr static const char* DISPLAY_I2C_CLOCK = "displayI2cClock";
+    constexpr static const char* THERMOCOUPLE_OVERSAMPLING = "thermocoupleOversampling";
+    constexpr static const char* THERMOCOUPLE_CS_PINS = "thermocoupleCsPins";
+    constexpr static const char* FILTER_MEDIAN = "filterMedian";
+    constexpr static const char* FILTER_EMA_ALPHA = "filterEmaAlpha";
+    constexpr static const char* FILTER_KALMAN_PROCESS_NOISE = "filterKalmanProcessNoise";
+    constexpr static const char* FILTER_KALMAN_MEASUREMENT_NOISE = "filterKalmanMeasurementNoise";
+    constexpr static const char* SLEEP_LOG_INTERVAL_MS = "sleepLogInterval";
+    constexpr static const char* SLEEP_LOG_BATCH = "sleepLogBatch";
+    constexpr static const char* SLEEP_LOG_ALARM_LOW = "sleepLogAlarmLow";
+    constexpr static const char* SLEEP_LOG_ALARM_HIGH = "sleepLogAlarmHigh";
   };
-  std::vector<String> fromJson(StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> json);
-  StaticJsonDocument<Config::CONFIG_FILE_MAX_SIZE> toJson();
+
+  // Every field at its default.
+  Config();
+
+  // Sets the fields json has, leaving the rest. Fields in error keep their
+  // value and add to errors, as do keys that are not fields.
+  void fromJson(JsonObjectConst json, ConfigErrors& errors);
+  // Strings are added by pointer, so json must not outlive this.
+  void toJson(JsonDocument& json) const;
+  // ConfigSubsystems to re-apply to go from this to other.
+  uint8_t changes(const Config& other) const;
 
   bool debug = true;
-  wifi_country_t wifiCountry = WM_COUNTRY_US;
-  String ntpServer = DEFAULT_NTP_SERVER;
-  int gmtOffset = 0;
-  int dstOffset = 0;
-  int logLevel = LOG_LEVEL_VERBOSE;
-  int thermocoupleReadInterval = DEFAULT_THERMOCOUPLE_READ_INTERVAL;
- protected:
-  static wifi_country_t* getCountryFromCode(const String &code);
+  wifi_country_t wifiCountry;
+  char ntpServer[MAX_NTP_SERVER_LENGTH];
+  int gmtOffset;
+  int dstOffset;
+  int logLevel;
+  int thermocoupleReadInterval;
+  int telemetryPort;
+  int telemetryInterval;
+  int telemetryBatch;
+  int displayI2cClock;
+  // Reads per thermocoupleReadInterval, 0 for as many as the MAX31855 converts.
+  int thermocoupleOversampling;
+  FilterConfig filter;
+  // Chip select of each MAX31855 on the bus, the pit probe's first.
+  int thermocoupleCsPins[MAX31855Bus::MAX_DEVICES];
+  int thermocoupleProbes;
+  // Sleeping from the button logs a reading every sleepLogInterval ms, 0 to
+  // just turn off. See SleepLog.
+  int sleepLogInterval;
+  int sleepLogBatch;
+  // Pit temperatures, in C, whose crossing uploads at once; 0 for none.
+  float sleepLogAlarmLow;
+  float sleepLogAlarmHigh;
+
+  static const wifi_country_t* getCountryFromCode(const char* code);
 };
 
-}
\ No newline at end of file
+}
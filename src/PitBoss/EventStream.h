@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <ESPAsyncWebServer.h>
+#include <PitBoss/Snapshot.h>
+
+namespace PitBoss {
+
+struct EventStreamStats {
+  uint32_t subscribers;
+  uint32_t published;
+  uint32_t droppedSubscribers;
+};
+
+/**
+ * Server-Sent Events fan-out. Each event is formatted once, on publish, into
+ * a small ring that every subscriber's response copies from, so the cost of a
+ * sample does not grow with the number of clients.
+ *
+ * Subscribers are chunked responses and the AsyncTCP task only asks them for
+ * data once the client has acknowledged what it had, so a slow client simply
+ * falls behind in the ring rather than queueing on the heap. One that falls
+ * more than CAPACITY events behind has its response ended; EventSource
+ * clients reconnect after RETRY_MS and pick up from the newest event.
+ */
+class EventStream {
+ public:
+  static const uint32_t CAPACITY = 4;
+  static const size_t MAX_EVENT_SIZE = 512;
+  static const uint32_t RETRY_MS = 2000;
+
+ protected:
+  struct Event {
+    uint32_t id;
+    uint32_t length;
+    char data[MAX_EVENT_SIZE];
+  };
+
+  struct Subscription {
+    EventStream* stream;
+    uint32_t cursor = 0;
+    bool started = false;
+    bool dropped = false;
+
+    explicit Subscription(EventStream* stream) :
+      stream(stream)
+    {
+      this->stream->_subscribers++;
+    }
+    ~Subscription() {
+      this->stream->_subscribers--;
+    }
+  };
+
+  Snapshot<Event> _events[CAPACITY];
+  std::atomic<uint32_t> _next{0};
+  std::atomic<uint32_t> _subscribers{0};
+  std::atomic<uint32_t> _droppedSubscribers{0};
+
+ public:
+  // Single publisher. Events that do not fit MAX_EVENT_SIZE are discarded.
+  bool publish(const char* name, const char* data) {
+    Event event;
+    event.id = this->_next.load(std::memory_order_relaxed);
+    int length = snprintf(event.data, sizeof(event.data), "id: %lu\nevent: %s\ndata: %s\n\n", (unsigned long) event.id, name, data);
+    if (length < 0 || (size_t) length >= sizeof(event.data)) {
+      return false;
+    }
+    event.length = length;
+    this->_events[event.id % EventStream::CAPACITY].publish(event);
+    this->_next.store(event.id + 1, std::memory_order_release);
+    return true;
+  }
+
+  AsyncWebServerResponse* subscribe(AsyncWebServerRequest* request) {
+    auto subscription = std::make_shared<Subscription>(this);
+    auto response = request->beginChunkedResponse("text/event-stream", [subscription](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return subscription->stream->fill(*subscription, reinterpret_cast<char*>(buffer), maxLen);
+    });
+    response->addHeader("Cache-Control", "no-cache");
+    return response;
+  }
+
+  EventStreamStats getStats() const {
+    EventStreamStats stats;
+    stats.subscribers = this->_subscribers;
+    stats.published = this->_next;
+    stats.droppedSubscribers = this->_droppedSubscribers;
+    return stats;
+  }
+
+ protected:
+  size_t fill(Subscription& subscription, char* out, size_t maxLen) {
+    if (subscription.dropped) {
+      return 0;
+    }
+    size_t n = 0;
+    auto next = this->_next.load(std::memory_order_acquire);
+    if (!subscription.started) {
+      subscription.started = true;
+      subscription.cursor = next ? next - 1 : 0;
+      n += snprintf(out, maxLen, "retry: %lu\n\n", (unsigned long) EventStream::RETRY_MS);
+    }
+    while (subscription.cursor != next) {
+      Event event;
+      bool torn;
+      if (next - subscription.cursor > EventStream::CAPACITY) {
+        subscription.dropped = true;
+        break;
+      }
+      if (!this->_events[subscription.cursor % EventStream::CAPACITY].tryRead(event, torn)) {
+        break;
+      }
+      if (event.id != subscription.cursor) {
+        // Overwritten since next was loaded: lapped just the same.
+        subscription.dropped = true;
+        break;
+      }
+      if (event.length > maxLen - n) {
+        break;
+      }
+      memcpy(out + n, event.data, event.length);
+      n += event.length;
+      subscription.cursor++;
+    }
+    if (subscription.dropped) {
+      this->_droppedSubscribers++;
+    }
+    return n ? n : subscription.dropped ? 0 : RESPONSE_TRY_AGAIN;
+  }
+};
+
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <PitBoss/Temperature.h>
+
+namespace PitBoss {
+
+/**
+ * Settings for every stage; each stage reads its own and is bypassed when
+ * they turn it off.
+ */
+struct FilterConfig {
+  static const int MAX_MEDIAN = 9;
+
+  // Median of the last n readings, up to MAX_MEDIAN; 0 or 1 is off.
+  int median = 0;
+  // Weight of each new reading, 0 to 1; 0 or 1 is off.
+  float emaAlpha = 0;
+  // Variance the temperature drifts by per reading and the variance of a
+  // reading, in C^2. A measurement noise of 0 is off.
+  float kalmanProcessNoise = 0.01f;
+  float kalmanMeasurementNoise = 0;
+};
+
+struct FilterStageStats {
+  const char* name;
+  bool enabled;
+  uint32_t updates;
+  // CPU cycles per update, on average.
+  uint32_t meanCycles;
+};
+
+/**
+ * Counts a stage's updates and the cycles they took. Written by the sampling
+ * task only, read from any.
+ */
+class FilterStage {
+ protected:
+  std::atomic<uint32_t> _updates{0};
+  std::atomic<uint64_t> _cycles{0};
+
+ public:
+  void record(uint32_t cycles) {
+    this->_updates++;
+    this->_cycles += cycles;
+  }
+
+  FilterStageStats getStats(const char* name, bool enabled) const {
+    FilterStageStats stats;
+    stats.name = name;
+    stats.enabled = enabled;
+    stats.updates = this->_updates;
+    stats.meanCycles = stats.updates ? (uint32_t) (this->_cycles / stats.updates) : 0;
+    return stats;
+  }
+};
+
+/**
+ * Median of a sliding window of up to MAX_WINDOW readings. Rejects spikes
+ * shorter than half the window outright, where averaging only smears them.
+ */
+template<size_t MAX_WINDOW>
+class MedianFilter : public FilterStage {
+  static_assert(MAX_WINDOW > 0, "MedianFilter needs a window");
+
+ protected:
+  int32_t _values[MAX_WINDOW] = {};
+  size_t _window = 0;
+  size_t _count = 0;
+  size_t _next = 0;
+
+ public:
+  static constexpr const char* NAME = "median";
+
+  void configure(const FilterConfig& config) {
+    this->_window = (size_t) std::max(0, std::min<int>(config.median, MAX_WINDOW));
+    this->reset();
+  }
+
+  bool enabled() const {
+    return this->_window > 1;
+  }
+
+  void reset() {
+    this->_count = 0;
+    this->_next = 0;
+  }
+
+  // Until the window fills, the median of what there is.
+  int32_t update(int32_t value) {
+    this->_values[this->_next] = value;
+    this->_next = (this->_next + 1) % this->_window;
+    this->_count = std::min(this->_count + 1, this->_window);
+    int32_t sorted[MAX_WINDOW];
+    for (size_t i = 0; i < this->_count; i++) {
+      auto v = this->_values[i];
+      size_t j = i;
+      for (; j > 0 && sorted[j - 1] > v; j--) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = v;
+    }
+    return sorted[this->_count / 2];
+  }
+};
+
+/**
+ * Exponential moving average, with the weight held as a 16 bit fraction so
+ * each update is a multiply and a shift.
+ */
+class EmaFilter : public FilterStage {
+ protected:
+  static const int ALPHA_BITS = 16;
+
+  int32_t _alpha = 0;
+  int32_t _value = 0;
+  bool _primed = false;
+
+ public:
+  static constexpr const char* NAME = "ema";
+
+  void configure(const FilterConfig& config) {
+    auto alpha = std::max(0.0f, std::min(1.0f, config.emaAlpha));
+    this->_alpha = (int32_t) lroundf(alpha * (1 << EmaFilter::ALPHA_BITS));
+    this->reset();
+  }
+
+  bool enabled() const {
+    return this->_alpha > 0 && this->_alpha < (1 << EmaFilter::ALPHA_BITS);
+  }
+
+  void reset() {
+    this->_primed = false;
+  }
+
+  int32_t update(int32_t value) {
+    if (!this->_primed) {
+      this->_value = value;
+      this->_primed = true;
+      return value;
+    }
+    this->_value += (int32_t) (((int64_t) (value - this->_value) * this->_alpha) >> EmaFilter::ALPHA_BITS);
+    return this->_value;
+  }
+};
+
+/**
+ * One-dimensional Kalman filter for a temperature taken to drift as a random
+ * walk. Unlike a fixed EMA its gain settles from how noisy readings are
+ * against how fast the pit moves, and it starts from the first reading
+ * without a warm-up lag. Single precision, which the ESP32 does in hardware.
+ */
+class KalmanFilter : public FilterStage {
+ protected:
+  float _processNoise = 0;
+  float _measurementNoise = 0;
+  float _estimate = 0;
+  float _variance = 0;
+  bool _primed = false;
+
+ public:
+  static constexpr const char* NAME = "kalman";
+
+  void configure(const FilterConfig& config) {
+    this->_processNoise = std::max(0.0f, config.kalmanProcessNoise);
+    this->_measurementNoise = std::max(0.0f, config.kalmanMeasurementNoise);
+    this->reset();
+  }
+
+  bool enabled() const {
+    return this->_measurementNoise > 0;
+  }
+
+  void reset() {
+    this->_primed = false;
+  }
+
+  int32_t update(int32_t value) {
+    float measurement = (float) value / Celsius::SCALE;
+    if (!this->_primed) {
+      this->_estimate = measurement;
+      this->_variance = this->_measurementNoise;
+      this->_primed = true;
+      return value;
+    }
+    this->_variance += this->_processNoise;
+    float gain = this->_variance / (this->_variance + this->_measurementNoise);
+    this->_estimate += gain * (measurement - this->_estimate);
+    this->_variance *= 1.0f - gain;
+    return (int32_t) lroundf(this->_estimate * Celsius::SCALE);
+  }
+};
+
+template<typename... T_stages>
+class FilterChain;
+
+/**
+ * Stages applied in order to readings in Celsius::SCALE units, composed at
+ * compile time: no virtual calls, and a stage turned off in the config costs
+ * one branch. The empty chain passes readings through.
+ */
+template<>
+class FilterChain<> {
+ public:
+  static const size_t STAGES = 0;
+
+  void configure(const FilterConfig& config) {}
+  void reset() {}
+  int32_t update(int32_t value) {
+    return value;
+  }
+  size_t getStats(FilterStageStats* stats, size_t size) const {
+    return 0;
+  }
+};
+
+template<typename T_stage, typename... T_rest>
+class FilterChain<T_stage, T_rest...> {
+ protected:
+  T_stage _stage;
+  FilterChain<T_rest...> _rest;
+
+ public:
+  static const size_t STAGES = 1 + FilterChain<T_rest...>::STAGES;
+
+  // Before the sampling task starts.
+  void configure(const FilterConfig& config) {
+    this->_stage.configure(config);
+    this->_rest.configure(config);
+  }
+
+  // Forgets past readings, as after a fault.
+  void reset() {
+    this->_stage.reset();
+    this->_rest.reset();
+  }
+
+  int32_t update(int32_t value) {
+    if (this->_stage.enabled()) {
+      auto start = ESP.getCycleCount();
+      value = this->_stage.update(value);
+      this->_stage.record(ESP.getCycleCount() - start);
+    }
+    return this->_rest.update(value);
+  }
+
+  size_t getStats(FilterStageStats* stats, size_t size) const {
+    if (!size) {
+      return 0;
+    }
+    stats[0] = this->_stage.getStats(T_stage::NAME, this->_stage.enabled());
+    return 1 + this->_rest.getStats(stats + 1, size - 1);
+  }
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <gfxfont.h>
+
+/**
+ * Host stand-in for Adafruit_GFX: the text path (fonts, cursor, bounds) is
+ * reproduced closely enough that rendering cost tracks the real library.
+ */
+class Adafruit_GFX : public Print {
+ protected:
+  int16_t _width;
+  int16_t _height;
+  int16_t cursor_x = 0;
+  int16_t cursor_y = 0;
+  uint16_t textcolor = 0xFFFF;
+  uint16_t textbgcolor = 0xFFFF;
+  uint8_t textsize_x = 1;
+  uint8_t textsize_y = 1;
+  bool wrap = true;
+  const GFXfont* gfxFont = nullptr;
+
+  void charBounds(unsigned char c, int16_t* x, int16_t* y, int16_t* minx, int16_t* miny, int16_t* maxx, int16_t* maxy);
+ public:
+  Adafruit_GFX(int16_t w, int16_t h) :
+    _width(w),
+    _height(h)
+  {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color) {
+    this->fillRect(0, 0, this->_width, this->_height, color);
+  }
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y);
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+
+  void setCursor(int16_t x, int16_t y) {
+    this->cursor_x = x;
+    this->cursor_y = y;
+  }
+  void setTextColor(uint16_t c) {
+    this->textcolor = this->textbgcolor = c;
+  }
+  void setTextColor(uint16_t c, uint16_t bg) {
+    this->textcolor = c;
+    this->textbgcolor = bg;
+  }
+  void setTextSize(uint8_t s) {
+    this->textsize_x = this->textsize_y = s > 0 ? s : 1;
+  }
+  void setTextWrap(bool w) {
+    this->wrap = w;
+  }
+  void setFont(const GFXfont* f = nullptr) {
+    this->gfxFont = f;
+  }
+  void getTextBounds(const char* string, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+  void getTextBounds(const String& str, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+    this->getTextBounds(str.c_str(), x, y, x1, y1, w, h);
+  }
+  int16_t width() const {
+    return this->_width;
+  }
+  int16_t height() const {
+    return this->_height;
+  }
+  int16_t getCursorX() const {
+    return this->cursor_x;
+  }
+  int16_t getCursorY() const {
+    return this->cursor_y;
+  }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+
+#define SSD1306_MEMORYMODE 0x20
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_SWITCHCAPVCC 0x02
+
+/**
+ * Simulated SSD1306 on the simulated I2C bus. display() pushes the whole
+ * framebuffer in the same chunking as the real driver.
+ */
+class Adafruit_SSD1306 : public Adafruit_GFX {
+ protected:
+  TwoWire* _wire;
+  uint8_t* _buffer = nullptr;
+  uint8_t _i2caddr = 0;
+  uint32_t _clkDuring;
+  uint32_t _clkAfter;
+ public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rst_pin = -1, uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL) :
+    Adafruit_GFX(w, h),
+    _wire(twi),
+    _clkDuring(clkDuring),
+    _clkAfter(clkAfter)
+  {}
+  ~Adafruit_SSD1306() override {
+    free(this->_buffer);
+  }
+
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true, bool periphBegin = true);
+  void display();
+  void clearDisplay();
+  void ssd1306_command(uint8_t c);
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  uint8_t* getBuffer() {
+    return this->_buffer;
+  }
+};
@@ -0,0 +1,249 @@
+#include <Arduino.h>
+#include <PitBoss/Hal/Simulation.h>
+#include <chrono>
+#include <vector>
+
+namespace Simulation = PitBoss::Simulation;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long millis() {
+  return (unsigned long) (Simulation::micros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) Simulation::micros();
+}
+
+void delay(uint32_t ms) {
+  Simulation::advance(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+  Simulation::advanceMicros(us);
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+int digitalRead(uint8_t pin) {
+  return Simulation::buttonPressed() ? LOW : HIGH;
+}
+
+void analogWrite(uint8_t pin, int value) {}
+
+namespace {
+
+struct Interrupt {
+  uint8_t pin;
+  void (*handler)(void*);
+  void* arg;
+};
+
+std::vector<Interrupt> interrupts;
+
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+  detachInterrupt(pin);
+  interrupts.push_back(Interrupt{pin, handler, arg});
+}
+
+void detachInterrupt(uint8_t pin) {
+  interrupts.erase(std::remove_if(interrupts.begin(), interrupts.end(), [pin](const Interrupt& interrupt){
+    return interrupt.pin == pin;
+  }), interrupts.end());
+}
+
+void PitBoss::Simulation::fireInterrupts() {
+  for (const auto& interrupt : interrupts) {
+    interrupt.handler(interrupt.arg);
+  }
+}
+
+namespace {
+
+// Virtual micros() at which configTime() synced the wall clock.
+uint64_t ntpSyncedAt = 0;
+bool ntpSynced = false;
+
+}
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1, const char* server2, const char* server3) {
+  if (!ntpSynced) {
+    ntpSynced = true;
+    ntpSyncedAt = Simulation::micros();
+  }
+}
+
+// Replaces the C library's time() so the firmware sees the virtual clock.
+extern "C" time_t time(time_t* out) {
+  time_t now = ntpSynced
+    ? Simulation::NTP_EPOCH + (time_t) ((Simulation::micros() - ntpSyncedAt) / 1000000)
+    : (time_t) (Simulation::micros() / 1000000);
+  if (out) {
+    *out = now;
+  }
+  return now;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_in_us) {
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t gpio_num, int level) {
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start() {
+  Serial.println("simulation: entering deep sleep, exiting.");
+  Serial.flush();
+  std::exit(0);
+}
+
+uint32_t EspClass::getHeapSize() {
+  return Simulation::HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  auto live = Simulation::heap().liveBytes;
+  return live < Simulation::HEAP_SIZE ? Simulation::HEAP_SIZE - live : 0;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  auto peak = Simulation::heap().peakBytes;
+  return peak < Simulation::HEAP_SIZE ? Simulation::HEAP_SIZE - peak : 0;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return this->getFreeHeap();
+}
+
+// Deterministic, so simulated sessions repeat exactly.
+uint32_t esp_random() {
+  static uint32_t state = 0x2545F491;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+uint64_t EspClass::getEfuseMac() {
+  return 0x0000A4CF12345678ULL;
+}
+
+uint32_t EspClass::getCycleCount() {
+  auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t) (nanos * EspClass::CPU_FREQUENCY_MHZ / 1000);
+}
+
+void EspClass::restart() {
+  Serial.println("simulation: restart requested, exiting.");
+  Serial.flush();
+  std::exit(0);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return this->write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  Simulation::network().serialBytes += size;
+  if (Simulation::serialOutput()) {
+    fwrite(buffer, 1, size, Simulation::serialOutput());
+  }
+  return size;
+}
+
+void HardwareSerial::flush() {
+  if (Simulation::serialOutput()) {
+    fflush(Simulation::serialOutput());
+  }
+}
+
+// Writes right-aligned into buffer and returns the first character.
+static const char* formatInteger(char (&buffer)[8 * sizeof(long) + 2], unsigned long value, unsigned char base, bool negative) {
+  char* p = &buffer[sizeof(buffer) - 1];
+  *p = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    auto digit = value % base;
+    *--p = (char) (digit < 10 ? '0' + digit : 'A' + digit - 10);
+    value /= base;
+  } while (value);
+  if (negative) {
+    *--p = '-';
+  }
+  return p;
+}
+
+static const char* formatSigned(char (&buffer)[8 * sizeof(long) + 2], long value, unsigned char base) {
+  if (value < 0 && base == DEC) {
+    return formatInteger(buffer, 0UL - (unsigned long) value, base, true);
+  }
+  return formatInteger(buffer, (unsigned long) value, base, false);
+}
+
+String::String(long value, unsigned char base) {
+  char buffer[8 * sizeof(long) + 2];
+  this->_buffer = formatSigned(buffer, value, base);
+}
+
+String::String(unsigned long value, unsigned char base) {
+  char buffer[8 * sizeof(long) + 2];
+  this->_buffer = formatInteger(buffer, value, base, false);
+}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  this->_buffer = buffer;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (n <= 0) {
+    return 0;
+  }
+  return this->write(buffer, (size_t) n < sizeof(buffer) ? n : sizeof(buffer) - 1);
+}
+
+size_t Print::print(long value, int base) {
+  char buffer[8 * sizeof(long) + 2];
+  return this->write(formatSigned(buffer, value, (unsigned char) base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  char buffer[8 * sizeof(long) + 2];
+  return this->write(formatInteger(buffer, value, (unsigned char) base, false));
+}
+
+size_t Print::print(double value, int digits) {
+  char buffer[64];
+  int n = snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+  return n > 0 ? this->write(buffer, (size_t) n) : 0;
+}
+
+String IPAddress::toString() const {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buffer);
+}
+
+size_t IPAddress::printTo(Print& p) const {
+  return p.printf("%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+}
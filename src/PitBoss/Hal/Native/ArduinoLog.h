@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+#include <Print.h>
+
+#define LOG_LEVEL_SILENT 0
+#define LOG_LEVEL_FATAL 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_NOTICE 4
+#define LOG_LEVEL_INFO 4
+#define LOG_LEVEL_TRACE 5
+#define LOG_LEVEL_VERBOSE 6
+
+typedef void (*printfunction)(Print*);
+
+/**
+ * Host stand-in for ArduinoLog. Formatting is delegated to vsnprintf, which
+ * covers the subset of ArduinoLog's specifiers the firmware uses.
+ */
+class Logging {
+ protected:
+  int _level = LOG_LEVEL_SILENT;
+  bool _showLevel = true;
+  Print* _logOutput = nullptr;
+  printfunction _prefix = nullptr;
+  printfunction _suffix = nullptr;
+ public:
+  static const size_t MAX_LINE = 512;
+
+  void begin(int level, Print* output, bool showLevel = true) {
+    this->_level = level;
+    this->_logOutput = output;
+    this->_showLevel = showLevel;
+  }
+  void setLevel(int level) {
+    this->_level = level;
+  }
+  int getLevel() const {
+    return this->_level;
+  }
+  void setPrefix(printfunction f) {
+    this->_prefix = f;
+  }
+  void setSuffix(printfunction f) {
+    this->_suffix = f;
+  }
+
+  template<class T, typename... Args> void fatal(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_FATAL, msg, args...);
+  }
+  template<class T, typename... Args> void error(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_ERROR, msg, args...);
+  }
+  template<class T, typename... Args> void warning(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_WARNING, msg, args...);
+  }
+  template<class T, typename... Args> void notice(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_NOTICE, msg, args...);
+  }
+  template<class T, typename... Args> void trace(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_TRACE, msg, args...);
+  }
+  template<class T, typename... Args> void verbose(T msg, Args... args) {
+    this->printLevel(LOG_LEVEL_VERBOSE, msg, args...);
+  }
+
+ protected:
+  static const char* formatOf(const char* msg) {
+    return msg;
+  }
+  static const char* formatOf(const __FlashStringHelper* msg) {
+    return reinterpret_cast<const char*>(msg);
+  }
+  static const char* formatOf(const String& msg) {
+    return msg.c_str();
+  }
+
+  template<class T, typename... Args> void printLevel(int level, T msg, Args... args) {
+    if (level > this->_level || !this->_logOutput) {
+      return;
+    }
+    if (this->_prefix) {
+      this->_prefix(this->_logOutput);
+    }
+    if (this->_showLevel) {
+      static const char levels[] = "FEWNTV";
+      this->_logOutput->print(levels[level - 1]);
+      this->_logOutput->print(": ");
+    }
+    this->printFormat(Logging::formatOf(msg), args...);
+    if (this->_suffix) {
+      this->_suffix(this->_logOutput);
+    }
+  }
+
+  void printFormat(const char* format, ...) {
+    char line[MAX_LINE];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n > 0) {
+      this->_logOutput->write(line, n < (int) sizeof(line) ? n : sizeof(line) - 1);
+    }
+  }
+};
+
+extern Logging Log;
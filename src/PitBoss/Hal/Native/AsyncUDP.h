@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Simulated UDP socket; datagrams are only counted.
+ */
+class AsyncUDP {
+ protected:
+  bool _connected = false;
+  IPAddress _remoteIp;
+  uint16_t _remotePort = 0;
+ public:
+  bool connect(const IPAddress& addr, uint16_t port) {
+    this->_remoteIp = addr;
+    this->_remotePort = port;
+    this->_connected = true;
+    return true;
+  }
+  void close() {
+    this->_connected = false;
+  }
+  bool connected() const {
+    return this->_connected;
+  }
+  size_t write(const uint8_t* data, size_t len);
+  size_t writeTo(const uint8_t* data, size_t len, const IPAddress& addr, uint16_t port);
+  size_t broadcastTo(const uint8_t* data, size_t len, uint16_t port);
+  size_t broadcastTo(const char* data, uint16_t port) {
+    return this->broadcastTo(reinterpret_cast<const uint8_t*>(data), strlen(data), port);
+  }
+  size_t broadcast(const uint8_t* data, size_t len) {
+    return this->_remotePort ? this->broadcastTo(data, len, this->_remotePort) : 0;
+  }
+  size_t broadcast(const char* data) {
+    return this->broadcast(reinterpret_cast<const uint8_t*>(data), strlen(data));
+  }
+};
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+typedef enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+
+// Returned by a filler with nothing to send yet; it is asked again later.
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+class AsyncWebParameter {
+ protected:
+  String _name;
+  String _value;
+ public:
+  AsyncWebParameter(const String& name, const String& value) :
+    _name(name),
+    _value(value)
+  {}
+  const String& name() const {
+    return this->_name;
+  }
+  const String& value() const {
+    return this->_value;
+  }
+};
+
+class AsyncWebHeader : public AsyncWebParameter {
+ public:
+  using AsyncWebParameter::AsyncWebParameter;
+};
+
+class AsyncWebServerResponse {
+ protected:
+  int _code = 200;
+  String _contentType;
+  std::vector<AsyncWebHeader> _headers;
+ public:
+  AsyncWebServerResponse(int code = 200, const String& contentType = String()) :
+    _code(code),
+    _contentType(contentType)
+  {}
+  virtual ~AsyncWebServerResponse() = default;
+  void setCode(int code) {
+    this->_code = code;
+  }
+  int code() const {
+    return this->_code;
+  }
+  const String& contentType() const {
+    return this->_contentType;
+  }
+  void addHeader(const String& name, const String& value) {
+    this->_headers.emplace_back(name, value);
+  }
+  const std::vector<AsyncWebHeader>& headers() const {
+    return this->_headers;
+  }
+  // Writes the complete body, as it would go out over the socket.
+  virtual void render(String& out) {}
+  // Writes what fits in the client's window; false once the body is done.
+  virtual bool fill(String& out, size_t window) {
+    this->render(out);
+    return false;
+  }
+};
+
+class AsyncBasicResponse : public AsyncWebServerResponse {
+ protected:
+  String _content;
+ public:
+  AsyncBasicResponse(int code, const String& contentType = String(), const String& content = String()) :
+    AsyncWebServerResponse(code, contentType),
+    _content(content)
+  {}
+  void render(String& out) override {
+    out += this->_content;
+  }
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+ protected:
+  String _content;
+ public:
+  AsyncResponseStream(const String& contentType, size_t bufferSize) :
+    AsyncWebServerResponse(200, contentType)
+  {
+    this->_content.reserve(bufferSize);
+  }
+  using Print::write;
+  size_t write(uint8_t c) override {
+    this->_content.concat((char) c);
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t len) override {
+    this->_content.concat(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+  void render(String& out) override {
+    out += this->_content;
+  }
+};
+
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+ protected:
+  AwsResponseFiller _filler;
+ public:
+  static const size_t CHUNK_SIZE = 1436;
+  AsyncChunkedResponse(const String& contentType, AwsResponseFiller filler) :
+    AsyncWebServerResponse(200, contentType),
+    _filler(filler)
+  {}
+  // A filler with nothing to send yet ends a one-shot render.
+  void render(String& out) override {
+    while (this->fill(out, CHUNK_SIZE)) {
+      if (this->_waiting) {
+        break;
+      }
+    }
+  }
+  bool fill(String& out, size_t window) override {
+    uint8_t buffer[CHUNK_SIZE];
+    auto n = this->_filler(buffer, std::min(window, sizeof(buffer)), this->_index);
+    this->_waiting = n == RESPONSE_TRY_AGAIN;
+    if (this->_waiting) {
+      return true;
+    }
+    out.concat(reinterpret_cast<const char*>(buffer), n);
+    this->_index += n;
+    return n > 0;
+  }
+ protected:
+  size_t _index = 0;
+  bool _waiting = false;
+};
+
+/**
+ * Simulated request. Created by AsyncWebServer::handle(); whatever response
+ * the handler sends is kept on the request for the simulation to inspect.
+ */
+class AsyncWebServerRequest {
+ protected:
+  WebRequestMethodComposite _method;
+  String _url;
+  std::vector<AsyncWebParameter> _params;
+  std::vector<AsyncWebHeader> _headers;
+  size_t _contentLength;
+  std::unique_ptr<AsyncWebServerResponse> _response;
+ public:
+  AsyncWebServerRequest(WebRequestMethodComposite method, const String& url, const std::vector<AsyncWebHeader>& headers, size_t contentLength = 0);
+
+  WebRequestMethodComposite method() const {
+    return this->_method;
+  }
+  const String& url() const {
+    return this->_url;
+  }
+  size_t contentLength() const {
+    return this->_contentLength;
+  }
+  bool hasParam(const String& name, bool post = false, bool file = false) const {
+    return this->getParam(name, post, file) != nullptr;
+  }
+  const AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false) const {
+    for (const auto& param : this->_params) {
+      if (param.name() == name) {
+        return &param;
+      }
+    }
+    return nullptr;
+  }
+  bool hasHeader(const String& name) const {
+    return this->getHeader(name) != nullptr;
+  }
+  const AsyncWebHeader* getHeader(const String& name) const {
+    for (const auto& header : this->_headers) {
+      if (header.name() == name) {
+        return &header;
+      }
+    }
+    return nullptr;
+  }
+
+  AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String()) {
+    return new AsyncBasicResponse(code, contentType, content);
+  }
+  AsyncResponseStream* beginResponseStream(const String& contentType, size_t bufferSize = 1460) {
+    return new AsyncResponseStream(contentType, bufferSize);
+  }
+  AsyncWebServerResponse* beginChunkedResponse(const String& contentType, AwsResponseFiller callback) {
+    return new AsyncChunkedResponse(contentType, callback);
+  }
+  void send(AsyncWebServerResponse* response) {
+    this->_response.reset(response);
+  }
+  void send(int code, const String& contentType = String(), const String& content = String()) {
+    this->send(this->beginResponse(code, contentType, content));
+  }
+  void redirect(const String& url) {
+    auto response = this->beginResponse(302);
+    response->addHeader("Location", url);
+    this->send(response);
+  }
+  AsyncWebServerResponse* response() {
+    return this->_response.get();
+  }
+};
+
+class AsyncWebServer {
+ protected:
+  struct Handler {
+    String uri;
+    WebRequestMethodComposite method;
+    ArRequestHandlerFunction onRequest;
+    ArBodyHandlerFunction onBody;
+  };
+  uint16_t _port;
+  bool _running = false;
+  std::vector<Handler> _handlers;
+  ArRequestHandlerFunction _notFound;
+ public:
+  struct SimulatedResponse {
+    int code;
+    String contentType;
+    std::vector<AsyncWebHeader> headers;
+    String body;
+  };
+
+  /**
+   * A response held open, e.g. an event stream. Each pump() is an ack or
+   * poll from the client with the given send window.
+   */
+  class SimulatedStream {
+   protected:
+    std::unique_ptr<AsyncWebServerRequest> _request;
+    bool _open;
+   public:
+    explicit SimulatedStream(std::unique_ptr<AsyncWebServerRequest> request) :
+      _request(std::move(request)),
+      _open(this->_request->response() != nullptr)
+    {}
+    int code() {
+      return this->_open ? this->_request->response()->code() : 404;
+    }
+    bool open() const {
+      return this->_open;
+    }
+    bool pump(String& out, size_t window = AsyncChunkedResponse::CHUNK_SIZE) {
+      if (this->_open && !this->_request->response()->fill(out, window)) {
+        this->_open = false;
+      }
+      return this->_open;
+    }
+  };
+
+  AsyncWebServer(uint16_t port) :
+    _port(port)
+  {}
+  void begin() {
+    this->_running = true;
+  }
+  void end() {
+    this->_running = false;
+  }
+  bool running() const {
+    return this->_running;
+  }
+  void on(const char* uri, ArRequestHandlerFunction onRequest) {
+    this->on(uri, HTTP_ANY, onRequest);
+  }
+  void on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr) {
+    this->_handlers.push_back(Handler{uri, method, onRequest, onBody});
+  }
+  void onNotFound(ArRequestHandlerFunction fn) {
+    this->_notFound = fn;
+  }
+
+  // Simulation only: dispatches a request as the AsyncTCP task would.
+  SimulatedResponse handle(WebRequestMethodComposite method, const String& url, const String& body = String(), const std::vector<AsyncWebHeader>& headers = {});
+  std::unique_ptr<SimulatedStream> open(const String& url, const std::vector<AsyncWebHeader>& headers = {});
+ protected:
+  std::unique_ptr<AsyncWebServerRequest> dispatch(WebRequestMethodComposite method, const String& url, const String& body, const std::vector<AsyncWebHeader>& headers);
+};
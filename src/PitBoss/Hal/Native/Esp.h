@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+class EspClass {
+ public:
+  static const uint32_t CPU_FREQUENCY_MHZ = 240;
+
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint64_t getEfuseMac();
+  // Host time at the CPU_FREQUENCY_MHZ the device runs at, since the virtual
+  // clock stands still while code runs.
+  uint32_t getCycleCount();
+  [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
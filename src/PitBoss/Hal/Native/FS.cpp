@@ -0,0 +1,193 @@
+#include <FS.h>
+#include <SPIFFS.h>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+
+/**
+ * The simulated flash is an overlay: reads fall back to the project's data/
+ * directory (what uploadfs would flash) while every write lands in a scratch
+ * directory, so a session never modifies the source tree.
+ */
+static const char* IMAGE_DIR = "data";
+static const char* DEFAULT_SCRATCH_DIR = ".pio/native-spiffs";
+static const size_t SPIFFS_SIZE = 1408 * 1024;
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs {
+
+size_t File::write(uint8_t c) {
+  return this->write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buffer, size_t size) {
+  if (!this->_file) {
+    return 0;
+  }
+  return fwrite(buffer, 1, size, this->_file.get());
+}
+
+void File::flush() {
+  if (this->_file) {
+    fflush(this->_file.get());
+  }
+}
+
+int File::available() {
+  if (!this->_file) {
+    return 0;
+  }
+  return (int) (this->size() - this->position());
+}
+
+int File::read() {
+  if (!this->_file) {
+    return -1;
+  }
+  return fgetc(this->_file.get());
+}
+
+size_t File::read(uint8_t* buffer, size_t size) {
+  if (!this->_file) {
+    return 0;
+  }
+  return fread(buffer, 1, size, this->_file.get());
+}
+
+String File::readString() {
+  String out;
+  char buffer[256];
+  size_t n;
+  while (this->_file && (n = fread(buffer, 1, sizeof(buffer), this->_file.get())) > 0) {
+    out.concat(buffer, n);
+  }
+  return out;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!this->_file) {
+    return false;
+  }
+  return fseek(this->_file.get(), pos, mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END) == 0;
+}
+
+size_t File::position() const {
+  return this->_file ? ftell(this->_file.get()) : 0;
+}
+
+size_t File::size() const {
+  if (!this->_file) {
+    return 0;
+  }
+  struct stat st;
+  fflush(this->_file.get());
+  if (fstat(fileno(this->_file.get()), &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+void File::close() {
+  this->_file.reset();
+}
+
+static String scratchDir() {
+  auto dir = getenv("PITBOSS_SPIFFS_DIR");
+  return String(dir ? dir : DEFAULT_SCRATCH_DIR);
+}
+
+static void makeDirs(const String& path) {
+  for (int i = 1; i < (int) path.length(); i++) {
+    if (path[i] == '/') {
+      mkdir(path.substring(0, i).c_str(), 0755);
+    }
+  }
+  mkdir(path.c_str(), 0755);
+}
+
+static bool fileExists(const String& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+String FS::hostPath(const char* path) const {
+  return this->_root + (path[0] == '/' ? "" : "/") + path;
+}
+
+bool FS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles, const char* partitionLabel) {
+  this->_root = scratchDir();
+  makeDirs(this->_root);
+  this->_mounted = true;
+  return true;
+}
+
+void FS::end() {
+  this->_mounted = false;
+}
+
+File FS::open(const char* path, const char* mode) {
+  if (!this->_mounted) {
+    return File();
+  }
+  auto local = this->hostPath(path);
+  bool reading = mode[0] == 'r' && mode[1] != '+';
+  if (reading && !fileExists(local)) {
+    local = String(IMAGE_DIR) + path;
+  }
+  // The simulated flash is binary safe, like SPIFFS.
+  String hostMode(mode);
+  hostMode += "b";
+  auto file = fopen(local.c_str(), hostMode.c_str());
+  if (!file) {
+    return File();
+  }
+  return File(file, String(path));
+}
+
+bool FS::exists(const char* path) {
+  return fileExists(this->hostPath(path)) || fileExists(String(IMAGE_DIR) + path);
+}
+
+bool FS::remove(const char* path) {
+  return ::remove(this->hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+  return ::rename(this->hostPath(pathFrom).c_str(), this->hostPath(pathTo).c_str()) == 0;
+}
+
+size_t FS::totalBytes() {
+  return SPIFFS_SIZE;
+}
+
+size_t FS::usedBytes() {
+  size_t used = 0;
+  auto dir = opendir(this->_root.c_str());
+  if (!dir) {
+    return 0;
+  }
+  while (auto entry = readdir(dir)) {
+    struct stat st;
+    if (stat((this->_root + "/" + entry->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      used += st.st_size;
+    }
+  }
+  closedir(dir);
+  return used;
+}
+
+bool SPIFFSFS::format() {
+  auto dir = opendir(this->_root.c_str());
+  if (!dir) {
+    return false;
+  }
+  while (auto entry = readdir(dir)) {
+    ::remove((this->_root + "/" + entry->d_name).c_str());
+  }
+  closedir(dir);
+  return true;
+}
+
+}
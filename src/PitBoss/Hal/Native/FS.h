@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdio>
+#include <memory>
+#include <Arduino.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode {
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+/**
+ * Files are backed by a directory on the host (see FS::begin).
+ */
+class File : public Print {
+ protected:
+  std::shared_ptr<FILE> _file;
+  String _path;
+ public:
+  File() = default;
+  File(FILE* file, const String& path) :
+    _file(file, fclose),
+    _path(path)
+  {}
+
+  using Print::write;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  void flush() override;
+  int available();
+  int read();
+  size_t read(uint8_t* buffer, size_t size);
+  String readString();
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  const char* path() const {
+    return this->_path.c_str();
+  }
+  operator bool() const {
+    return (bool) this->_file;
+  }
+};
+
+class FS {
+ protected:
+  String _root;
+  bool _mounted = false;
+  String hostPath(const char* path) const;
+ public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10, const char* partitionLabel = nullptr);
+  void end();
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ) {
+    return this->open(path.c_str(), mode);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) {
+    return this->exists(path.c_str());
+  }
+  bool remove(const char* path);
+  bool remove(const String& path) {
+    return this->remove(path.c_str());
+  }
+  bool rename(const char* pathFrom, const char* pathTo);
+  size_t totalBytes();
+  size_t usedBytes();
+};
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <gfxfont.h>
+
+const GFXfont FreeSans18pt7b = SimulatedFont<16, 25, 19, -25, 42>::font();
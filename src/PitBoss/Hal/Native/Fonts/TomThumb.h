@@ -0,0 +1,5 @@
+#pragma once
+
+#include <gfxfont.h>
+
+const GFXfont TomThumb = SimulatedFont<3, 5, 4, -5, 6>::font();
@@ -0,0 +1,336 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <PitBoss/Hal/Simulation.h>
+#include "Scheduler.h"
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Simulation = PitBoss::Simulation;
+namespace Scheduler = PitBoss::Simulation::Scheduler;
+
+struct SimulatedTask {
+  enum State {
+    READY,
+    RUNNING,
+    BLOCKED,
+    DONE
+  };
+  std::string name;
+  TaskFunction_t function;
+  void* parameters;
+  uint32_t stackDepth;
+  UBaseType_t priority;
+  BaseType_t core;
+  State state = READY;
+  std::function<bool()> ready;
+  uint64_t wakeAtUs = 0;
+  uint32_t notifications = 0;
+  std::condition_variable wakeup;
+};
+
+struct SimulatedQueue {
+  size_t length;
+  size_t itemSize;
+  std::vector<uint8_t> storage;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+namespace {
+
+struct TaskExit {};
+
+// Whoever holds the baton runs; nullptr is the main loop.
+std::mutex baton;
+std::condition_variable mainWakeup;
+SimulatedTask* running = nullptr;
+thread_local SimulatedTask* self = nullptr;
+std::vector<SimulatedTask*> tasks;
+SimulatedTask loopTask{"loopTask", nullptr, nullptr, 8192, 1, APP_CPU_NUM, SimulatedTask::RUNNING};
+
+bool runnable(SimulatedTask* task, uint64_t now) {
+  switch (task->state) {
+    case SimulatedTask::READY:
+      return true;
+    case SimulatedTask::BLOCKED:
+      return now >= task->wakeAtUs || (task->ready && task->ready());
+    default:
+      return false;
+  }
+}
+
+// Runs every runnable task, highest priority first, until all are blocked.
+void runReady(std::unique_lock<std::mutex>& lock) {
+  for (;;) {
+    SimulatedTask* next = nullptr;
+    auto now = Simulation::micros();
+    for (auto task : tasks) {
+      if (runnable(task, now) && (!next || task->priority > next->priority)) {
+        next = task;
+      }
+    }
+    if (!next) {
+      return;
+    }
+    next->state = SimulatedTask::RUNNING;
+    running = next;
+    next->wakeup.notify_one();
+    mainWakeup.wait(lock, [](){ return running == nullptr; });
+  }
+}
+
+void taskMain(SimulatedTask* task) {
+  self = task;
+  {
+    std::unique_lock<std::mutex> lock(baton);
+    task->wakeup.wait(lock, [task](){ return running == task; });
+  }
+  try {
+    task->function(task->parameters);
+  } catch (const TaskExit&) {
+  }
+  std::unique_lock<std::mutex> lock(baton);
+  task->state = SimulatedTask::DONE;
+  running = nullptr;
+  mainWakeup.notify_one();
+}
+
+uint64_t deadline(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    return Scheduler::FOREVER;
+  }
+  return Simulation::micros() + (uint64_t) ticks * 1000 * portTICK_PERIOD_MS;
+}
+
+SimulatedTask* current() {
+  return self ? self : &loopTask;
+}
+
+}
+
+bool Scheduler::block(const std::function<bool()>& ready, uint64_t wakeAtUs) {
+  if (ready && ready()) {
+    return true;
+  }
+  std::unique_lock<std::mutex> lock(baton);
+  if (self) {
+    self->state = SimulatedTask::BLOCKED;
+    self->ready = ready;
+    self->wakeAtUs = wakeAtUs;
+    running = nullptr;
+    mainWakeup.notify_one();
+    self->wakeup.wait(lock, [](){ return running == self; });
+    self->ready = nullptr;
+    return ready && ready();
+  }
+  for (;;) {
+    runReady(lock);
+    if (ready && ready()) {
+      return true;
+    }
+    if (Simulation::micros() >= wakeAtUs) {
+      return false;
+    }
+    auto next = wakeAtUs;
+    for (auto task : tasks) {
+      if (task->state == SimulatedTask::BLOCKED && task->wakeAtUs < next) {
+        next = task->wakeAtUs;
+      }
+    }
+    if (next == Scheduler::FOREVER) {
+      // Nothing will ever happen: the main loop would deadlock on hardware.
+      return false;
+    }
+    Scheduler::setMicros(next);
+  }
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t) Simulation::micros();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask, BaseType_t xCoreID) {
+  auto task = new SimulatedTask{pcName, pvTaskCode, pvParameters, usStackDepth, uxPriority, xCoreID};
+  {
+    std::lock_guard<std::mutex> lock(baton);
+    tasks.push_back(task);
+  }
+  std::thread(taskMain, task).detach();
+  if (pvCreatedTask) {
+    *pvCreatedTask = task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask) {
+  return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+  if (!xTaskToDelete || xTaskToDelete == self) {
+    throw TaskExit();
+  }
+  std::lock_guard<std::mutex> lock(baton);
+  // The thread stays parked forever; it is never handed the baton again.
+  xTaskToDelete->state = SimulatedTask::DONE;
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend) {
+  if (xTaskToSuspend && xTaskToSuspend != self) {
+    return;
+  }
+  Scheduler::block(nullptr, Scheduler::FOREVER);
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+  Scheduler::block(nullptr, deadline(xTicksToDelay));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* pxPreviousWakeTime, TickType_t xTimeIncrement) {
+  *pxPreviousWakeTime += xTimeIncrement;
+  uint64_t wakeAt = (uint64_t) *pxPreviousWakeTime * 1000 * portTICK_PERIOD_MS;
+  if (wakeAt <= Simulation::micros()) {
+    return pdFALSE;
+  }
+  Scheduler::block(nullptr, wakeAt);
+  return pdTRUE;
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t) (Simulation::micros() / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return current();
+}
+
+char* pcTaskGetName(TaskHandle_t xTaskToQuery) {
+  return &(xTaskToQuery ? xTaskToQuery : current())->name[0];
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask) {
+  // Host threads have their own stacks; usage is not observable here.
+  return (xTask ? xTask : current())->stackDepth;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask) {
+  return (xTask ? xTask : current())->priority;
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask) {
+  return (xTask ? xTask : current())->core;
+}
+
+BaseType_t xPortGetCoreID() {
+  auto core = current()->core;
+  return core == tskNO_AFFINITY ? PRO_CPU_NUM : core;
+}
+
+void taskYIELD() {}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+  auto task = current();
+  if (!task->notifications && xTicksToWait) {
+    Scheduler::block([task](){ return task->notifications > 0; }, deadline(xTicksToWait));
+  }
+  auto value = task->notifications;
+  if (value) {
+    task->notifications = xClearCountOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+  xTaskToNotify->notifications++;
+  return pdPASS;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t uxQueueLength, UBaseType_t uxItemSize) {
+  auto queue = new SimulatedQueue{uxQueueLength, uxItemSize};
+  queue->storage.resize(uxQueueLength * uxItemSize);
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t xQueue) {
+  delete xQueue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t xQueue, const void* pvItemToQueue, TickType_t xTicksToWait) {
+  if (xQueue->count == xQueue->length) {
+    if (!xTicksToWait || !Scheduler::block([xQueue](){ return xQueue->count < xQueue->length; }, deadline(xTicksToWait))) {
+      return errQUEUE_FULL;
+    }
+  }
+  auto tail = (xQueue->head + xQueue->count) % xQueue->length;
+  if (xQueue->itemSize && pvItemToQueue) {
+    memcpy(&xQueue->storage[tail * xQueue->itemSize], pvItemToQueue, xQueue->itemSize);
+  }
+  xQueue->count++;
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t xQueue, const void* pvItemToQueue) {
+  xQueue->head = 0;
+  xQueue->count = 0;
+  return xQueueSend(xQueue, pvItemToQueue, 0);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  if (!xQueue->count) {
+    if (!xTicksToWait || !Scheduler::block([xQueue](){ return xQueue->count > 0; }, deadline(xTicksToWait))) {
+      return errQUEUE_EMPTY;
+    }
+  }
+  if (xQueue->itemSize && pvBuffer) {
+    memcpy(pvBuffer, &xQueue->storage[xQueue->head * xQueue->itemSize], xQueue->itemSize);
+  }
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void* pvBuffer, TickType_t xTicksToWait) {
+  if (xQueuePeek(xQueue, pvBuffer, xTicksToWait) != pdPASS) {
+    return errQUEUE_EMPTY;
+  }
+  xQueue->head = (xQueue->head + 1) % xQueue->length;
+  xQueue->count--;
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t xQueue) {
+  return xQueue->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t xQueue) {
+  return xQueue->length - xQueue->count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t xQueue) {
+  xQueue->head = 0;
+  xQueue->count = 0;
+  return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  auto semaphore = xQueueCreate(1, 0);
+  xSemaphoreGive(semaphore);
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime) {
+  return xQueueReceive(xSemaphore, nullptr, xBlockTime);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore) {
+  return xQueueSend(xSemaphore, nullptr, 0);
+}
@@ -0,0 +1,229 @@
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+#include <Wire.h>
+#include <PitBoss/Hal/Simulation.h>
+#include "Scheduler.h"
+
+namespace Simulation = PitBoss::Simulation;
+
+TwoWire Wire;
+
+// Blocks the caller for the bus time, as the polled ESP32 driver does.
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  auto busyMicros = Simulation::recordI2c(this->_pending, this->_clock);
+  this->_pending = 0;
+  Simulation::Scheduler::block(nullptr, Simulation::micros() + busyMicros);
+  return 0;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t i = x; i < x + w; i++) {
+    for (int16_t j = y; j < y + h; j++) {
+      this->drawPixel(i, j, color);
+    }
+  }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y) {
+  if (!this->gfxFont) {
+    // Classic 5x7 cell.
+    for (int8_t i = 0; i < 5; i++) {
+      uint8_t line = (uint8_t) (0x3E ^ (c << i));
+      for (int8_t j = 0; j < 8; j++, line >>= 1) {
+        if (line & 1) {
+          this->fillRect(x + i * size_x, y + j * size_y, size_x, size_y, color);
+        } else if (bg != color) {
+          this->fillRect(x + i * size_x, y + j * size_y, size_x, size_y, bg);
+        }
+      }
+    }
+    return;
+  }
+  c -= (uint8_t) this->gfxFont->first;
+  const GFXglyph* glyph = this->gfxFont->glyph + c;
+  const uint8_t* bitmap = this->gfxFont->bitmap;
+  uint16_t bo = glyph->bitmapOffset;
+  uint8_t w = glyph->width, h = glyph->height;
+  int8_t xo = glyph->xOffset, yo = glyph->yOffset;
+  uint8_t bits = 0, bit = 0;
+  for (uint8_t yy = 0; yy < h; yy++) {
+    for (uint8_t xx = 0; xx < w; xx++) {
+      if (!(bit++ & 7)) {
+        bits = bitmap[bo++];
+      }
+      if (bits & 0x80) {
+        if (size_x == 1 && size_y == 1) {
+          this->drawPixel(x + xo + xx, y + yo + yy, color);
+        } else {
+          this->fillRect(x + (xo + xx) * size_x, y + (yo + yy) * size_y, size_x, size_y, color);
+        }
+      }
+      bits <<= 1;
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (!this->gfxFont) {
+    if (c == '\n') {
+      this->cursor_x = 0;
+      this->cursor_y += this->textsize_y * 8;
+    } else if (c != '\r') {
+      if (this->wrap && this->cursor_x + this->textsize_x * 6 > this->_width) {
+        this->cursor_x = 0;
+        this->cursor_y += this->textsize_y * 8;
+      }
+      this->drawChar(this->cursor_x, this->cursor_y, c, this->textcolor, this->textbgcolor, this->textsize_x, this->textsize_y);
+      this->cursor_x += this->textsize_x * 6;
+    }
+    return 1;
+  }
+  if (c == '\n') {
+    this->cursor_x = 0;
+    this->cursor_y += (int16_t) this->textsize_y * this->gfxFont->yAdvance;
+  } else if (c != '\r') {
+    if (c >= this->gfxFont->first && c <= this->gfxFont->last) {
+      const GFXglyph* glyph = this->gfxFont->glyph + (c - this->gfxFont->first);
+      if (glyph->width > 0 && glyph->height > 0) {
+        int16_t xo = glyph->xOffset;
+        if (this->wrap && this->cursor_x + this->textsize_x * (xo + glyph->width) > this->_width) {
+          this->cursor_x = 0;
+          this->cursor_y += (int16_t) this->textsize_y * this->gfxFont->yAdvance;
+        }
+        this->drawChar(this->cursor_x, this->cursor_y, c, this->textcolor, this->textbgcolor, this->textsize_x, this->textsize_y);
+      }
+      this->cursor_x += glyph->xAdvance * (int16_t) this->textsize_x;
+    }
+  }
+  return 1;
+}
+
+void Adafruit_GFX::charBounds(unsigned char c, int16_t* x, int16_t* y, int16_t* minx, int16_t* miny, int16_t* maxx, int16_t* maxy) {
+  if (!this->gfxFont) {
+    if (c == '\n') {
+      *x = 0;
+      *y += this->textsize_y * 8;
+    } else if (c != '\r') {
+      int x2 = *x + this->textsize_x * 6 - 1, y2 = *y + this->textsize_y * 8 - 1;
+      *minx = std::min<int16_t>(*minx, *x);
+      *miny = std::min<int16_t>(*miny, *y);
+      *maxx = std::max<int16_t>(*maxx, x2);
+      *maxy = std::max<int16_t>(*maxy, y2);
+      *x += this->textsize_x * 6;
+    }
+    return;
+  }
+  if (c == '\n') {
+    *x = 0;
+    *y += this->textsize_y * this->gfxFont->yAdvance;
+  } else if (c != '\r' && c >= this->gfxFont->first && c <= this->gfxFont->last) {
+    const GFXglyph* glyph = this->gfxFont->glyph + (c - this->gfxFont->first);
+    int16_t x1 = *x + glyph->xOffset * this->textsize_x;
+    int16_t y1 = *y + glyph->yOffset * this->textsize_y;
+    int16_t x2 = x1 + glyph->width * this->textsize_x - 1;
+    int16_t y2 = y1 + glyph->height * this->textsize_y - 1;
+    if (x1 < *minx) *minx = x1;
+    if (y1 < *miny) *miny = y1;
+    if (x2 > *maxx) *maxx = x2;
+    if (y2 > *maxy) *maxy = y2;
+    *x += glyph->xAdvance * this->textsize_x;
+  }
+}
+
+void Adafruit_GFX::getTextBounds(const char* str, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h) {
+  int16_t minx = this->_width, miny = this->_height, maxx = -1, maxy = -1;
+  *x1 = x;
+  *y1 = y;
+  *w = *h = 0;
+  unsigned char c;
+  while ((c = *str++)) {
+    this->charBounds(c, &x, &y, &minx, &miny, &maxx, &maxy);
+  }
+  if (maxx >= minx) {
+    *x1 = minx;
+    *w = maxx - minx + 1;
+  }
+  if (maxy >= miny) {
+    *y1 = miny;
+    *h = maxy - miny + 1;
+  }
+}
+
+bool Adafruit_SSD1306::begin(uint8_t switchvcc, uint8_t i2caddr, bool reset, bool periphBegin) {
+  if (!this->_buffer && !(this->_buffer = (uint8_t*) malloc(this->_width * ((this->_height + 7) / 8)))) {
+    return false;
+  }
+  this->clearDisplay();
+  this->_i2caddr = i2caddr;
+  if (periphBegin) {
+    this->_wire->begin();
+  }
+  // Init sequence: 25 single-byte commands.
+  for (int i = 0; i < 25; i++) {
+    this->ssd1306_command(0);
+  }
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay() {
+  memset(this->_buffer, 0, this->_width * ((this->_height + 7) / 8));
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c) {
+  this->_wire->setClock(this->_clkDuring);
+  this->_wire->beginTransmission(this->_i2caddr);
+  this->_wire->write((uint8_t) 0x00);
+  this->_wire->write(c);
+  this->_wire->endTransmission();
+  this->_wire->setClock(this->_clkAfter);
+}
+
+void Adafruit_SSD1306::display() {
+  static const uint8_t addressing[] = {
+    SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0
+  };
+  this->_wire->setClock(this->_clkDuring);
+  this->_wire->beginTransmission(this->_i2caddr);
+  this->_wire->write((uint8_t) 0x00);
+  this->_wire->write(addressing, sizeof(addressing));
+  this->_wire->write((uint8_t) (this->_width - 1));
+  this->_wire->endTransmission();
+
+  // Data goes out in WIRE_MAX sized transmissions, each led by a 0x40 byte.
+  static const size_t WIRE_MAX = 32;
+  size_t count = this->_width * ((this->_height + 7) / 8);
+  uint8_t* ptr = this->_buffer;
+  this->_wire->beginTransmission(this->_i2caddr);
+  this->_wire->write((uint8_t) 0x40);
+  size_t bytesOut = 1;
+  while (count--) {
+    if (bytesOut >= WIRE_MAX) {
+      this->_wire->endTransmission();
+      this->_wire->beginTransmission(this->_i2caddr);
+      this->_wire->write((uint8_t) 0x40);
+      bytesOut = 1;
+    }
+    this->_wire->write(*ptr++);
+    bytesOut++;
+  }
+  this->_wire->endTransmission();
+  this->_wire->setClock(this->_clkAfter);
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || x >= this->_width || y < 0 || y >= this->_height) {
+    return;
+  }
+  auto& b = this->_buffer[x + (y / 8) * this->_width];
+  switch (color) {
+    case SSD1306_WHITE:
+      b |= (1 << (y & 7));
+      break;
+    case SSD1306_BLACK:
+      b &= ~(1 << (y & 7));
+      break;
+    case SSD1306_INVERSE:
+      b ^= (1 << (y & 7));
+      break;
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Print.h>
+
+/**
+ * Serial writes go to the simulation's serial sink (stdout by default).
+ */
+class HardwareSerial : public Print {
+ public:
+  using Print::write;
+  void begin(unsigned long baud) {}
+  void end() {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  void flush() override;
+  int available() {
+    return 0;
+  }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <WString.h>
+#include <Printable.h>
+
+#define INADDR_NONE ((uint32_t) 0xffffffffUL)
+
+class IPAddress : public Printable {
+ protected:
+  union {
+    uint8_t bytes[4];
+    uint32_t dword;
+  } _address;
+ public:
+  IPAddress() : IPAddress((uint32_t) 0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    this->_address.bytes[0] = a;
+    this->_address.bytes[1] = b;
+    this->_address.bytes[2] = c;
+    this->_address.bytes[3] = d;
+  }
+  IPAddress(uint32_t address) {
+    this->_address.dword = address;
+  }
+  operator uint32_t() const {
+    return this->_address.dword;
+  }
+  bool operator==(const IPAddress& rhs) const {
+    return this->_address.dword == rhs._address.dword;
+  }
+  uint8_t operator[](int index) const {
+    return this->_address.bytes[index];
+  }
+  String toString() const;
+  size_t printTo(Print& p) const override;
+};
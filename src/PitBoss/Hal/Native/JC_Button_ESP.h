@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Simulated JC_Button reading the simulation's button model.
+ */
+class Button {
+ protected:
+  uint8_t _pin;
+  uint32_t _dbTime;
+  bool _state = false;
+  bool _lastState = false;
+  bool _changed = false;
+  uint32_t _time = 0;
+  uint32_t _lastChange = 0;
+ public:
+  Button(uint8_t pin, uint32_t dbTime = 25, uint8_t puEnable = true, uint8_t invert = true) :
+    _pin(pin),
+    _dbTime(dbTime)
+  {}
+  void begin();
+  bool read();
+  bool isPressed() const {
+    return this->_state;
+  }
+  bool isReleased() const {
+    return !this->_state;
+  }
+  bool wasPressed() const {
+    return this->_state && this->_changed;
+  }
+  bool wasReleased() const {
+    return !this->_state && this->_changed;
+  }
+  bool pressedFor(uint32_t ms) const {
+    return this->_state && this->_time - this->_lastChange >= ms;
+  }
+  bool releasedFor(uint32_t ms) const {
+    return !this->_state && this->_time - this->_lastChange >= ms;
+  }
+  uint32_t lastChange() const {
+    return this->_lastChange;
+  }
+};
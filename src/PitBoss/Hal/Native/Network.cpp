@@ -0,0 +1,264 @@
+#include <WiFi.h>
+#include <climits>
+#include <WiFiManager.h>
+#include <ESPAsyncWebServer.h>
+#include <AsyncUDP.h>
+#include <PitBoss/Hal/Simulation.h>
+
+namespace Simulation = PitBoss::Simulation;
+
+WiFiClass WiFi;
+
+static const char* SIMULATED_SSID = "pitboss-sim";
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  WiFi._mode = mode;
+  return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+  return WiFi._mode;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid, bool connect) {
+  this->_connecting = true;
+  this->_connected = false;
+  this->_connectStartedAt = millis();
+  this->_connectMs = Simulation::WIFI_CONNECT_MS;
+  if (bssid && memcmp(bssid, Simulation::accessPointBssid(), 6) != 0) {
+    this->_connectMs = ULONG_MAX;
+  } else if (bssid && channel == Simulation::accessPointChannel()) {
+    this->_connectMs -= Simulation::WIFI_SCAN_MS;
+  }
+  if ((uint32_t) this->_staticIp) {
+    this->_connectMs -= std::min(this->_connectMs, Simulation::WIFI_DHCP_MS);
+  }
+  return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+  bool dhcp = (uint32_t) local == 0 || (uint32_t) local == INADDR_NONE;
+  this->_staticIp = dhcp ? IPAddress() : local;
+  this->_staticGateway = dhcp ? IPAddress() : gateway;
+  this->_staticSubnet = dhcp ? IPAddress() : subnet;
+  this->_staticDns = dhcp ? IPAddress() : dns1;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+  this->_connecting = false;
+  this->_connected = false;
+  return true;
+}
+
+bool WiFiClass::reconnect() {
+  this->begin();
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  auto apAvailable = Simulation::accessPointAvailable();
+  if (this->_connected && !apAvailable) {
+    // Lost the AP: the station keeps retrying if it is the ESP32's to do.
+    if (this->_autoReconnect) {
+      this->begin();
+    } else {
+      this->_connected = false;
+    }
+    this->raise(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    return WL_CONNECTION_LOST;
+  }
+  if (this->_connecting) {
+    if (!apAvailable) {
+      this->_connectStartedAt = millis();
+    } else if (millis() - this->_connectStartedAt >= this->_connectMs) {
+      this->_connecting = false;
+      this->_connected = true;
+      this->raise(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    }
+  }
+  return this->_connected ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+void WiFiClass::raise(WiFiEvent_t event) {
+  for (const auto& handler : this->_eventHandlers) {
+    if (handler.second == ARDUINO_EVENT_MAX || handler.second == event) {
+      handler.first(event, WiFiEventInfo_t());
+    }
+  }
+}
+
+int8_t WiFiClass::RSSI() {
+  return this->isConnected() ? (int8_t) Simulation::accessPointRssi() : 0;
+}
+
+String WiFiClass::SSID() const {
+  return this->_connected ? String(SIMULATED_SSID) : String();
+}
+
+IPAddress WiFiClass::localIP() {
+  if (!this->_connected) {
+    return IPAddress();
+  }
+  return (uint32_t) this->_staticIp ? this->_staticIp : IPAddress(192, 168, 1, 50);
+}
+
+IPAddress WiFiClass::gatewayIP() {
+  if (!this->_connected) {
+    return IPAddress();
+  }
+  return (uint32_t) this->_staticIp ? this->_staticGateway : IPAddress(192, 168, 1, 1);
+}
+
+IPAddress WiFiClass::subnetMask() {
+  if (!this->_connected) {
+    return IPAddress();
+  }
+  return (uint32_t) this->_staticIp ? this->_staticSubnet : IPAddress(255, 255, 255, 0);
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t dns_no) {
+  if (!this->_connected) {
+    return IPAddress();
+  }
+  return (uint32_t) this->_staticIp ? this->_staticDns : IPAddress(192, 168, 1, 1);
+}
+
+uint8_t* WiFiClass::BSSID() {
+  static uint8_t bssid[6];
+  memcpy(bssid, Simulation::accessPointBssid(), sizeof(bssid));
+  return this->_connected ? bssid : nullptr;
+}
+
+int32_t WiFiClass::channel() {
+  return this->_connected ? Simulation::accessPointChannel() : 0;
+}
+
+bool WiFiManager::getWiFiIsSaved() {
+  return Simulation::credentialsSaved();
+}
+
+bool WiFiManager::autoConnect(const char* apName, const char* apPassword) {
+  if (!Simulation::credentialsSaved()) {
+    this->_portalActive = true;
+    return false;
+  }
+  WiFi.begin();
+  return WiFi.isConnected();
+}
+
+bool WiFiManager::process() {
+  return WiFi.isConnected();
+}
+
+int WiFiManager::getRSSIasQuality(int RSSI) {
+  int quality = 0;
+  if (RSSI <= -100) {
+    quality = 0;
+  } else if (RSSI >= -50) {
+    quality = 100;
+  } else {
+    quality = 2 * (RSSI + 100);
+  }
+  return quality;
+}
+
+String WiFiManager::getWiFiSSID(bool persistent) {
+  return Simulation::credentialsSaved() ? String(SIMULATED_SSID) : String();
+}
+
+String WiFiManager::getWiFiPass(bool persistent) {
+  return Simulation::credentialsSaved() ? String("smoked-brisket") : String();
+}
+
+void WiFiManager::resetSettings() {
+  Simulation::forgetCredentials();
+  WiFi.disconnect();
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String& url, const std::vector<AsyncWebHeader>& headers, size_t contentLength) :
+  _method(method),
+  _headers(headers),
+  _contentLength(contentLength)
+{
+  auto query = url.indexOf('?');
+  this->_url = query < 0 ? url : url.substring(0, query);
+  while (query >= 0) {
+    auto next = url.indexOf('&', query + 1);
+    auto pair = url.substring(query + 1, next < 0 ? url.length() : next);
+    auto eq = pair.indexOf('=');
+    if (eq < 0) {
+      this->_params.emplace_back(pair, String());
+    } else {
+      this->_params.emplace_back(pair.substring(0, eq), pair.substring(eq + 1));
+    }
+    query = next;
+  }
+}
+
+std::unique_ptr<AsyncWebServerRequest> AsyncWebServer::dispatch(WebRequestMethodComposite method, const String& url, const String& body, const std::vector<AsyncWebHeader>& headers) {
+  Simulation::network().httpRequests++;
+  if (!this->_running) {
+    return nullptr;
+  }
+  std::unique_ptr<AsyncWebServerRequest> request(new AsyncWebServerRequest(method, url, headers, body.length()));
+  const Handler* match = nullptr;
+  for (const auto& handler : this->_handlers) {
+    if ((handler.method & method) && handler.uri == request->url()) {
+      match = &handler;
+      break;
+    }
+  }
+  if (match) {
+    if (match->onBody && body.length()) {
+      auto data = reinterpret_cast<uint8_t*>(const_cast<char*>(body.c_str()));
+      match->onBody(request.get(), data, body.length(), 0, body.length());
+    }
+    match->onRequest(request.get());
+  } else if (this->_notFound) {
+    this->_notFound(request.get());
+  }
+  return request;
+}
+
+AsyncWebServer::SimulatedResponse AsyncWebServer::handle(WebRequestMethodComposite method, const String& url, const String& body, const std::vector<AsyncWebHeader>& headers) {
+  auto request = this->dispatch(method, url, body, headers);
+  if (!request) {
+    return SimulatedResponse{0, String(), {}, String()};
+  }
+  SimulatedResponse out{404, String(), {}, String()};
+  if (auto response = request->response()) {
+    out.code = response->code();
+    out.contentType = response->contentType();
+    out.headers = response->headers();
+    response->render(out.body);
+  }
+  return out;
+}
+
+std::unique_ptr<AsyncWebServer::SimulatedStream> AsyncWebServer::open(const String& url, const std::vector<AsyncWebHeader>& headers) {
+  auto request = this->dispatch(HTTP_GET, url, String(), headers);
+  if (!request) {
+    return nullptr;
+  }
+  return std::unique_ptr<SimulatedStream>(new SimulatedStream(std::move(request)));
+}
+
+size_t AsyncUDP::write(const uint8_t* data, size_t len) {
+  if (!this->_connected) {
+    return 0;
+  }
+  Simulation::network().udpPackets++;
+  Simulation::network().udpBytes += len;
+  return len;
+}
+
+size_t AsyncUDP::writeTo(const uint8_t* data, size_t len, const IPAddress& addr, uint16_t port) {
+  Simulation::network().udpPackets++;
+  Simulation::network().udpBytes += len;
+  return len;
+}
+
+size_t AsyncUDP::broadcastTo(const uint8_t* data, size_t len, uint16_t port) {
+  return this->writeTo(data, len, IPAddress(255, 255, 255, 255), port);
+}
@@ -0,0 +1,54 @@
+#include <ArduinoLog.h>
+#include <jled.h>
+#include <JC_Button_ESP.h>
+#include <PitBoss/Hal/Simulation.h>
+
+namespace Simulation = PitBoss::Simulation;
+
+Logging Log;
+
+bool JLed::Update() {
+  if (this->_effect == NONE) {
+    return false;
+  }
+  if (this->_effect == CONSTANT) {
+    this->_brightness = this->_constant;
+    return this->_forever;
+  }
+  uint32_t cycle = this->_period + this->_delayAfter;
+  uint32_t t = (millis() - this->_startedAt) % (cycle ? cycle : 1);
+  if (t >= this->_period) {
+    this->_brightness = 0;
+  } else {
+    // Same shape as JLed's breathe: a raised cosine over the period.
+    double phase = (double) t / this->_period;
+    this->_brightness = (uint8_t) (127.5 * (1 - cos(2 * M_PI * phase)));
+  }
+  analogWrite(this->_pin, this->_brightness);
+  return true;
+}
+
+void Button::begin() {
+  this->_state = digitalRead(this->_pin) == LOW;
+  this->_time = millis();
+  this->_lastState = this->_state;
+  this->_changed = false;
+  this->_lastChange = this->_time;
+}
+
+bool Button::read() {
+  uint32_t ms = millis();
+  bool pinVal = digitalRead(this->_pin) == LOW;
+  if (ms - this->_lastChange < this->_dbTime) {
+    this->_changed = false;
+  } else {
+    this->_lastState = this->_state;
+    this->_state = pinVal;
+    this->_changed = this->_state != this->_lastState;
+    if (this->_changed) {
+      this->_lastChange = ms;
+    }
+  }
+  this->_time = ms;
+  return this->_state;
+}
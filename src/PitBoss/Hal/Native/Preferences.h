@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Simulated NVS namespace. Values live in memory for the life of the
+ * simulation, which is as long as flash would keep them.
+ */
+class Preferences {
+ protected:
+  std::string _namespace;
+  bool _open = false;
+
+  static std::map<std::string, std::vector<uint8_t>>& store() {
+    static std::map<std::string, std::vector<uint8_t>> values;
+    return values;
+  }
+  std::string path(const char* key) const {
+    return this->_namespace + "/" + key;
+  }
+ public:
+  bool begin(const char* name, bool readOnly = false, const char* partition_label = nullptr) {
+    this->_namespace = name;
+    this->_open = true;
+    return true;
+  }
+  void end() {
+    this->_open = false;
+  }
+  size_t putBytes(const char* key, const void* value, size_t len) {
+    if (!this->_open) {
+      return 0;
+    }
+    auto bytes = static_cast<const uint8_t*>(value);
+    store()[this->path(key)].assign(bytes, bytes + len);
+    return len;
+  }
+  size_t getBytesLength(const char* key) {
+    auto value = store().find(this->path(key));
+    return this->_open && value != store().end() ? value->second.size() : 0;
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    auto length = this->getBytesLength(key);
+    if (length == 0 || length > maxLen) {
+      return 0;
+    }
+    memcpy(buf, store()[this->path(key)].data(), length);
+    return length;
+  }
+  bool remove(const char* key) {
+    return this->_open && store().erase(this->path(key)) > 0;
+  }
+};
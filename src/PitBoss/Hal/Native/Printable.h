@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+class Print;
+
+class Printable {
+ public:
+  virtual ~Printable() = default;
+  virtual size_t printTo(Print& p) const = 0;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <FS.h>
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+ public:
+  bool format();
+};
+
+}
+
+extern fs::SPIFFSFS SPIFFS;
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace PitBoss {
+
+namespace Simulation {
+
+namespace Scheduler {
+
+static const uint64_t FOREVER = UINT64_MAX;
+
+/**
+ * Blocks the calling task, or the main loop, until `ready` holds or the
+ * virtual clock reaches `wakeAtUs`, letting other tasks run in between.
+ * Returns whether `ready` held. Only the main loop moves the clock forward.
+ */
+bool block(const std::function<bool()>& ready, uint64_t wakeAtUs);
+
+void setMicros(uint64_t us);
+
+}
+
+}
+
+}
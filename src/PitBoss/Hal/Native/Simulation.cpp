@@ -0,0 +1,289 @@
+#include <PitBoss/Hal/Simulation.h>
+#include <PitBoss/HeapMonitor.h>
+#include "Scheduler.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+
+namespace PitBoss {
+
+namespace Simulation {
+
+namespace {
+
+uint64_t clockMicros = 0;
+
+bool thermocoupleConnected[MAX_PROBES] = {true, true, true, true};
+double thermocoupleHot[MAX_PROBES] = {21.0, 21.0, 21.0, 21.0};
+double thermocoupleCold = 21.0;
+double thermocoupleNoise = 0;
+unsigned thermocoupleSpikeEvery = 0;
+double thermocoupleSpike = 0;
+uint32_t thermocoupleReads = 0;
+uint32_t thermocoupleNoiseState = 0x9E3779B9;
+
+bool apAvailable = false;
+int apRssi = -60;
+bool credentials = true;
+uint8_t apBssid[6] = {0x24, 0x4b, 0xfe, 0x10, 0x20, 0x30};
+int32_t apChannel = 6;
+
+bool button = false;
+
+FILE* serialSink = stdout;
+
+BusStats spiStats;
+BusStats i2cStats;
+NetworkStats networkStats;
+
+std::atomic<size_t> heapLive(0);
+std::atomic<size_t> heapPeak(0);
+std::atomic<unsigned long> heapAllocations(0);
+std::atomic<unsigned long> heapFrees(0);
+
+}
+
+uint64_t micros() {
+  return clockMicros;
+}
+
+void advance(unsigned long ms) {
+  advanceMicros((uint64_t) ms * 1000);
+}
+
+void advanceMicros(uint64_t us) {
+  // Tasks that come due along the way run at their own deadlines.
+  auto target = clockMicros + us;
+  Scheduler::block(nullptr, target);
+  if (clockMicros < target) {
+    clockMicros = target;
+  }
+}
+
+void Scheduler::setMicros(uint64_t us) {
+  clockMicros = us;
+}
+
+void setThermocouple(double hotJunction, double coldJunction) {
+  thermocoupleHot[0] = hotJunction;
+  thermocoupleCold = coldJunction;
+}
+
+void setProbe(size_t probe, double hotJunction) {
+  if (probe < MAX_PROBES) {
+    thermocoupleHot[probe] = hotJunction;
+  }
+}
+
+void unplugThermocouple(size_t probe) {
+  if (probe < MAX_PROBES) {
+    thermocoupleConnected[probe] = false;
+  }
+}
+
+void plugThermocouple(size_t probe) {
+  if (probe < MAX_PROBES) {
+    thermocoupleConnected[probe] = true;
+  }
+}
+
+void setThermocoupleNoise(double amplitude, unsigned spikeEvery, double spikeAmplitude) {
+  thermocoupleNoise = amplitude;
+  thermocoupleSpikeEvery = spikeEvery;
+  thermocoupleSpike = spikeAmplitude;
+}
+
+static double thermocoupleReading(size_t probe) {
+  thermocoupleReads++;
+  thermocoupleNoiseState ^= thermocoupleNoiseState << 13;
+  thermocoupleNoiseState ^= thermocoupleNoiseState >> 17;
+  thermocoupleNoiseState ^= thermocoupleNoiseState << 5;
+  double reading = thermocoupleHot[probe] + thermocoupleNoise * ((double) thermocoupleNoiseState / UINT32_MAX * 2 - 1);
+  if (thermocoupleSpikeEvery && thermocoupleReads % thermocoupleSpikeEvery == 0) {
+    reading += thermocoupleSpike;
+  }
+  return reading;
+}
+
+uint32_t thermocoupleFrame(size_t probe) {
+  // A chip select with no MAX31855 behind it reads as all zeros.
+  if (probe >= MAX_PROBES) {
+    return 0;
+  }
+  // D15..D4: cold junction, 12 bit signed, 0.0625 C/LSB.
+  uint32_t frame = ((uint32_t) ((int32_t) (thermocoupleCold * 16) & 0xFFF)) << 4;
+  if (!thermocoupleConnected[probe]) {
+    // D16: fault, D0: open circuit.
+    return frame | (1 << 16) | 0x1;
+  }
+  // D31..D18: hot junction, 14 bit signed, 0.25 C/LSB.
+  frame |= ((uint32_t) ((int32_t) lround(thermocoupleReading(probe) * 4) & 0x3FFF)) << 18;
+  return frame;
+}
+
+void setAccessPoint(bool available, int rssi) {
+  apAvailable = available;
+  apRssi = rssi;
+}
+
+bool accessPointAvailable() {
+  return apAvailable;
+}
+
+int accessPointRssi() {
+  return apRssi;
+}
+
+bool credentialsSaved() {
+  return credentials;
+}
+
+const uint8_t* accessPointBssid() {
+  return apBssid;
+}
+
+int32_t accessPointChannel() {
+  return apChannel;
+}
+
+void moveAccessPoint(const uint8_t* bssid, int32_t channel) {
+  memcpy(apBssid, bssid, sizeof(apBssid));
+  apChannel = channel;
+}
+
+void forgetCredentials() {
+  credentials = false;
+}
+
+void setButton(bool pressed) {
+  if (button != pressed) {
+    button = pressed;
+    fireInterrupts();
+  }
+}
+
+bool buttonPressed() {
+  return button;
+}
+
+void setSerialOutput(FILE* out) {
+  serialSink = out;
+}
+
+FILE* serialOutput() {
+  return serialSink;
+}
+
+void recordSpi(size_t bytes, unsigned long clockHz) {
+  spiStats.transactions++;
+  spiStats.bytes += bytes;
+  spiStats.busyMicros += (bytes * 8 * 1000000UL) / clockHz;
+}
+
+unsigned long recordI2c(size_t bytes, unsigned long clockHz) {
+  // Address byte plus an ACK bit per byte.
+  auto busyMicros = ((bytes + 1) * 9 * 1000000UL) / clockHz;
+  i2cStats.transactions++;
+  i2cStats.bytes += bytes;
+  i2cStats.busyMicros += busyMicros;
+  return busyMicros;
+}
+
+BusStats& spi() {
+  return spiStats;
+}
+
+BusStats& i2c() {
+  return i2cStats;
+}
+
+NetworkStats& network() {
+  return networkStats;
+}
+
+HeapStats heap() {
+  HeapStats stats;
+  stats.liveBytes = heapLive;
+  stats.peakBytes = heapPeak;
+  stats.allocations = heapAllocations;
+  stats.frees = heapFrees;
+  return stats;
+}
+
+void resetStats() {
+  spiStats = BusStats();
+  i2cStats = BusStats();
+  networkStats = NetworkStats();
+  heapPeak = heapLive.load();
+  heapAllocations = 0;
+  heapFrees = 0;
+}
+
+void recordAllocation(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  auto live = heapLive += malloc_usable_size(ptr);
+  heapAllocations++;
+  HeapMonitor::recordAllocation();
+  auto peak = heapPeak.load();
+  while (live > peak && !heapPeak.compare_exchange_weak(peak, live)) {}
+}
+
+void recordFree(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  heapLive -= malloc_usable_size(ptr);
+  heapFrees++;
+}
+
+}
+
+}
+
+using PitBoss::Simulation::recordAllocation;
+using PitBoss::Simulation::recordFree;
+
+void* operator new(size_t size) {
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  recordAllocation(ptr);
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  void* ptr = malloc(size ? size : 1);
+  recordAllocation(ptr);
+  return ptr;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+  recordFree(ptr);
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  operator delete(ptr);
+}
@@ -0,0 +1,78 @@
+#include <driver/spi_master.h>
+#include <PitBoss/Hal/Simulation.h>
+
+namespace Simulation = PitBoss::Simulation;
+
+struct spi_device_t {
+  spi_host_device_t host;
+  spi_device_interface_config_t config;
+  size_t probe;
+  spi_transaction_t* queued;
+};
+
+static bool busInitialized[3] = {false, false, false};
+static size_t busDevices[3] = {0, 0, 0};
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t* bus_config, int dma_chan) {
+  if (busInitialized[host]) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  busInitialized[host] = true;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host) {
+  busInitialized[host] = false;
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t* dev_config, spi_device_handle_t* handle) {
+  if (!busInitialized[host]) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  *handle = new spi_device_t{host, *dev_config, busDevices[host]++, nullptr};
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle) {
+  delete handle;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc) {
+  size_t bits = trans_desc->rxlength ? trans_desc->rxlength : trans_desc->length;
+  uint8_t* rx = trans_desc->flags & SPI_TRANS_USE_RXDATA
+    ? trans_desc->rx_data
+    : static_cast<uint8_t*>(trans_desc->rx_buffer);
+  if (!rx || bits == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // The MAX31855 shifts its frame out MSB first and repeats zeros after it.
+  uint32_t frame = Simulation::thermocoupleFrame(handle->probe);
+  for (size_t i = 0; i < (bits + 7) / 8; i++) {
+    rx[i] = i < 4 ? (uint8_t) (frame >> (24 - 8 * i)) : 0;
+  }
+  Simulation::recordSpi((bits + 7) / 8, handle->config.clock_speed_hz);
+  return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t* trans_desc) {
+  return spi_device_polling_transmit(handle, trans_desc);
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t* trans_desc, uint32_t ticks_to_wait) {
+  if (handle->queued) {
+    return ESP_ERR_TIMEOUT;
+  }
+  handle->queued = trans_desc;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t** trans_desc, uint32_t ticks_to_wait) {
+  if (!handle->queued) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *trans_desc = handle->queued;
+  handle->queued = nullptr;
+  return spi_device_polling_transmit(handle, *trans_desc);
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class StringSumHelper;
+
+/**
+ * Host stand-in for the Arduino String. Backed by std::string so heap
+ * behaviour (including the copies the firmware makes) shows up in the
+ * simulation's allocation accounting.
+ */
+class String {
+ protected:
+  std::string _buffer;
+ public:
+  String() = default;
+  String(const String& other) = default;
+  String(String&& other) = default;
+  String(const char* cstr) : _buffer(cstr ? cstr : "") {}
+  String(const __FlashStringHelper* str) : String(reinterpret_cast<const char*>(str)) {}
+  explicit String(char c) : _buffer(1, c) {}
+  explicit String(unsigned char value, unsigned char base = DEC) : String((unsigned long) value, base) {}
+  explicit String(int value, unsigned char base = DEC) : String((long) value, base) {}
+  explicit String(unsigned int value, unsigned char base = DEC) : String((unsigned long) value, base) {}
+  explicit String(long value, unsigned char base = DEC);
+  explicit String(unsigned long value, unsigned char base = DEC);
+  explicit String(float value, unsigned int decimalPlaces = 2) : String((double) value, decimalPlaces) {}
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  String& operator=(const String& rhs) = default;
+  String& operator=(String&& rhs) = default;
+  String& operator=(const char* cstr) {
+    this->_buffer = cstr ? cstr : "";
+    return *this;
+  }
+
+  bool reserve(unsigned int size) {
+    this->_buffer.reserve(size);
+    return true;
+  }
+  unsigned int length() const {
+    return this->_buffer.length();
+  }
+  bool isEmpty() const {
+    return this->_buffer.empty();
+  }
+  void clear() {
+    this->_buffer.clear();
+  }
+  const char* c_str() const {
+    return this->_buffer.c_str();
+  }
+  char* begin() {
+    return &this->_buffer[0];
+  }
+  char* end() {
+    return this->begin() + this->length();
+  }
+
+  bool concat(const String& str) {
+    this->_buffer += str._buffer;
+    return true;
+  }
+  bool concat(const char* cstr) {
+    if (!cstr) {
+      return false;
+    }
+    this->_buffer += cstr;
+    return true;
+  }
+  bool concat(const char* cstr, unsigned int length) {
+    this->_buffer.append(cstr, length);
+    return true;
+  }
+  bool concat(char c) {
+    this->_buffer += c;
+    return true;
+  }
+  bool concat(int value) {
+    return this->concat(String(value));
+  }
+  bool concat(unsigned long value) {
+    return this->concat(String(value));
+  }
+  bool concat(double value) {
+    return this->concat(String(value));
+  }
+  template<typename T>
+  String& operator+=(const T& rhs) {
+    this->concat(rhs);
+    return *this;
+  }
+
+  bool equals(const String& s) const {
+    return this->_buffer == s._buffer;
+  }
+  bool equals(const char* cstr) const {
+    return this->_buffer == (cstr ? cstr : "");
+  }
+  bool operator==(const String& rhs) const {
+    return this->equals(rhs);
+  }
+  bool operator==(const char* cstr) const {
+    return this->equals(cstr);
+  }
+  bool operator!=(const String& rhs) const {
+    return !this->equals(rhs);
+  }
+  bool operator!=(const char* cstr) const {
+    return !this->equals(cstr);
+  }
+  bool operator<(const String& rhs) const {
+    return this->_buffer < rhs._buffer;
+  }
+  char operator[](unsigned int index) const {
+    return index < this->_buffer.length() ? this->_buffer[index] : 0;
+  }
+  char charAt(unsigned int index) const {
+    return (*this)[index];
+  }
+
+  int indexOf(char c, unsigned int fromIndex = 0) const {
+    auto pos = this->_buffer.find(c, fromIndex);
+    return pos == std::string::npos ? -1 : (int) pos;
+  }
+  int indexOf(const String& str, unsigned int fromIndex = 0) const {
+    auto pos = this->_buffer.find(str._buffer, fromIndex);
+    return pos == std::string::npos ? -1 : (int) pos;
+  }
+  bool startsWith(const String& prefix) const {
+    return this->_buffer.compare(0, prefix.length(), prefix._buffer) == 0;
+  }
+  String substring(unsigned int beginIndex) const {
+    return this->substring(beginIndex, this->length());
+  }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const {
+    if (beginIndex > this->length()) {
+      return String();
+    }
+    String out;
+    out._buffer = this->_buffer.substr(beginIndex, endIndex - beginIndex);
+    return out;
+  }
+  long toInt() const {
+    return std::strtol(this->c_str(), nullptr, 10);
+  }
+  double toDouble() const {
+    return std::strtod(this->c_str(), nullptr);
+  }
+  float toFloat() const {
+    return (float) this->toDouble();
+  }
+
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr);
+  friend StringSumHelper& operator+(const StringSumHelper& lhs, char c);
+};
+
+class StringSumHelper : public String {
+ public:
+  StringSumHelper(const String& s) : String(s) {}
+  StringSumHelper(const char* p) : String(p) {}
+};
+
+inline StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs) {
+  auto& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(rhs);
+  return a;
+}
+
+inline StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr) {
+  auto& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(cstr);
+  return a;
+}
+
+inline StringSumHelper& operator+(const StringSumHelper& lhs, char c) {
+  auto& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(c);
+  return a;
+}
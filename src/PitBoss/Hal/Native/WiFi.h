@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <esp_wifi_types.h>
+#include <functional>
+#include <utility>
+#include <vector>
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+  ARDUINO_EVENT_MAX = 41
+} arduino_event_id_t;
+typedef arduino_event_id_t WiFiEvent_t;
+typedef struct {} WiFiEventInfo_t;
+typedef std::function<void(WiFiEvent_t event, WiFiEventInfo_t info)> WiFiEventFuncCb;
+typedef size_t wifi_event_id_t;
+
+/**
+ * Simulated station interface. A connection attempt completes
+ * Simulation::WIFI_CONNECT_MS after begin() if the access point is up, or
+ * sooner given its BSSID and channel or a static IP, and never if the BSSID
+ * is not the access point's. It drops as soon as the access point goes away,
+ * and retries by itself unless auto reconnect is off. Events are raised as
+ * status() notices the change rather than from a WiFi task.
+ */
+class WiFiClass {
+ protected:
+  bool _connecting = false;
+  unsigned long _connectStartedAt = 0;
+  unsigned long _connectMs = 0;
+  bool _connected = false;
+  bool _autoReconnect = true;
+  IPAddress _staticIp;
+  IPAddress _staticGateway;
+  IPAddress _staticSubnet;
+  IPAddress _staticDns;
+  wifi_mode_t _mode = WIFI_MODE_NULL;
+  std::vector<std::pair<WiFiEventFuncCb, WiFiEvent_t>> _eventHandlers;
+  void raise(WiFiEvent_t event);
+ public:
+  wifi_event_id_t onEvent(WiFiEventFuncCb handler, WiFiEvent_t event = ARDUINO_EVENT_MAX) {
+    this->_eventHandlers.emplace_back(handler, event);
+    return this->_eventHandlers.size();
+  }
+  static bool mode(wifi_mode_t mode);
+  static wifi_mode_t getMode();
+
+  wl_status_t begin(const char* ssid = nullptr, const char* passphrase = nullptr, int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+  // A local IP of 0 or INADDR_NONE goes back to DHCP.
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t) 0, IPAddress dns2 = (uint32_t) 0);
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  bool reconnect();
+  // There is one simulated access point, so how it is found makes no odds.
+  void setScanMethod(wifi_scan_method_t scanMethod) {}
+  void setSortMethod(wifi_sort_method_t sortMethod) {}
+  bool setAutoReconnect(bool autoReconnect) {
+    this->_autoReconnect = autoReconnect;
+    return true;
+  }
+  bool getAutoReconnect() const {
+    return this->_autoReconnect;
+  }
+  void persistent(bool persistent) {}
+  wl_status_t status();
+  bool isConnected() {
+    return this->status() == WL_CONNECTED;
+  }
+  int8_t RSSI();
+  String SSID() const;
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t dns_no = 0);
+  uint8_t* BSSID();
+  int32_t channel();
+};
+
+extern WiFiClass WiFi;
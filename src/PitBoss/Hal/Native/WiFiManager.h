@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define WIFI_getChipId() (uint32_t) ESP.getEfuseMac()
+
+const wifi_country_t WM_COUNTRY_US{"US", 1, 11, 78, WIFI_COUNTRY_POLICY_AUTO};
+const wifi_country_t WM_COUNTRY_CN{"CN", 1, 13, 78, WIFI_COUNTRY_POLICY_AUTO};
+const wifi_country_t WM_COUNTRY_JP{"JP", 1, 14, 78, WIFI_COUNTRY_POLICY_AUTO};
+
+/**
+ * Simulated WiFiManager. The config portal never completes on its own; with
+ * saved credentials autoConnect() starts a station connection and returns.
+ */
+class WiFiManager {
+ protected:
+  bool _portalActive = false;
+  bool _blocking = true;
+ public:
+  void setDebugOutput(bool debug) {}
+  bool setCountry(String cc) {
+    return true;
+  }
+  void setConfigPortalBlocking(bool shouldBlock) {
+    this->_blocking = shouldBlock;
+  }
+  void setWiFiAutoReconnect(bool enabled) {
+    WiFi.setAutoReconnect(enabled);
+  }
+  bool getWiFiIsSaved();
+  bool autoConnect(const char* apName, const char* apPassword = nullptr);
+  bool process();
+  int getRSSIasQuality(int RSSI);
+  String getWiFiSSID(bool persistent = true);
+  String getWiFiPass(bool persistent = true);
+  void resetSettings();
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define I2C_BUFFER_LENGTH 128
+
+/**
+ * Simulated I2C master. Bytes and bus time are accounted per transmission at
+ * the configured clock so render/flush changes show up as bus occupancy, and
+ * the sender is held for that time on the virtual clock.
+ */
+class TwoWire {
+ protected:
+  uint32_t _clock = 100000;
+  size_t _pending = 0;
+ public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+    if (frequency) {
+      this->_clock = frequency;
+    }
+    return true;
+  }
+  bool setClock(uint32_t frequency) {
+    this->_clock = frequency;
+    return true;
+  }
+  uint32_t getClock() const {
+    return this->_clock;
+  }
+  void beginTransmission(uint16_t address) {
+    this->_pending = 1;
+  }
+  size_t write(uint8_t data) {
+    this->_pending++;
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t size) {
+    this->_pending += size;
+    return size;
+  }
+  uint8_t endTransmission(bool sendStop = true);
+};
+
+extern TwoWire Wire;
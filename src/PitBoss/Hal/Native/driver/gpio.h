@@ -0,0 +1,32 @@
+#pragma once
+
+typedef enum {
+  GPIO_NUM_NC = -1,
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_1,
+  GPIO_NUM_2,
+  GPIO_NUM_3,
+  GPIO_NUM_4,
+  GPIO_NUM_5,
+  GPIO_NUM_12 = 12,
+  GPIO_NUM_13,
+  GPIO_NUM_14,
+  GPIO_NUM_15,
+  GPIO_NUM_16,
+  GPIO_NUM_17,
+  GPIO_NUM_18,
+  GPIO_NUM_19,
+  GPIO_NUM_21 = 21,
+  GPIO_NUM_22,
+  GPIO_NUM_23,
+  GPIO_NUM_25 = 25,
+  GPIO_NUM_26,
+  GPIO_NUM_27,
+  GPIO_NUM_32 = 32,
+  GPIO_NUM_33,
+  GPIO_NUM_34,
+  GPIO_NUM_35,
+  GPIO_NUM_36,
+  GPIO_NUM_39 = 39,
+  GPIO_NUM_MAX,
+} gpio_num_t;
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Microseconds since boot on the simulation's virtual clock.
+int64_t esp_timer_get_time();
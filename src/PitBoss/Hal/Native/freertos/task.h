@@ -0,0 +1,32 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+typedef void (*TaskFunction_t)(void*);
+typedef struct SimulatedTask* TaskHandle_t;
+
+/**
+ * Simulated FreeRTOS tasks. Each task is a host thread, but only one of the
+ * tasks and the main loop runs at any time and blocked tasks only resume when
+ * the simulation's virtual clock reaches their deadline, so sessions remain
+ * deterministic.
+ */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask, BaseType_t xCoreID);
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char* pcName, uint32_t usStackDepth, void* pvParameters, UBaseType_t uxPriority, TaskHandle_t* pvCreatedTask);
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+// Only a task suspending itself is modelled; it never runs again.
+void vTaskSuspend(TaskHandle_t xTaskToSuspend);
+void vTaskDelay(TickType_t xTicksToDelay);
+BaseType_t xTaskDelayUntil(TickType_t* pxPreviousWakeTime, TickType_t xTimeIncrement);
+#define vTaskDelayUntil(pxPreviousWakeTime, xTimeIncrement) ((void) xTaskDelayUntil(pxPreviousWakeTime, xTimeIncrement))
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+char* pcTaskGetName(TaskHandle_t xTaskToQuery);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t xTask);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t xTask);
+BaseType_t xTaskGetAffinity(TaskHandle_t xTask);
+BaseType_t xPortGetCoreID();
+void taskYIELD();
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+typedef struct {
+  uint16_t bitmapOffset;
+  uint8_t width;
+  uint8_t height;
+  uint8_t xAdvance;
+  int8_t xOffset;
+  int8_t yOffset;
+} GFXglyph;
+
+typedef struct {
+  uint8_t* bitmap;
+  GFXglyph* glyph;
+  uint16_t first;
+  uint16_t last;
+  uint8_t yAdvance;
+} GFXfont;
+
+/**
+ * The real font tables are generated from TTFs and are not needed to exercise
+ * the renderer, so the host build substitutes glyphs of the same box size with
+ * a fixed checker pattern. Rasterization cost per glyph stays comparable.
+ */
+template<uint8_t W, uint8_t H, uint8_t ADVANCE, int8_t Y_OFFSET, uint8_t Y_ADVANCE>
+struct SimulatedFont {
+  static const uint16_t FIRST = 0x20;
+  static const uint16_t LAST = 0x7E;
+  static uint8_t bitmap[(W * H + 7) / 8];
+  static GFXglyph glyphs[LAST - FIRST + 1];
+
+  static GFXfont font() {
+    for (auto& b : bitmap) {
+      b = 0xA5;
+    }
+    for (auto& g : glyphs) {
+      g = GFXglyph{0, W, H, ADVANCE, 1, Y_OFFSET};
+    }
+    // Space renders nothing but still advances the cursor.
+    glyphs[0] = GFXglyph{0, 0, 0, ADVANCE, 0, 1};
+    return GFXfont{bitmap, glyphs, FIRST, LAST, Y_ADVANCE};
+  }
+};
+
+template<uint8_t W, uint8_t H, uint8_t A, int8_t Y, uint8_t YA>
+uint8_t SimulatedFont<W, H, A, Y, YA>::bitmap[(W * H + 7) / 8];
+
+template<uint8_t W, uint8_t H, uint8_t A, int8_t Y, uint8_t YA>
+GFXglyph SimulatedFont<W, H, A, Y, YA>::glyphs[SimulatedFont<W, H, A, Y, YA>::LAST - SimulatedFont<W, H, A, Y, YA>::FIRST + 1];
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Simulated JLed. Effects are evaluated on Update() like the real library so
+ * the per-iteration cost is represented; the result goes nowhere.
+ */
+class JLed {
+ protected:
+  enum Effect {
+    NONE,
+    CONSTANT,
+    BREATHE
+  };
+  uint8_t _pin;
+  Effect _effect = NONE;
+  uint8_t _constant = 0;
+  uint16_t _period = 0;
+  uint16_t _delayAfter = 0;
+  bool _forever = false;
+  unsigned long _startedAt = 0;
+  uint8_t _brightness = 0;
+ public:
+  JLed(uint8_t pin) :
+    _pin(pin)
+  {}
+  JLed& On() {
+    return this->set(CONSTANT, 255);
+  }
+  JLed& Off() {
+    return this->set(CONSTANT, 0);
+  }
+  JLed& Breathe(uint16_t period) {
+    this->set(BREATHE, 0);
+    this->_period = period;
+    return *this;
+  }
+  JLed& Forever() {
+    this->_forever = true;
+    return *this;
+  }
+  JLed& DelayAfter(uint16_t delay) {
+    this->_delayAfter = delay;
+    return *this;
+  }
+  JLed& Reset() {
+    this->_startedAt = millis();
+    return *this;
+  }
+  JLed& Stop() {
+    this->_effect = NONE;
+    this->_brightness = 0;
+    return *this;
+  }
+  // Like JLed, a constant is done once applied; breathing forever never is.
+  bool IsRunning() const {
+    return this->_effect == BREATHE || (this->_effect == CONSTANT && this->_brightness != this->_constant);
+  }
+  bool Update();
+ protected:
+  JLed& set(Effect effect, uint8_t constant) {
+    this->_effect = effect;
+    this->_constant = constant;
+    this->_forever = false;
+    this->_delayAfter = 0;
+    this->_startedAt = millis();
+    return *this;
+  }
+};
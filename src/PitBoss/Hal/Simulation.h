@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace PitBoss {
+
+namespace Simulation {
+
+/**
+ * Control surface for the host build. Everything the firmware would normally
+ * get from the board (time, the MAX31855, the access point, the button) is
+ * driven from here so a session can be scripted and replayed identically.
+ */
+
+struct BusStats {
+  unsigned long transactions = 0;
+  unsigned long bytes = 0;
+  unsigned long busyMicros = 0;
+};
+
+struct HeapStats {
+  size_t liveBytes = 0;
+  size_t peakBytes = 0;
+  unsigned long allocations = 0;
+  unsigned long frees = 0;
+};
+
+struct NetworkStats {
+  unsigned long udpPackets = 0;
+  unsigned long udpBytes = 0;
+  unsigned long httpRequests = 0;
+  unsigned long serialBytes = 0;
+};
+
+static const size_t HEAP_SIZE = 320 * 1024;
+static const unsigned long SPI_CLOCK_HZ = 5000000;
+static const unsigned long I2C_CLOCK_HZ = 400000;
+
+// Virtual clock. Only ever moves when the driver advances it.
+uint64_t micros();
+void advance(unsigned long ms);
+void advanceMicros(uint64_t us);
+
+// Wall clock: seconds since boot until configTime() "syncs" it to NTP_EPOCH,
+// then advancing with the virtual clock. time() reads it.
+static const long NTP_EPOCH = 1615037000;
+
+// MAX31855 model, one per probe, all sharing the cold junction. Every probe
+// starts plugged in at 21 C; setThermocouple() sets probe 0.
+static const size_t MAX_PROBES = 4;
+void setThermocouple(double hotJunction, double coldJunction);
+void setProbe(size_t probe, double hotJunction);
+void unplugThermocouple(size_t probe = 0);
+void plugThermocouple(size_t probe = 0);
+// Uniform noise of +/- amplitude on each hot junction reading, plus a spike
+// of spikeAmplitude (EMI from the fan, the door opening) on one reading in
+// spikeEvery. Deterministic, so sessions still repeat exactly.
+void setThermocoupleNoise(double amplitude, unsigned spikeEvery = 0, double spikeAmplitude = 0);
+uint32_t thermocoupleFrame(size_t probe = 0);
+
+// Access point model. Credentials are considered saved unless forgotten.
+void setAccessPoint(bool available, int rssi = -60);
+bool accessPointAvailable();
+int accessPointRssi();
+bool credentialsSaved();
+void forgetCredentials();
+// The access point's BSSID and channel; moving it stales cached ones.
+const uint8_t* accessPointBssid();
+int32_t accessPointChannel();
+void moveAccessPoint(const uint8_t* bssid, int32_t channel);
+// A connection takes WIFI_CONNECT_MS, less the scan when the BSSID and
+// channel are given and less DHCP with a static IP.
+static const unsigned long WIFI_CONNECT_MS = 1500;
+static const unsigned long WIFI_SCAN_MS = 1000;
+static const unsigned long WIFI_DHCP_MS = 300;
+
+// Button model. The pin reads low while pressed.
+// Every pin reads as the button; a change fires every attached interrupt.
+void setButton(bool pressed);
+bool buttonPressed();
+void fireInterrupts();
+
+// Serial output goes to `out`, or is counted and dropped if null.
+void setSerialOutput(FILE* out);
+FILE* serialOutput();
+
+// Bus, network and heap accounting. recordI2c returns the bus time taken.
+void recordSpi(size_t bytes, unsigned long clockHz = SPI_CLOCK_HZ);
+unsigned long recordI2c(size_t bytes, unsigned long clockHz = I2C_CLOCK_HZ);
+BusStats& spi();
+BusStats& i2c();
+NetworkStats& network();
+HeapStats heap();
+void resetStats();
+
+}
+
+}
@@ -0,0 +1,57 @@
+#include <PitBoss/HeapMonitor.h>
+
+namespace PitBoss {
+
+namespace {
+
+std::atomic<bool> armed(false);
+thread_local uint32_t taskAllocations = 0;
+
+}
+
+void HeapMonitor::arm() {
+  armed = HeapMonitor::TRACKING;
+}
+
+void HeapMonitor::recordAllocation() {
+  if (armed.load(std::memory_order_relaxed)) {
+    taskAllocations++;
+  }
+}
+
+uint32_t HeapMonitor::getTaskAllocations() {
+  return taskAllocations;
+}
+
+}
+
+#if PITBOSS_HEAP_TRACKING && !PITBOSS_NATIVE
+
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (the heaptrack
+// environment), so the SDK's allocations are counted along with ours.
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  PitBoss::HeapMonitor::recordAllocation();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  PitBoss::HeapMonitor::recordAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  if (size) {
+    PitBoss::HeapMonitor::recordAllocation();
+  }
+  return __real_realloc(ptr, size);
+}
+
+}
+
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <PitBoss/Logger.h>
+
+namespace PitBoss {
+
+struct HeapSiteStats {
+  const char* name;
+  uint32_t calls;
+  uint32_t allocations;
+  // Allocations made once the device had settled.
+  uint32_t steadyStateAllocations;
+};
+
+/**
+ * Counts heap allocations per call site: each Process::process() the app
+ * runs and each HTTP handler. Allocation after boot fragments the heap, which
+ * is what ends week-long uptimes, so once settled any allocation from a
+ * process is logged the first time it happens.
+ *
+ * Counting needs PITBOSS_HEAP_TRACKING: the allocator hooks (malloc and
+ * friends wrapped at link time on the device, the simulation's allocator in
+ * the native build) count what each task allocates, and a Scope attributes
+ * the difference to its site. Without it every count reads zero and scopes
+ * compile to nothing.
+ */
+class HeapMonitor : public Logger {
+ public:
+#if PITBOSS_HEAP_TRACKING
+  static const bool TRACKING = true;
+#else
+  static const bool TRACKING = false;
+#endif
+  static const size_t MAX_SITES = 24;
+
+  class Scope {
+   protected:
+    HeapMonitor* _monitor;
+    size_t _site;
+    uint32_t _start;
+
+   public:
+    Scope(HeapMonitor& monitor, size_t site) :
+      _monitor(&monitor),
+      _site(site),
+      _start(HeapMonitor::TRACKING ? HeapMonitor::getTaskAllocations() : 0)
+    {}
+    ~Scope() {
+      if (HeapMonitor::TRACKING) {
+        this->_monitor->record(this->_site, HeapMonitor::getTaskAllocations() - this->_start);
+      }
+    }
+  };
+
+ protected:
+  struct Site {
+    const char* name;
+    // Processes are expected not to allocate once settled; HTTP handlers
+    // always do, for the response the server sends.
+    bool flagged;
+    std::atomic<uint32_t> calls;
+    std::atomic<uint32_t> allocations;
+    std::atomic<uint32_t> steadyStateAllocations;
+  };
+
+  Site _sites[MAX_SITES];
+  std::atomic<size_t> _siteCount{0};
+  unsigned long _settleAt = 0;
+  std::atomic<bool> _settling{false};
+  std::atomic<bool> _settled{false};
+
+ public:
+  explicit HeapMonitor(AsyncLog* log) :
+    Logger(log)
+  {}
+
+  // Starts counting; before the scheduler runs, task-local counts are not safe.
+  static void arm();
+  // Called by the allocator hooks for every allocation.
+  static void recordAllocation();
+  // Allocations made so far by the calling task.
+  static uint32_t getTaskAllocations();
+
+  // Registers a site during setup, returning its index for Scope.
+  size_t addSite(const char* name, bool flagged) {
+    size_t index = this->_siteCount;
+    if (index >= HeapMonitor::MAX_SITES) {
+      this->_log->error(F("Too many heap monitor sites, not tracking %s."), name);
+      return HeapMonitor::MAX_SITES;
+    }
+    auto& site = this->_sites[index];
+    site.name = name;
+    site.flagged = flagged;
+    site.calls = 0;
+    site.allocations = 0;
+    site.steadyStateAllocations = 0;
+    this->_siteCount = index + 1;
+    return index;
+  }
+
+  // The device counts as settled delayMs from the first call. One task only.
+  void settleAfter(unsigned long delayMs) {
+    if (this->_settling) {
+      return;
+    }
+    this->_settleAt = millis() + delayMs;
+    this->_settling = true;
+  }
+
+  bool isSettled() const {
+    return this->_settled;
+  }
+
+  size_t getSiteStats(HeapSiteStats* stats, size_t size) const {
+    size_t n = std::min<size_t>(size, this->_siteCount);
+    for (size_t i = 0; i < n; i++) {
+      auto& site = this->_sites[i];
+      stats[i].name = site.name;
+      stats[i].calls = site.calls;
+      stats[i].allocations = site.allocations;
+      stats[i].steadyStateAllocations = site.steadyStateAllocations;
+    }
+    return n;
+  }
+
+ protected:
+  void record(size_t index, uint32_t allocations) {
+    if (index >= this->_siteCount) {
+      return;
+    }
+    auto& site = this->_sites[index];
+    site.calls++;
+    if (!allocations) {
+      return;
+    }
+    site.allocations += allocations;
+    if (!this->updateSettled()) {
+      return;
+    }
+    if (site.steadyStateAllocations.fetch_add(allocations) == 0 && site.flagged) {
+      this->_log->warning(F("Steady-state heap allocation in %s: %u allocations in one call."), site.name, allocations);
+    }
+  }
+
+  bool updateSettled() {
+    if (!this->_settled && this->_settling && (long) (millis() - this->_settleAt) >= 0) {
+      this->_settled = true;
+    }
+    return this->_settled;
+  }
+};
+
+}
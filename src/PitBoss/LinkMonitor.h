@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <PitBoss/Snapshot.h>
+
+namespace PitBoss {
+
+namespace LinkLevels {
+
+enum Level : uint8_t {
+  DOWN,
+  POOR,
+  FAIR,
+  GOOD,
+  EXCELLENT,
+};
+static const size_t COUNT = EXCELLENT + 1;
+static const char* const NAMES[COUNT] = {"down", "poor", "fair", "good", "excellent"};
+// Lowest smoothed RSSI of each level, in dBm; RSSI never makes a link DOWN.
+static const int MIN_RSSI_DBM[COUNT] = {0, -128, -75, -67, -55};
+
+}
+
+// What the link did, published when it changes enough to show.
+struct LinkEvent {
+  LinkLevels::Level level;
+  // Smoothed, in dBm; 0 while down.
+  int8_t rssi;
+  // 0 to 100, as WiFiManager rates RSSI.
+  uint8_t quality;
+  bool degraded;
+};
+
+struct LinkStats {
+  static const size_t HISTORY_SIZE = 30;
+
+  LinkEvent link;
+  // Raw samples since connecting, in dBm.
+  int8_t minRssi;
+  int8_t maxRssi;
+  int8_t averageRssi;
+  uint32_t samples;
+  // Smoothed RSSI of the last HISTORY_SIZE samples, oldest first.
+  int8_t history[HISTORY_SIZE];
+  uint8_t historyLength;
+};
+
+/**
+ * Smooths the RSSI of the current connection, sampled every
+ * SAMPLE_INTERVAL_MS by StatefulWiFi rather than asked of the driver on every
+ * pass. Levels change with HYSTERESIS_DB to spare, so a link on a boundary
+ * does not flap. The link counts as degraded once the smoothed RSSI has sat
+ * below DEGRADED_RSSI_DBM for DEGRADED_SAMPLES in a row: well before the
+ * driver gives up on missed beacons, so a reconnect can find a better access
+ * point while the old one still answers.
+ *
+ * Written by one task; getStats() is safe from any.
+ */
+class LinkMonitor {
+ public:
+  static const unsigned long SAMPLE_INTERVAL_MS = 2000;
+  static const int DEGRADED_RSSI_DBM = -80;
+  static const uint32_t DEGRADED_SAMPLES = 5;
+  static const int HYSTERESIS_DB = 2;
+  // Quality change worth an event, in points.
+  static const int QUALITY_STEP = 5;
+
+ protected:
+  // Weight of a new sample, as a right shift: 1/4.
+  static const int SMOOTHING_SHIFT = 2;
+  // Fractional bits of _smoothed.
+  static const int SMOOTHED_SHIFT = 4;
+
+  LinkStats _stats = {};
+  Snapshot<LinkStats> _snapshot;
+  int32_t _smoothed = 0;
+  int32_t _sum = 0;
+  uint32_t _weakSamples = 0;
+  size_t _historyNext = 0;
+  LinkEvent _published = {};
+
+ public:
+  LinkMonitor() {
+    this->reset();
+  }
+
+  // The link went down. True if that is news.
+  bool reset() {
+    this->_stats = {};
+    this->_smoothed = 0;
+    this->_sum = 0;
+    this->_weakSamples = 0;
+    this->_historyNext = 0;
+    this->_snapshot.publish(this->_stats);
+    return this->changed();
+  }
+
+  // True if the link changed enough for an event.
+  bool sample(int rssi) {
+    auto& stats = this->_stats;
+    if (stats.samples == 0) {
+      this->_smoothed = rssi * (1 << LinkMonitor::SMOOTHED_SHIFT);
+      stats.minRssi = rssi;
+      stats.maxRssi = rssi;
+    } else {
+      this->_smoothed += (rssi * (1 << LinkMonitor::SMOOTHED_SHIFT) - this->_smoothed) >> LinkMonitor::SMOOTHING_SHIFT;
+      stats.minRssi = std::min<int>(stats.minRssi, rssi);
+      stats.maxRssi = std::max<int>(stats.maxRssi, rssi);
+    }
+    stats.samples++;
+    this->_sum += rssi;
+    stats.averageRssi = this->_sum / (int32_t) stats.samples;
+    int smoothed = this->_smoothed / (1 << LinkMonitor::SMOOTHED_SHIFT);
+    stats.link.rssi = smoothed;
+    stats.link.quality = smoothed <= -100 ? 0 : smoothed >= -50 ? 100 : 2 * (smoothed + 100);
+    stats.link.level = this->level(smoothed, stats.samples == 1 ? LinkLevels::Level::DOWN : stats.link.level);
+    this->_weakSamples = smoothed < LinkMonitor::DEGRADED_RSSI_DBM ? this->_weakSamples + 1 : 0;
+    stats.link.degraded = this->_weakSamples >= LinkMonitor::DEGRADED_SAMPLES;
+
+    stats.history[this->_historyNext] = smoothed;
+    this->_historyNext = (this->_historyNext + 1) % LinkStats::HISTORY_SIZE;
+    if (stats.historyLength < LinkStats::HISTORY_SIZE) {
+      stats.historyLength++;
+    }
+    LinkStats published = stats;
+    // Rotated so the snapshot reads oldest first.
+    if (stats.historyLength == LinkStats::HISTORY_SIZE) {
+      for (size_t i = 0; i < LinkStats::HISTORY_SIZE; i++) {
+        published.history[i] = stats.history[(this->_historyNext + i) % LinkStats::HISTORY_SIZE];
+      }
+    }
+    this->_snapshot.publish(published);
+    return this->changed();
+  }
+
+  const LinkEvent& getLink() const {
+    return this->_stats.link;
+  }
+
+  bool degraded() const {
+    return this->_stats.link.degraded;
+  }
+
+  LinkStats getStats() const {
+    LinkStats stats;
+    this->_snapshot.read(stats);
+    return stats;
+  }
+
+ protected:
+  // From previous, moving only past a threshold by HYSTERESIS_DB.
+  static LinkLevels::Level level(int rssi, LinkLevels::Level previous) {
+    auto level = LinkLevels::Level::POOR;
+    while (level < LinkLevels::Level::EXCELLENT && rssi >= LinkLevels::MIN_RSSI_DBM[level + 1]) {
+      level = (LinkLevels::Level) (level + 1);
+    }
+    if (previous == LinkLevels::Level::DOWN || level == previous) {
+      return level;
+    }
+    if (level > previous) {
+      return rssi >= LinkLevels::MIN_RSSI_DBM[level] + LinkMonitor::HYSTERESIS_DB ? level : previous;
+    }
+    return rssi < LinkLevels::MIN_RSSI_DBM[previous] - LinkMonitor::HYSTERESIS_DB ? level : previous;
+  }
+
+  bool changed() {
+    const auto& link = this->_stats.link;
+    if (link.level == this->_published.level && link.degraded == this->_published.degraded
+        && std::abs(link.quality - this->_published.quality) < LinkMonitor::QUALITY_STEP) {
+      return false;
+    }
+    this->_published = link;
+    return true;
+  }
+
+};
+
+}
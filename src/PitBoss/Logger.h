@@ -2,15 +2,17 @@
 
 #include <Print.h>
 #include <ArduinoLog.h>
+#include <PitBoss/AsyncLog.h>
+
 namespace PitBoss {
 
 class Logger {
  private:
   static bool _loggingStarted;
  protected:
-  Logging* _log;
+  AsyncLog* _log;
  public:
-  Logger(Logging* log) :
+  Logger(AsyncLog* log) :
     _log(log)
   {}
 };
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <PitBoss/Process.h>
+#include <PitBoss/Snapshot.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+namespace PitBoss {
+
+struct DutyCycleStats {
+  uint32_t wakeups;
+  // Woken by wake() before the deadline came.
+  uint32_t eventWakeups;
+  uint64_t awakeUs;
+  uint64_t asleepUs;
+};
+
+/**
+ * Idles the loop task between deadlines. The loop blocks on a semaphore until
+ * its earliest deadline, or until an interrupt or another task calls wake(),
+ * so the CPU is free and, with power management enabled in the SDK, the idle
+ * task drops into light sleep (tickless idle) for the whole gap.
+ */
+class LoopScheduler {
+ public:
+  // Upper bound on any sleep, in case a wakeup is ever lost.
+  static const unsigned long MAX_SLEEP_MS = 10 * 1000;
+  // Lowest the clock drops to between deadlines (the XTAL frequency).
+  static const int MIN_CPU_FREQUENCY_MHZ = 40;
+
+ protected:
+  SemaphoreHandle_t _wake = nullptr;
+  int64_t _awakeSince = 0;
+  DutyCycleStats _stats = {};
+  // _stats as of the last wakeup, for other tasks.
+  Snapshot<DutyCycleStats> _published;
+
+ public:
+  void begin() {
+    this->_wake = xSemaphoreCreateBinary();
+    this->_awakeSince = esp_timer_get_time();
+#if CONFIG_PM_ENABLE
+    esp_pm_config_esp32_t pm = {};
+    pm.max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    pm.min_freq_mhz = LoopScheduler::MIN_CPU_FREQUENCY_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    pm.light_sleep_enable = true;
+#endif
+    esp_pm_configure(&pm);
+#endif
+  }
+
+  // Safe from any task.
+  void wake() {
+    xSemaphoreGive(this->_wake);
+  }
+
+  void IRAM_ATTR wakeFromISR() {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(this->_wake, &woken);
+    if (woken) {
+      portYIELD_FROM_ISR();
+    }
+  }
+
+  void sleepUntil(unsigned long deadline) {
+    auto start = esp_timer_get_time();
+    this->_stats.awakeUs += start - this->_awakeSince;
+    auto sleepMs = LoopScheduler::remaining(deadline, millis());
+    bool woken = xSemaphoreTake(this->_wake, pdMS_TO_TICKS(sleepMs)) == pdTRUE;
+    this->_awakeSince = esp_timer_get_time();
+    this->_stats.asleepUs += this->_awakeSince - start;
+    this->_stats.wakeups++;
+    if (woken && sleepMs) {
+      this->_stats.eventWakeups++;
+    }
+    this->_published.publish(this->_stats);
+  }
+
+  // From any task, as of the last wakeup.
+  DutyCycleStats getStats() const {
+    DutyCycleStats stats = {};
+    bool torn;
+    while (!this->_published.tryRead(stats, torn) && torn) {
+      // Preempted the owner mid-publish; let it finish.
+      vTaskDelay(1);
+    }
+    return stats;
+  }
+
+  // Milliseconds from now until deadline, capped at MAX_SLEEP_MS.
+  static unsigned long remaining(unsigned long deadline, unsigned long now) {
+    if (deadline == Process::IDLE) {
+      return LoopScheduler::MAX_SLEEP_MS;
+    }
+    auto delta = (long) (deadline - now);
+    return delta <= 0 ? 0 : std::min((unsigned long) delta, LoopScheduler::MAX_SLEEP_MS);
+  }
+
+  static unsigned long earliest(unsigned long a, unsigned long b, unsigned long now) {
+    if (a == Process::IDLE) {
+      return b;
+    }
+    if (b == Process::IDLE) {
+      return a;
+    }
+    return (long) (a - now) <= (long) (b - now) ? a : b;
+  }
+};
+
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/spi_master.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <PitBoss/Temperature.h>
+
+namespace PitBoss {
+
+namespace MAX31855Faults {
+
+enum Fault {
+  NONE = 0x0,
+  OPEN_CIRCUIT = 0x1,
+  SHORT_TO_GND = 0x2,
+  SHORT_TO_VCC = 0x4,
+  NO_RESPONSE = 0x8,
+};
+
+}
+
+/**
+ * One 32-bit MAX31855 conversion. Both junctions and the fault bits come from
+ * the same frame, so they always describe the same conversion.
+ *
+ * D31..D18  hot junction, 14 bit signed, 0.25 C/LSB
+ * D17       reserved, always 0
+ * D16       fault (any of D2..D0)
+ * D15..D4   cold junction, 12 bit signed, 0.0625 C/LSB
+ * D3        reserved, always 0
+ * D2..D0    short to VCC, short to GND, open circuit
+ */
+struct MAX31855Frame {
+  uint32_t raw = 0;
+
+  uint8_t faults() const {
+    // A missing or unpowered chip reads as all zeros or all ones; either way
+    // the reserved bits or an empty frame give it away.
+    if (this->raw == 0 || (this->raw & ((1UL << 17) | (1UL << 3)))) {
+      return MAX31855Faults::Fault::NO_RESPONSE;
+    }
+    if (!(this->raw & (1UL << 16))) {
+      return MAX31855Faults::Fault::NONE;
+    }
+    return this->raw & 0x7;
+  }
+  int16_t hotJunctionRaw() const {
+    return (int16_t) ((int32_t) this->raw >> 18);
+  }
+  int16_t coldJunctionRaw() const {
+    return (int16_t) (this->raw & 0xFFF0) >> 4;
+  }
+  // Meaningless if faults() is set.
+  Celsius hotJunction() const {
+    return MAX31855Frame::hotJunctionFromRaw(this->hotJunctionRaw());
+  }
+  // Meaningless if faults() has NO_RESPONSE.
+  Celsius coldJunction() const {
+    return MAX31855Frame::coldJunctionFromRaw(this->coldJunctionRaw());
+  }
+
+  // For readings stored raw, as the history and the log keep them.
+  static constexpr Celsius hotJunctionFromRaw(int16_t raw) {
+    return Celsius::fromScaled(raw * (Celsius::SCALE / 4));
+  }
+  static constexpr Celsius coldJunctionFromRaw(int16_t raw) {
+    return Celsius::fromScaled(raw * (Celsius::SCALE / 16));
+  }
+
+  static const char* describe(uint8_t faults) {
+    if (faults & MAX31855Faults::Fault::NO_RESPONSE) {
+      return "no response from MAX31855";
+    }
+    if (faults & MAX31855Faults::Fault::OPEN_CIRCUIT) {
+      return "thermocouple open circuit";
+    }
+    if (faults & MAX31855Faults::Fault::SHORT_TO_GND) {
+      return "thermocouple shorted to GND";
+    }
+    if (faults & MAX31855Faults::Fault::SHORT_TO_VCC) {
+      return "thermocouple shorted to VCC";
+    }
+    return "none";
+  }
+};
+
+/**
+ * MAX31855s sharing one of the ESP32's hardware SPI controllers, one chip
+ * select each. The bus is set up with a DMA channel, and a sweep queues a
+ * 32-bit transaction for every device before collecting any, so the driver
+ * clocks the frames out back to back from its interrupt instead of the
+ * caller turning the bus around between them. Sweeps may come from any task.
+ */
+class MAX31855Bus {
+ public:
+  static const size_t MAX_DEVICES = 4;
+  static const int CLOCK_HZ = 5 * 1000 * 1000;
+  // Longest a conversion takes; reading faster returns the same one again.
+  static const unsigned long CONVERSION_MS = 100;
+  static const int DEFAULT_CLK_PIN = GPIO_NUM_18;
+  static const int DEFAULT_MISO_PIN = GPIO_NUM_19;
+
+ protected:
+  spi_host_device_t _host;
+  int _clkPin;
+  int _misoPin;
+  size_t _count = 0;
+  spi_device_handle_t _devices[MAX_DEVICES] = {};
+  spi_transaction_t _transactions[MAX_DEVICES];
+  SemaphoreHandle_t _lock = nullptr;
+  WORD_ALIGNED_ATTR uint8_t _rx[MAX_DEVICES][4] = {};
+
+ public:
+  MAX31855Bus(int clkPin = DEFAULT_CLK_PIN, int misoPin = DEFAULT_MISO_PIN, spi_host_device_t host = VSPI_HOST) :
+    _host(host),
+    _clkPin(clkPin),
+    _misoPin(misoPin)
+  {}
+
+  // Up to MAX_DEVICES chip selects; false if any device could not be added.
+  bool begin(const int* csPins, size_t count) {
+    this->_lock = xSemaphoreCreateMutex();
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num = -1;
+    bus.miso_io_num = this->_misoPin;
+    bus.sclk_io_num = this->_clkPin;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    bus.max_transfer_sz = sizeof(this->_rx[0]);
+    auto err = spi_bus_initialize(this->_host, &bus, SPI_DMA_CH_AUTO);
+    // Already initialized by another device on the same bus is fine.
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+      return false;
+    }
+    bool ok = true;
+    this->_count = std::min(count, MAX31855Bus::MAX_DEVICES);
+    for (size_t i = 0; i < this->_count; i++) {
+      spi_device_interface_config_t device = {};
+      device.mode = 0;
+      device.clock_speed_hz = MAX31855Bus::CLOCK_HZ;
+      device.spics_io_num = csPins[i];
+      device.queue_size = 1;
+      if (spi_bus_add_device(this->_host, &device, &this->_devices[i]) != ESP_OK) {
+        this->_devices[i] = nullptr;
+        ok = false;
+      }
+    }
+    return ok;
+  }
+
+  size_t size() const {
+    return this->_count;
+  }
+
+  /**
+   * Reads a frame from every device into frames[0..size()). A device that
+   * could not be read gets an empty frame, which decodes as NO_RESPONSE.
+   * False if any could not.
+   */
+  bool readFrames(MAX31855Frame* frames) {
+    bool queued[MAX_DEVICES] = {};
+    bool ok = true;
+    xSemaphoreTake(this->_lock, portMAX_DELAY);
+    for (size_t i = 0; i < this->_count; i++) {
+      frames[i].raw = 0;
+      if (!this->_devices[i]) {
+        ok = false;
+        continue;
+      }
+      auto& transaction = this->_transactions[i];
+      transaction = {};
+      transaction.length = 32;
+      transaction.rxlength = 32;
+      transaction.rx_buffer = this->_rx[i];
+      queued[i] = spi_device_queue_trans(this->_devices[i], &transaction, portMAX_DELAY) == ESP_OK;
+      ok &= queued[i];
+    }
+    for (size_t i = 0; i < this->_count; i++) {
+      if (!queued[i]) {
+        continue;
+      }
+      spi_transaction_t* done;
+      if (spi_device_get_trans_result(this->_devices[i], &done, portMAX_DELAY) != ESP_OK) {
+        ok = false;
+        continue;
+      }
+      const uint8_t* rx = this->_rx[i];
+      frames[i].raw = ((uint32_t) rx[0] << 24) | ((uint32_t) rx[1] << 16) | ((uint32_t) rx[2] << 8) | rx[3];
+    }
+    xSemaphoreGive(this->_lock);
+    return ok;
+  }
+};
+
+}
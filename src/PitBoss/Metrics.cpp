@@ -0,0 +1,64 @@
+#include <PitBoss/Metrics.h>
+#include <algorithm>
+
+namespace PitBoss {
+
+namespace {
+
+// Microseconds as decimal seconds, which is what Prometheus wants.
+void printSeconds(Print* out, uint64_t us) {
+  out->printf("%lu.%06lu", (unsigned long) (us / 1000000), (unsigned long) (us % 1000000));
+}
+
+}
+
+void MetricsWriter::describe(const char* name, const char* type, const char* help) {
+  this->_out->printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void MetricsWriter::value(const char* name, const char* labels, uint64_t value) {
+  if (labels) {
+    this->_out->printf("%s{%s} %llu\n", name, labels, (unsigned long long) value);
+  } else {
+    this->_out->printf("%s %llu\n", name, (unsigned long long) value);
+  }
+}
+
+void MetricsWriter::signedValue(const char* name, const char* labels, int64_t value) {
+  if (labels) {
+    this->_out->printf("%s{%s} %lld\n", name, labels, (long long) value);
+  } else {
+    this->_out->printf("%s %lld\n", name, (long long) value);
+  }
+}
+
+void MetricsWriter::histogram(const char* name, const char* labels, const Histogram& histogram) {
+  const char* separator = labels ? "," : "";
+  labels = labels ? labels : "";
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < Histogram::BUCKETS; i++) {
+    cumulative += histogram.getBucket(i);
+    this->_out->printf("%s_bucket{%s%sle=\"", name, labels, separator);
+    printSeconds(this->_out, Histogram::upperBoundMicros(i));
+    this->_out->printf("\"} %llu\n", (unsigned long long) cumulative);
+  }
+  // Read last, so +Inf is never below the finite buckets.
+  uint64_t count = histogram.getCount();
+  cumulative += histogram.getBucket(Histogram::BUCKETS);
+  this->_out->printf("%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, separator,
+                     (unsigned long long) std::max<uint64_t>(cumulative, count));
+  count = std::max<uint64_t>(cumulative, count);
+  if (labels[0]) {
+    this->_out->printf("%s_sum{%s} ", name, labels);
+  } else {
+    this->_out->printf("%s_sum ", name);
+  }
+  printSeconds(this->_out, histogram.getSumMicros());
+  if (labels[0]) {
+    this->_out->printf("\n%s_count{%s} %llu\n", name, labels, (unsigned long long) count);
+  } else {
+    this->_out->printf("\n%s_count %llu\n", name, (unsigned long long) count);
+  }
+}
+
+}
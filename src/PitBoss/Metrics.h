@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Print.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <esp_timer.h>
+
+namespace PitBoss {
+
+/**
+ * Durations in fixed buckets with power-of-two bounds, 16 us to about a
+ * second, then +Inf. Observing is a count-leading-zeros and three relaxed
+ * atomic adds, so it can sit on any hot path and any task; each bucket is
+ * exact at the time it is read, though a scrape may land between them.
+ */
+class Histogram {
+ public:
+  static const int MIN_SHIFT = 4;
+  static const size_t BUCKETS = 17;
+
+  // Observes the time from construction to destruction.
+  class Timer {
+   protected:
+    Histogram* _histogram;
+    int64_t _start;
+
+   public:
+    explicit Timer(Histogram& histogram) :
+      _histogram(&histogram),
+      _start(esp_timer_get_time())
+    {}
+    ~Timer() {
+      this->_histogram->observe((uint32_t) (esp_timer_get_time() - this->_start));
+    }
+  };
+
+ protected:
+  // The last is +Inf.
+  std::atomic<uint32_t> _buckets[BUCKETS + 1] = {};
+  std::atomic<uint32_t> _count{0};
+  std::atomic<uint64_t> _sumUs{0};
+
+ public:
+  void observe(uint32_t us) {
+    this->_buckets[Histogram::bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    this->_sumUs.fetch_add(us, std::memory_order_relaxed);
+    this->_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint32_t getBucket(size_t bucket) const {
+    return this->_buckets[bucket].load(std::memory_order_relaxed);
+  }
+  uint32_t getCount() const {
+    return this->_count.load(std::memory_order_relaxed);
+  }
+  uint64_t getSumMicros() const {
+    return this->_sumUs.load(std::memory_order_relaxed);
+  }
+
+  static size_t bucketFor(uint32_t us) {
+    if (us <= (1UL << Histogram::MIN_SHIFT)) {
+      return 0;
+    }
+    size_t bucket = 32 - __builtin_clz(us - 1) - Histogram::MIN_SHIFT;
+    return bucket < Histogram::BUCKETS ? bucket : Histogram::BUCKETS;
+  }
+  static uint32_t upperBoundMicros(size_t bucket) {
+    return 1UL << (Histogram::MIN_SHIFT + bucket);
+  }
+};
+
+/**
+ * Prometheus text exposition format (version 0.0.4) onto any Print. Labels
+ * are passed preformatted, e.g. `route="/temperature",method="GET"`, or
+ * nullptr for none.
+ */
+class MetricsWriter {
+ protected:
+  Print* _out;
+
+ public:
+  explicit MetricsWriter(Print& out) :
+    _out(&out)
+  {}
+
+  // Once per metric name, before its samples.
+  void describe(const char* name, const char* type, const char* help);
+  void value(const char* name, const char* labels, uint64_t value);
+  // For gauges that go below zero, such as RSSI.
+  void signedValue(const char* name, const char* labels, int64_t value);
+  // Buckets cumulative and in seconds, as Prometheus expects.
+  void histogram(const char* name, const char* labels, const Histogram& histogram);
+};
+
+}
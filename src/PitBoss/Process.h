@@ -1,11 +1,22 @@
 #pragma once
 
+#include <Arduino.h>
+#include <climits>
+
 namespace PitBoss {
 
 class Process {
  public:
+  // No deadline: only an event that wakes the loop can create work.
+  static const unsigned long IDLE = ULONG_MAX;
+
   virtual void setup() = 0;
   virtual void process() = 0;
+  // millis() by which process() next has work, or IDLE. Processes that
+  // don't say are polled on every pass.
+  virtual unsigned long getNextDeadline() {
+    return millis();
+  }
 };
 
 }
@@ -0,0 +1,254 @@
+#include <PitBoss/SleepLog.h>
+#include <PitBoss/AsyncLog.h>
+#include <PitBoss/MAX31855.h>
+#include <PitBoss/Snapshot.h>
+#include <PitBoss/StatefulWiFi.h>
+#include <PitBoss/Telemetry.h>
+#include <AsyncUDP.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <cmath>
+#include <cstring>
+
+namespace PitBoss {
+
+namespace {
+
+// One sweep, as the MAX31855s returned it.
+struct LoggedReading {
+  uint32_t sequence;
+  // On the timeline of the boot that entered sleep log mode.
+  uint32_t timestampMs;
+  uint32_t frames[MAX31855Bus::MAX_DEVICES];
+};
+
+// About 3 KB of the 8 KB of RTC slow memory.
+struct SleepLogState {
+  static const uint32_t MAGIC = 0x474C5350;
+
+  uint32_t magic;
+  // Set by enter(); a wake other than the timer's clears it.
+  bool active;
+  bool alarmed;
+  uint8_t probes;
+  uint8_t buttonPin;
+  uint32_t intervalMs;
+  uint16_t batch;
+  uint16_t port;
+  // Raw hot junction, 0.25 C/LSB; 0 for none.
+  int16_t alarmLow;
+  int16_t alarmHigh;
+  uint32_t deviceId;
+  int csPins[MAX31855Bus::MAX_DEVICES];
+  wifi_country_t wifiCountry;
+  uint32_t sequence;
+  // When the next wake begins, on the readings' timeline.
+  int64_t nextWakeUs;
+  uint32_t sinceUplink;
+  uint32_t head;
+  uint32_t count;
+  SleepLogStats stats;
+  LoggedReading readings[SleepLog::CAPACITY];
+};
+
+RTC_DATA_ATTR SleepLogState rtcState;
+
+// Set up once per boot, or once per run in the simulation.
+MAX31855Bus bus;
+bool busBegun = false;
+AsyncUDP udp;
+Telemetry telemetry(&udp);
+Snapshot<SleepLogStats> stats;
+
+}
+
+void SleepLog::wake() {
+  auto& state = rtcState;
+  if (state.magic != SleepLogState::MAGIC) {
+    memset(&state, 0, sizeof(state));
+    state.magic = SleepLogState::MAGIC;
+  }
+  if (!state.active || esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER) {
+    state.active = false;
+    SleepLog::publish();
+    return;
+  }
+  auto sleepUs = SleepLog::cycle(0);
+  esp_sleep_enable_timer_wakeup(sleepUs);
+  esp_sleep_enable_ext0_wakeup((gpio_num_t) state.buttonPin, 0);
+  esp_deep_sleep_start();
+}
+
+bool SleepLog::enter(const Config& config, const int* csPins, size_t probes, gpio_num_t buttonPin, uint32_t sequence) {
+  auto& state = rtcState;
+  if (config.sleepLogInterval <= 0) {
+    state.active = false;
+    return false;
+  }
+  probes = std::min(probes, MAX31855Bus::MAX_DEVICES);
+  if (state.probes != probes || memcmp(state.csPins, csPins, probes * sizeof(int)) != 0) {
+    // Readings of other probes, never uploaded.
+    state.stats.dropped += state.count;
+    state.head = 0;
+    state.count = 0;
+  }
+  state.active = true;
+  state.alarmed = false;
+  state.probes = probes;
+  state.buttonPin = buttonPin;
+  state.intervalMs = config.sleepLogInterval;
+  state.batch = config.sleepLogBatch;
+  state.port = config.telemetryPort;
+  state.alarmLow = (int16_t) lroundf(config.sleepLogAlarmLow * 4);
+  state.alarmHigh = (int16_t) lroundf(config.sleepLogAlarmHigh * 4);
+  state.deviceId = (uint32_t) (ESP.getEfuseMac() >> 16);
+  memcpy(state.csPins, csPins, probes * sizeof(int));
+  state.wifiCountry = config.wifiCountry;
+  state.sequence = sequence;
+  uint64_t sleepUs = (uint64_t) state.intervalMs * 1000;
+  state.nextWakeUs = esp_timer_get_time() + sleepUs;
+  state.sinceUplink = 0;
+  state.stats.asleepUs += sleepUs;
+  SleepLog::publish();
+  esp_sleep_enable_timer_wakeup(sleepUs);
+  return true;
+}
+
+uint64_t SleepLog::cycle(int64_t wokeAtUs) {
+  auto& state = rtcState;
+  if (!busBegun) {
+    busBegun = true;
+    bus.begin(state.csPins, state.probes);
+  }
+  MAX31855Frame frames[MAX31855Bus::MAX_DEVICES];
+  bus.readFrames(frames);
+  if (state.count == SleepLog::CAPACITY) {
+    state.head = (state.head + 1) % SleepLog::CAPACITY;
+    state.count--;
+    state.stats.dropped++;
+  }
+  auto& reading = state.readings[(state.head + state.count++) % SleepLog::CAPACITY];
+  reading.sequence = state.sequence++;
+  reading.timestampMs = (uint32_t) ((state.nextWakeUs + esp_timer_get_time() - wokeAtUs) / 1000);
+  for (size_t i = 0; i < MAX31855Bus::MAX_DEVICES; i++) {
+    reading.frames[i] = i < state.probes ? frames[i].raw : 0;
+  }
+  state.stats.wakes++;
+  state.sinceUplink++;
+
+  // Against the raw reading: calibration lives in SPIFFS, which a wake has
+  // no time to mount.
+  bool alarmed = state.alarmed;
+  if (!frames[0].faults()) {
+    auto hotJunction = frames[0].hotJunctionRaw();
+    alarmed = (state.alarmLow && hotJunction < state.alarmLow) || (state.alarmHigh && hotJunction > state.alarmHigh);
+  }
+  bool uplink = state.port && (alarmed != state.alarmed || state.sinceUplink >= state.batch);
+  if (alarmed && !state.alarmed) {
+    state.stats.alarms++;
+  }
+  state.alarmed = alarmed;
+
+  if (uplink) {
+    // A failed upload waits for another batch rather than retrying every wake.
+    state.sinceUplink = 0;
+    if (!SleepLog::connect() || !SleepLog::upload()) {
+      state.stats.failedUplinks++;
+    }
+    delay(SleepLog::UPLINK_SETTLE_MS);
+    // And the radio off.
+    WiFi.disconnect(true);
+  }
+
+  int64_t awakeUs = esp_timer_get_time() - wokeAtUs;
+  int64_t intervalUs = (int64_t) state.intervalMs * 1000;
+  uint64_t sleepUs = awakeUs + (int64_t) SleepLog::MIN_SLEEP_US < intervalUs ? intervalUs - awakeUs : SleepLog::MIN_SLEEP_US;
+  if (uplink) {
+    state.stats.uplinkWakes++;
+    state.stats.uplinkAwakeUs += awakeUs;
+  } else {
+    state.stats.readingAwakeUs += awakeUs;
+    state.stats.maxReadingAwakeUs = std::max(state.stats.maxReadingAwakeUs, (uint32_t) awakeUs);
+  }
+  state.stats.asleepUs += sleepUs;
+  state.nextWakeUs += awakeUs + sleepUs;
+  SleepLog::publish();
+  return sleepUs;
+}
+
+size_t SleepLog::drain() {
+  auto& state = rtcState;
+  if (state.active || !state.count) {
+    return 0;
+  }
+  auto count = state.count;
+  if (!SleepLog::upload()) {
+    state.stats.failedUplinks++;
+    count = 0;
+  }
+  SleepLog::publish();
+  return count;
+}
+
+SleepLogStats SleepLog::getStats() {
+  SleepLogStats published;
+  stats.read(published);
+  // uA * us is pC; in nC, times mV, is pJ.
+  uint64_t awakeNc = ((uint64_t) SleepLog::AWAKE_UA * published.readingAwakeUs
+                      + (uint64_t) SleepLog::RADIO_UA * published.uplinkAwakeUs) / 1000;
+  uint64_t asleepNc = (SleepLog::ASLEEP_UA + (uint64_t) SleepLog::PROBE_UA * rtcState.probes) * published.asleepUs / 1000;
+  published.awakeEnergyUj = awakeNc * SleepLog::SUPPLY_MV / 1000000;
+  published.asleepEnergyUj = asleepNc * SleepLog::SUPPLY_MV / 1000000;
+  return published;
+}
+
+// As StatefulWiFi connects, lease first; a wake never waits on the portal.
+bool SleepLog::connect() {
+  StatefulWiFi wifi(&SystemLog, false, rtcState.wifiCountry, "pitboss-");
+  wifi.setup();
+  if (wifi.getState() != StatefulWiFiStates::State::DISCONNECTED) {
+    return false;
+  }
+  auto start = millis();
+  while (wifi.getState() != StatefulWiFiStates::State::CONNECTED && millis() - start < SleepLog::UPLINK_TIMEOUT_MS) {
+    delay(SleepLog::UPLINK_POLL_MS);
+    wifi.process();
+  }
+  return wifi.getState() == StatefulWiFiStates::State::CONNECTED;
+}
+
+// Sends every reading in the ring, clearing it if all went.
+bool SleepLog::upload() {
+  auto& state = rtcState;
+  telemetry.configure(state.deviceId, state.port, 0, Telemetry::MAX_BATCH, state.probes);
+  telemetry.setEnabled(true);
+  auto failures = telemetry.getStats().sendFailures;
+  ThermocoupleSample sample;
+  sample.probes = state.probes;
+  for (size_t i = 0; i < state.count; i++) {
+    const auto& reading = state.readings[(state.head + i) % SleepLog::CAPACITY];
+    sample.sequence = reading.sequence;
+    sample.timestamp = (int64_t) reading.timestampMs * 1000;
+    for (size_t probe = 0; probe < state.probes; probe++) {
+      sample.frames[probe].raw = reading.frames[probe];
+    }
+    telemetry.append(sample);
+  }
+  telemetry.flush();
+  telemetry.setEnabled(false);
+  if (telemetry.getStats().sendFailures != failures) {
+    return false;
+  }
+  state.head = 0;
+  state.count = 0;
+  state.stats.uplinks++;
+  return true;
+}
+
+void SleepLog::publish() {
+  auto published = rtcState.stats;
+  published.pending = rtcState.count;
+  stats.publish(published);
+}
+
+}
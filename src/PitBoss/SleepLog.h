@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+#include <PitBoss/Config.h>
+
+namespace PitBoss {
+
+struct SleepLogStats {
+  // Timer wakes, one reading each.
+  uint32_t wakes;
+  // Of wakes, those that brought WiFi up to upload.
+  uint32_t uplinkWakes;
+  // Batches uploaded, after a wake or a boot.
+  uint32_t uplinks;
+  uint32_t failedUplinks;
+  // Pit temperature crossing into an alarm threshold.
+  uint32_t alarms;
+  // Readings overwritten before they could be uploaded.
+  uint32_t dropped;
+  // Readings waiting to be uploaded.
+  uint32_t pending;
+  uint32_t maxReadingAwakeUs;
+  // From wake to sleep, split by whether the wake uploaded.
+  uint64_t readingAwakeUs;
+  uint64_t uplinkAwakeUs;
+  uint64_t asleepUs;
+  // Modelled from the times above and SleepLog's currents, in uJ.
+  uint64_t awakeEnergyUj;
+  uint64_t asleepEnergyUj;
+};
+
+/**
+ * Logs readings through deep sleep. Sleeping from the button with
+ * sleepLogInterval set arms the RTC timer instead of just turning off; each
+ * timer wake then runs from setup() before the App exists, takes one sweep of
+ * the probes and appends it to a ring in RTC slow memory, and sleeps again
+ * with WiFi never started. Only once sleepLogBatch readings have built up, or
+ * the pit probe crosses sleepLogAlarmLow or sleepLogAlarmHigh either way,
+ * does a wake connect (directly, with the WiFi lease) and send the ring as
+ * UDP telemetry. A button wake boots as usual, and readings still in the ring
+ * go out once WiFi connects.
+ *
+ * The energy figures are modelled: measured awake and asleep times at the
+ * datasheet currents below. Boot ROM and bootloader time before setup() is
+ * not measured.
+ */
+class SleepLog {
+ public:
+  static const size_t CAPACITY = Config::MAX_SLEEP_LOG_BATCH;
+  static const unsigned long UPLINK_TIMEOUT_MS = 10 * 1000;
+  static const unsigned long UPLINK_POLL_MS = 10;
+  // For the last datagram to leave before the radio goes off.
+  static const unsigned long UPLINK_SETTLE_MS = 20;
+  // Least sleep between wakes, should one overrun the interval.
+  static const uint64_t MIN_SLEEP_US = 100 * 1000;
+  // Supply currents in uA: awake with the radio off, awake with it up, the
+  // RTC timer and slow memory in deep sleep, and each MAX31855, which keeps
+  // converting through it.
+  static const uint32_t AWAKE_UA = 40 * 1000;
+  static const uint32_t RADIO_UA = 120 * 1000;
+  static const uint32_t ASLEEP_UA = 10;
+  static const uint32_t PROBE_UA = 900;
+  static const uint32_t SUPPLY_MV = 3300;
+
+  // First thing in setup(). On a timer wake in sleep log mode, logs a reading
+  // and goes back to sleep without returning.
+  static void wake();
+  // Arms the timer for the coming deep sleep; false if sleepLogInterval turns
+  // logging off. sequence numbers the first reading.
+  static bool enter(const Config& config, const int* csPins, size_t probes, gpio_num_t buttonPin, uint32_t sequence);
+  // One wake's reading and upload, from wokeAtUs on the esp_timer clock (0
+  // on the device). Returns how long to sleep, in us.
+  static uint64_t cycle(int64_t wokeAtUs);
+  // Sends readings logged before this boot; once WiFi is up, from the
+  // sensing task. The number sent.
+  static size_t drain();
+  static SleepLogStats getStats();
+
+ protected:
+  static bool connect();
+  static bool upload();
+  static void publish();
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace PitBoss {
+
+/**
+ * Single-writer seqlock holding the latest value of a small trivially
+ * copyable type. The writer never blocks or waits on readers; a reader copies
+ * the value and retries only if a write landed mid-copy, which at sensor
+ * rates is effectively never. read() spins while a write is in progress, so
+ * readers that can preempt the writer on its own core use tryRead().
+ *
+ * The value is held as atomic words so concurrent copies are well defined.
+ */
+template <typename T>
+class Snapshot {
+  static_assert(std::is_trivially_copyable<T>::value, "Snapshot values are copied bytewise");
+
+ protected:
+  static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  std::atomic<uint32_t> _sequence{0};
+  std::atomic<uint32_t> _words[WORDS] = {};
+
+ public:
+  void publish(const T& value) {
+    uint32_t words[WORDS] = {};
+    memcpy(words, &value, sizeof(T));
+    auto sequence = this->_sequence.load(std::memory_order_relaxed);
+    this->_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) {
+      this->_words[i].store(words[i], std::memory_order_relaxed);
+    }
+    this->_sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Returns false (leaving value untouched) if nothing has been published.
+  bool read(T& value) const {
+    bool torn;
+    while (!this->tryRead(value, torn)) {
+      if (!torn) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Single attempt that never spins, for readers that may preempt the
+  // writer: torn is set if a write was in progress.
+  bool tryRead(T& value, bool& torn) const {
+    uint32_t words[WORDS];
+    auto before = this->_sequence.load(std::memory_order_acquire);
+    for (size_t i = 0; i < WORDS; i++) {
+      words[i] = this->_words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto after = this->_sequence.load(std::memory_order_relaxed);
+    torn = (before & 1) || before != after;
+    if (torn || !before) {
+      return false;
+    }
+    memcpy(&value, words, sizeof(T));
+    return true;
+  }
+
+  uint32_t version() const {
+    return this->_sequence.load(std::memory_order_acquire) / 2;
+  }
+};
+
+}
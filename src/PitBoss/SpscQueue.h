@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace PitBoss {
+
+/**
+ * Bounded single-producer single-consumer queue. Neither side ever blocks or
+ * takes a lock, so the producer may be a high priority task or an ISR; a full
+ * queue refuses the item and the producer decides what to drop.
+ */
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+  static_assert(CAPACITY && (CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+  static_assert(std::is_trivially_copyable<T>::value, "SpscQueue items are copied in and out");
+
+ protected:
+  T _items[CAPACITY];
+  // Next slot to read, written by the consumer only.
+  std::atomic<uint32_t> _head{0};
+  // Next slot to write, written by the producer only.
+  std::atomic<uint32_t> _tail{0};
+
+ public:
+  bool push(const T& item) {
+    auto tail = this->_tail.load(std::memory_order_relaxed);
+    if (tail - this->_head.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    this->_items[tail % CAPACITY] = item;
+    this->_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& item) {
+    auto head = this->_head.load(std::memory_order_relaxed);
+    if (head == this->_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = this->_items[head % CAPACITY];
+    this->_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return this->_head.load(std::memory_order_acquire) == this->_tail.load(std::memory_order_acquire);
+  }
+
+  size_t size() const {
+    return this->_tail.load(std::memory_order_acquire) - this->_head.load(std::memory_order_acquire);
+  }
+};
+
+}
@@ -1,25 +1,51 @@
 #pragma once
 
-#include <functional>
-#include <map>
-#include <vector>
+#include <cassert>
+#include <cstddef>
+#include "Callback.h"
 
 namespace PitBoss {
 
-template<typename T_state>
+/**
+ * State holder with listeners per state and per transition. The listener
+ * tables are fixed arrays sized at compile time, STATE_COUNT being the number
+ * of values of T_state, so registering and notifying never touch the heap.
+ *
+ * setState() notifies even when the state does not change; changeState()
+ * only notifies on an actual transition, for callers that re-assert their
+ * state on every pass.
+ */
+template<typename T_state, size_t STATE_COUNT, size_t MAX_LISTENERS = 4, size_t MAX_TRANSITION_LISTENERS = 4>
 class Stateful {
+ public:
+  typedef Callback<void()> Listener;
+
  protected:
-  T_state _state;
-  T_state _previousState;
-  std::map<T_state, std::vector<std::function<void(void)>>>
-    _stateListeners = std::map<T_state, std::vector<std::function<void()>>>();
+  struct TransitionListener {
+    T_state from;
+    T_state to;
+    Listener listener;
+  };
+
+  T_state _state = T_state();
+  T_state _previousState = T_state();
+  // No state has been set yet, so there is no transition to report.
+  bool _initial = true;
+  Listener _stateListeners[STATE_COUNT][MAX_LISTENERS];
+  uint8_t _stateListenerCounts[STATE_COUNT] = {};
+  TransitionListener _transitionListeners[MAX_TRANSITION_LISTENERS];
+  uint8_t _transitionListenerCount = 0;
+
  public:
-  Stateful &onState(T_state state, const std::function<void(void)> &listener) {
-    if (this->_stateListeners.find(state) == this->_stateListeners.end()) {
-      std::vector<std::function<void(void)>> listeners;
-      this->_stateListeners.insert({state, listeners});
-    }
-    this->_stateListeners.at(state).push_back(listener);
+  Stateful &onState(T_state state, const Listener &listener) {
+    assert((size_t) state < STATE_COUNT && this->_stateListenerCounts[state] < MAX_LISTENERS);
+    this->_stateListeners[state][this->_stateListenerCounts[state]++] = listener;
+    return *this;
+  }
+  // Called after the listeners of `to`, when the state goes from `from` to `to`.
+  Stateful &onTransition(T_state from, T_state to, const Listener &listener) {
+    assert(this->_transitionListenerCount < MAX_TRANSITION_LISTENERS);
+    this->_transitionListeners[this->_transitionListenerCount++] = TransitionListener{from, to, listener};
     return *this;
   }
   T_state getState() {
@@ -30,18 +56,38 @@ class Stateful {
   }
  protected:
   void setState(T_state state) {
-    this->_previousState = this->_state;
+    this->_previousState = this->_initial ? state : this->_state;
     this->_state = state;
     this->notifyStateListeners();
+    this->_initial = false;
+  }
+  // Returns whether the state changed.
+  bool changeState(T_state state) {
+    if (!this->_initial && state == this->_state) {
+      return false;
+    }
+    this->setState(state);
+    return true;
   }
   virtual void notifyStateListeners() {
-    if (this->_stateListeners.find(this->_state) != this->_stateListeners.end()) {
-      auto listeners = this->_stateListeners.at(this->_state);
-      for (auto &listener : listeners) {
-        listener();
+    T_state state = this->_state;
+    T_state previous = this->_previousState;
+    // Listeners registered meanwhile are left for the next change.
+    size_t count = this->_stateListenerCounts[state];
+    for (size_t i = 0; i < count; i++) {
+      this->_stateListeners[state][i]();
+    }
+    if (this->_initial || previous == state) {
+      return;
+    }
+    count = this->_transitionListenerCount;
+    for (size_t i = 0; i < count; i++) {
+      auto &transition = this->_transitionListeners[i];
+      if (transition.from == previous && transition.to == state) {
+        transition.listener();
       }
     }
   }
 };
 
-}
\ No newline at end of file
+}
@@ -3,8 +3,15 @@
 #include <Adafruit_SSD1306.h>
 #include <Fonts/TomThumb.h>
 #include <Fonts/FreeSans18pt7b.h>
+#include <atomic>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <PitBoss/TimeHelper.h>
-#include <PitBoss/TemperatureHelper.h>
+#include <PitBoss/Temperature.h>
+#include <PitBoss/LoopScheduler.h>
+#include <PitBoss/MAX31855.h>
+#include <PitBoss/Metrics.h>
 
 namespace PitBoss {
 
@@ -14,237 +21,705 @@ enum State {
   ON,
   OFF
 };
+static const size_t COUNT = OFF + 1;
 
 }
 
-class StatefulDisplay : public Stateful<StatefulDisplayStates::State>, public Process {
+struct DisplayStats {
+  // Frames that changed something on the panel.
+  uint32_t frames;
+  // Frame deadlines where nothing had changed.
+  uint32_t unchangedFrames;
+  // Frames rendered while a flush was in flight, so merged into a later one
+  // and never shown on their own.
+  uint32_t coalescedFrames;
+  uint32_t widgetRenders;
+  // Composing and rasterizing, over all frame deadlines.
+  uint64_t busyUs;
+  uint32_t maxFrameUs;
+  // Written by the flush task.
+  uint32_t flushes;
+  // Flushes the panel did not acknowledge in full.
+  uint32_t droppedFrames;
+  // I2C bytes sent, commands included.
+  uint32_t bytesSent;
+  uint64_t flushUs;
+};
+
+/**
+ * Retained-mode renderer. Each widget keeps the text it last drew and where
+ * its pixels landed; a frame re-rasterizes only the widgets whose text
+ * changed (and any they overlap), then sends the SSD1306 just the columns of
+ * each page those widgets touched.
+ *
+ * Frames are rendered into the back buffer and handed to a low priority
+ * flush task, which owns the bus: the changed columns are copied to the
+ * front buffer and the task sends them while rendering carries on. A frame
+ * finished while the previous one is still going out stays in the back
+ * buffer and goes out merged with the next.
+ */
+class StatefulDisplay : public Stateful<StatefulDisplayStates::State, StatefulDisplayStates::COUNT>, public Process {
  protected:
   enum WifiScrollDirection {
     LEFT,
     RIGHT
   };
+  // In drawing order.
+  enum Widget {
+    WIFI_STATUS,
+    TEMPERATURE,
+    UNIT,
+    PROBES,
+    CLOCK,
+    WIDGET_COUNT
+  };
+  // Inclusive pixel rectangle, empty when x1 < x0.
+  struct Bounds {
+    int16_t x0;
+    int16_t y0;
+    int16_t x1;
+    int16_t y1;
+  };
+  struct WidgetState {
+    char text[64];
+    Bounds bounds;
+  };
+  struct GlyphMetrics {
+    int8_t xOffset;
+    int8_t yOffset;
+    uint8_t width;
+    uint8_t height;
+    uint8_t xAdvance;
+  };
+
+  static const unsigned long FRAME_INTERVAL = 100;
+  static const uint8_t MAX_PAGES = 8;
+  // Data bytes per I2C transmission, after the 0x40 control byte.
+  static const size_t WIRE_CHUNK = 31;
+  static const uint32_t I2C_IDLE_CLOCK = 100000;
+  static const uint32_t FLUSH_TASK_STACK = 2048;
+  static const UBaseType_t FLUSH_TASK_PRIORITY = 1;
+  static const BaseType_t FLUSH_TASK_CORE = PRO_CPU_NUM;
+  constexpr static const char* TEMPERATURE_GLYPHS = "-0123456789";
+  constexpr static const char* CLOCK_FORMAT = "%F %r";
+
   Adafruit_SSD1306 _display;
+  TwoWire* _wire;
   int _i2cAddress;
   unsigned long _lastFrame;
   unsigned long _screenOnAt;
   unsigned long _screenTimeout;
-  static const unsigned long FRAME_INTERVAL = 100;
 
   StatefulWiFiStates::State _wifiState;
   IPAddress _ipAddress;
-  String _ssid;
+  char _ssid[33];
   int _wifiSignalStrength;
 
   StatefulThermocoupleStates::State _thermocoupleState;
-  double _coldJunction;
-  double _hotJunction;
+  Celsius _coldJunction;
+  Celsius _hotJunction;
+  // Meat probes, from 1; the pit's is _hotJunction.
+  size_t _probeCount = 0;
+  bool _probeReady[MAX31855Bus::MAX_DEVICES] = {};
+  Celsius _probeTemperatures[MAX31855Bus::MAX_DEVICES];
 
   bool _timeReady;
+  time_t _clockTime = 0;
+
+  WidgetState _shown[WIDGET_COUNT];
+  WidgetState _wanted[WIDGET_COUNT];
+  GlyphMetrics _temperatureGlyphs[11];
+  // Columns of each page of the back buffer not yet handed over, empty when
+  // to < from.
+  int16_t _dirtyFrom[MAX_PAGES];
+  int16_t _dirtyTo[MAX_PAGES];
+  // SSD1306_DISPLAYON/OFF to send after the next handover, or 0.
+  uint8_t _command = 0;
+  DisplayStats _stats = {};
+
+  // The front buffer and what of it is to be sent belong to the flush task
+  // while _flushPending is set, and to the renderer otherwise.
+  uint8_t* _front = nullptr;
+  int16_t _frontFrom[MAX_PAGES];
+  int16_t _frontTo[MAX_PAGES];
+  uint8_t _frontCommand = 0;
+  std::atomic<bool> _flushPending{false};
+  std::atomic<uint32_t> _busClock;
+  TaskHandle_t _flushTask = nullptr;
+  std::atomic<uint32_t> _flushes{0};
+  std::atomic<uint32_t> _droppedFrames{0};
+  std::atomic<uint32_t> _bytesSent{0};
+  std::atomic<uint64_t> _flushUs{0};
+  Histogram _flushLatency;
 
  public:
+  static const uint32_t DEFAULT_BUS_CLOCK = 400000;
+
   StatefulDisplay(int width, int height, TwoWire* wire, int i2cAddress, int screenTimeout = 30000) :
     _display(width, height, wire),
+    _wire(wire),
     _i2cAddress(i2cAddress),
     _lastFrame(0),
     _screenOnAt(0),
     _screenTimeout(screenTimeout),
     _wifiState(),
     _ipAddress(INADDR_NONE),
-    _ssid(""),
+    _ssid(),
     _wifiSignalStrength(0),
     _thermocoupleState(),
     _coldJunction(),
     _hotJunction(),
-    _timeReady(false)
+    _timeReady(false),
+    _busClock(DEFAULT_BUS_CLOCK)
   {}
 
   void updateWiFi(
     StatefulWiFiStates::State wifiState,
     const IPAddress& ipAddress = INADDR_NONE,
-    const String& ssid = "",
+    const char* ssid = "",
     int signalStrength = 0
   ) {
     this->_wifiState = wifiState;
     this->_ipAddress = ipAddress;
-    this->_ssid = ssid;
+    snprintf(this->_ssid, sizeof(this->_ssid), "%s", ssid);
     this->_wifiSignalStrength = signalStrength;
   }
 
   void updateThermocouple(
     StatefulThermocoupleStates::State thermocoupleState,
-    double coldJunction = NAN,
-    double hotJunction = NAN
+    Celsius coldJunction = Celsius(),
+    Celsius hotJunction = Celsius()
   ) {
     this->_thermocoupleState = thermocoupleState;
     this->_coldJunction = coldJunction;
     this->_hotJunction = hotJunction;
   }
 
+  // Meat probes, from 1 up to the number of probes.
+  void updateProbe(size_t probe, bool ready, Celsius hotJunction = Celsius()) {
+    if (probe == 0 || probe >= MAX31855Bus::MAX_DEVICES) {
+      return;
+    }
+    this->_probeCount = std::max(this->_probeCount, probe + 1);
+    this->_probeReady[probe] = ready;
+    this->_probeTemperatures[probe] = hotJunction;
+  }
+
   void startTime() {
     this->_timeReady = true;
   }
 
   void wakeup() {
-    this->setState(StatefulDisplayStates::State::ON);
+    this->changeState(StatefulDisplayStates::State::ON);
   }
 
   void sleep() {
-    this->setState(StatefulDisplayStates::State::OFF);
+    this->changeState(StatefulDisplayStates::State::OFF);
+  }
+
+  // I2C clock for frames, e.g. 400000 or 1000000 for panels that take it.
+  void setBusClock(uint32_t hz) {
+    this->_busClock = hz;
+  }
+
+  TaskHandle_t getFlushTask() const {
+    return this->_flushTask;
+  }
+
+  // Each handover's I2C transfer, on the flush task.
+  const Histogram& getFlushLatency() const {
+    return this->_flushLatency;
+  }
+
+  DisplayStats getStats() const {
+    auto stats = this->_stats;
+    stats.flushes = this->_flushes;
+    stats.droppedFrames = this->_droppedFrames;
+    stats.bytesSent = this->_bytesSent;
+    stats.flushUs = this->_flushUs;
+    return stats;
+  }
+
+  unsigned long getNextDeadline() override {
+    if (this->getState() == StatefulDisplayStates::State::OFF) {
+      // Until the flush task has taken the power-off command.
+      return this->_command ? this->_lastFrame + StatefulDisplay::FRAME_INTERVAL : Process::IDLE;
+    }
+    unsigned long now = millis();
+    unsigned long deadline = this->_lastFrame + StatefulDisplay::FRAME_INTERVAL;
+    if (this->_screenTimeout != 0) {
+      deadline = LoopScheduler::earliest(deadline, this->_screenOnAt + this->_screenTimeout + 1, now);
+    }
+    return deadline;
   }
 
   void setup() override {
     this->_display.begin(SSD1306_SWITCHCAPVCC, this->_i2cAddress);
+    size_t size = this->_display.width() * ((this->_display.height() + 7) / 8);
+    this->_front = (uint8_t*) malloc(size);
+    memset(this->_front, 0, size);
+    for (int page = 0; page < StatefulDisplay::MAX_PAGES; page++) {
+      this->_frontFrom[page] = INT16_MAX;
+      this->_frontTo[page] = -1;
+    }
+    this->cacheTemperatureGlyphs();
+    this->forgetPanel();
     this->onState(StatefulDisplayStates::State::ON, [this](){
-      if (this->getPreviousState() != this->getState()) {
-        Serial.println("screen on");
-        this->_screenOnAt = millis();
-        this->_display.clearDisplay();
-        this->_display.display();
-        this->_display.ssd1306_command(SSD1306_DISPLAYON);
-      }
+      Serial.println("screen on");
+      this->_screenOnAt = millis();
+      this->_display.clearDisplay();
+      this->forgetPanel();
+      this->markDirty(Bounds{0, 0, (int16_t) (this->_display.width() - 1), (int16_t) (this->_display.height() - 1)});
+      this->_command = SSD1306_DISPLAYON;
     });
     this->onState(StatefulDisplayStates::State::OFF, [this](){
-      if (this->getPreviousState() != this->getState()) {
-        Serial.println("screen off");
-        this->_display.clearDisplay();
-        this->_display.ssd1306_command(SSD1306_DISPLAYOFF);
-      }
+      Serial.println("screen off");
+      this->_display.clearDisplay();
+      this->forgetPanel();
+      this->_command = SSD1306_DISPLAYOFF;
+      this->handOver(false);
     });
-    this->setState(StatefulDisplayStates::State::ON);
+    xTaskCreatePinnedToCore(
+      StatefulDisplay::flushTask,
+      "display",
+      StatefulDisplay::FLUSH_TASK_STACK,
+      this,
+      StatefulDisplay::FLUSH_TASK_PRIORITY,
+      &this->_flushTask,
+      StatefulDisplay::FLUSH_TASK_CORE
+    );
+    this->changeState(StatefulDisplayStates::State::ON);
   }
 
   void process() override {
     if (this->getState() == StatefulDisplayStates::State::OFF) {
+      if (this->_command) {
+        this->_lastFrame = millis();
+        this->handOver(false);
+      }
       return;
     }
     unsigned long now = millis();
     if (this->_screenTimeout != 0 && now - this->_screenOnAt > this->_screenTimeout) {
-      this->setState(StatefulDisplayStates::State::OFF);
+      this->changeState(StatefulDisplayStates::State::OFF);
       return;
     }
     if (now - this->_lastFrame < StatefulDisplay::FRAME_INTERVAL) {
       return;
     }
-    this->_display.clearDisplay();
-    this->_renderWiFiStatus();
-    this->_renderTemperatures();
-    this->_renderTime();
-    this->_display.display();
     this->_lastFrame = now;
-//    if (now - this->_lastFrame > StatefulDisplay::FRAME_INTERVAL) {
-//      this->_display.clearDisplay();
-//      const auto height = this->_display.height();
-//      const auto width = this->_display.width();
-//      this->_display.setTextColor(SSD1306_WHITE);
-//      this->_display.setFont(&TomThumb);
-//      this->_display.setTextSize(1);
-//      this->_display.setTextWrap(false);
-//      int16_t x, y;
-//      uint16_t w, h;
-//      switch (this->_wifiState) {
-//        case StatefulWiFiStates::State::CONNECTED: {
-//          this->_display.getTextBounds(this->_ssid, 0, height, &x, &y, &w, &h);
-//          this->_display.setCursor(0, 6);
-//          this->_display.print(this->_ipAddress);
-//          this->_display.setCursor(0, 12);
-//          this->_display.print(this->_ssid);
-//          this->_display.setCursor(0, 18);
-//          this->_display.printf("Signal: %i%%", this->_wifiSignalStrength);
-//          break;
-//        }
-//        case StatefulWiFiStates::State::DISCONNECTED:
-//          this->_display.setCursor(0, 6);
-//          this->_display.print("Connecting...");
-//          break;
-//        case StatefulWiFiStates::State::PROVISIONING:
-//          this->_display.setCursor(0, 6);
-//          this->_display.print("WiFi config portal active...");
-//          break;
-//        case StatefulWiFiStates::State::ERROR:
-//          this->_display.setCursor(0, 6);
-//          this->_display.print("WiFi failed to initialize...");
-//          break;
-//      }
-//
-//      this->_display.setFont(&FreeSans18pt7b);
-//      this->_display.setCursor(0, 18);
-//      this->_display.getTextBounds("72", 0, height, &x, &y, &w, &h);
-//      this->_display.setCursor(width - w - 6, 24);
-//      this->_display.print("72");
-//      this->_display.setFont(&TomThumb);
-//      this->_display.setCursor(width - 3, 6);
-//      this->_display.print("F");
-//      if (now % 2 == 0) {
-//        this->_display.setCursor(0, height);
-//        this->_display.print('.');
-//      }
-//      this->_display.display();
-//      this->_lastFrame = now;
-//    }
+    auto start = esp_timer_get_time();
+    this->_composeWiFiStatus();
+    this->_composeTemperatures();
+    this->_composeProbes();
+    this->_composeTime();
+    bool changed = this->render();
+    if (changed) {
+      this->_stats.frames++;
+    } else {
+      this->_stats.unchangedFrames++;
+    }
+    this->handOver(changed);
+    auto elapsed = (uint32_t) (esp_timer_get_time() - start);
+    this->_stats.busyUs += elapsed;
+    this->_stats.maxFrameUs = std::max(this->_stats.maxFrameUs, elapsed);
   };
 
  protected:
 
-  void _renderWiFiStatus() {
-    this->_display.setTextColor(SSD1306_WHITE);
-    this->_display.setFont(&TomThumb);
-    this->_display.setTextSize(1);
-    this->_display.setTextWrap(false);
-    int16_t x, y;
-    uint16_t w, h;
+  void _composeWiFiStatus() {
+    auto& widget = this->_wanted[StatefulDisplay::WIFI_STATUS];
     switch (this->_wifiState) {
-      case StatefulWiFiStates::State::CONNECTED: {
-        this->_display.getTextBounds(this->_ssid, 0, this->_display.height(), &x, &y, &w, &h);
-        this->_display.setCursor(0, 6);
-        this->_display.print(this->_ipAddress);
-        this->_display.setCursor(0, 12);
-        this->_display.print(this->_ssid);
-        this->_display.setCursor(0, 18);
-        this->_display.printf("Signal: %i%%", this->_wifiSignalStrength);
+      case StatefulWiFiStates::State::CONNECTED:
+        snprintf(widget.text, sizeof(widget.text), "%u.%u.%u.%u\n%s\nSignal: %i%%",
+                 this->_ipAddress[0], this->_ipAddress[1], this->_ipAddress[2], this->_ipAddress[3],
+                 this->_ssid, this->_wifiSignalStrength);
         break;
-      }
       case StatefulWiFiStates::State::DISCONNECTED:
-        this->_display.setCursor(0, 6);
-        this->_display.print("Connecting...");
+        snprintf(widget.text, sizeof(widget.text), "Connecting...");
         break;
       case StatefulWiFiStates::State::PROVISIONING:
-        this->_display.setCursor(0, 6);
-        this->_display.print("WiFi config portal active...");
+        snprintf(widget.text, sizeof(widget.text), "WiFi config portal active...");
         break;
       case StatefulWiFiStates::State::ERROR:
-        this->_display.setCursor(0, 6);
-        this->_display.print("WiFi failed to initialize...");
+        snprintf(widget.text, sizeof(widget.text), "WiFi failed to initialize...");
         break;
     }
+    this->measure(StatefulDisplay::WIFI_STATUS, &TomThumb, 0, 6);
   }
 
-  void _renderTime() {
+  void _composeTime() {
+    auto& widget = this->_wanted[StatefulDisplay::CLOCK];
     if (!this->_timeReady) {
-      return;
+      widget.text[0] = '\0';
+    } else {
+      // Only reformatted when the second turns over.
+      time_t now = time(nullptr);
+      if (now != this->_clockTime) {
+        this->_clockTime = now;
+        formatTime(widget.text, sizeof(widget.text), StatefulDisplay::CLOCK_FORMAT, now);
+      }
     }
-    this->_display.setCursor(0, this->_display.height());
-    this->_display.print(getTime("%F %r"));
+    this->measure(StatefulDisplay::CLOCK, &TomThumb, 0, this->_display.height());
   }
 
-  void _renderTemperatures() {
+  void _composeTemperatures() {
+    auto& temperature = this->_wanted[StatefulDisplay::TEMPERATURE];
+    auto& unit = this->_wanted[StatefulDisplay::UNIT];
     if (this->_thermocoupleState != StatefulThermocoupleStates::State::READY) {
+      temperature.text[0] = '\0';
+      unit.text[0] = '\0';
+    } else {
+      this->_hotJunction.to<TemperatureUnits::Fahrenheit>().format(temperature.text, sizeof(temperature.text), 0);
+      snprintf(unit.text, sizeof(unit.text), "%c", TemperatureUnits::Fahrenheit::SYMBOL);
+    }
+    this->measureTemperature();
+    this->measure(StatefulDisplay::UNIT, &TomThumb, this->_display.width() - 3, 6);
+  }
+
+  // Meat probes left-aligned under the WiFi status, "--" for a fault.
+  void _composeProbes() {
+    auto& widget = this->_wanted[StatefulDisplay::PROBES];
+    size_t n = 0;
+    widget.text[0] = '\0';
+    for (size_t i = 1; i < this->_probeCount && n < sizeof(widget.text) - 1; i++) {
+      if (i > 1) {
+        widget.text[n++] = ' ';
+      }
+      if (this->_probeReady[i]) {
+        n += this->_probeTemperatures[i].to<TemperatureUnits::Fahrenheit>().format(widget.text + n, sizeof(widget.text) - n, 0);
+      } else {
+        n += snprintf(widget.text + n, sizeof(widget.text) - n, "--");
+      }
+    }
+    this->measure(StatefulDisplay::PROBES, &TomThumb, 0, 24);
+  }
+
+  /**
+   * Bounds of a widget's text drawn from (x, y). Text that has not changed
+   * keeps the bounds it was drawn with, so getTextBounds runs only on change.
+   */
+  void measure(Widget widget, const GFXfont* font, int16_t x, int16_t y) {
+    auto& wanted = this->_wanted[widget];
+    const auto& shown = this->_shown[widget];
+    if (strcmp(wanted.text, shown.text) == 0) {
+      wanted.bounds = shown.bounds;
+      return;
+    }
+    wanted.bounds = StatefulDisplay::emptyBounds();
+    if (!wanted.text[0]) {
       return;
     }
-    auto height = this->_display.height();
-    auto width = this->_display.width();
-    auto hotJunction = String(celsiusToFarenheit(this->_hotJunction), 0);
-    int16_t x, y;
+    int16_t x1, y1;
     uint16_t w, h;
-    this->_display.setFont(&FreeSans18pt7b);
-    this->_display.setCursor(0, 18);
-    this->_display.getTextBounds(hotJunction, 0, height, &x, &y, &w, &h);
-    this->_display.setCursor(width - w - 6, 24);
-    this->_display.print(hotJunction);
-    this->_display.setFont(&TomThumb);
-    this->_display.setCursor(width - 3, 6);
-    this->_display.print("F");
+    this->_display.setFont(font);
+    this->_display.setTextSize(1);
+    this->_display.getTextBounds(wanted.text, x, y, &x1, &y1, &w, &h);
+    if (w && h) {
+      wanted.bounds = Bounds{x1, y1, (int16_t) (x1 + w - 1), (int16_t) (y1 + h - 1)};
+    }
+  }
+
+  // The hot junction is right-aligned 6px from the edge on a baseline of 24.
+  void measureTemperature() {
+    auto& wanted = this->_wanted[StatefulDisplay::TEMPERATURE];
+    const auto& shown = this->_shown[StatefulDisplay::TEMPERATURE];
+    if (strcmp(wanted.text, shown.text) == 0) {
+      wanted.bounds = shown.bounds;
+      return;
+    }
+    wanted.bounds = StatefulDisplay::emptyBounds();
+    int16_t cursor = 0;
+    int16_t minX = INT16_MAX;
+    int16_t minY = INT16_MAX;
+    int16_t maxX = INT16_MIN;
+    int16_t maxY = INT16_MIN;
+    for (const char* c = wanted.text; *c; c++) {
+      auto glyph = strchr(StatefulDisplay::TEMPERATURE_GLYPHS, *c);
+      if (!glyph) {
+        // Not a cached glyph: measure it the slow way, then right-align.
+        this->measure(StatefulDisplay::TEMPERATURE, &FreeSans18pt7b, 0, 24);
+        auto& bounds = wanted.bounds;
+        if (bounds.x0 <= bounds.x1) {
+          int16_t shift = this->_display.width() - (bounds.x1 - bounds.x0 + 1) - 6;
+          bounds.x0 += shift;
+          bounds.x1 += shift;
+        }
+        return;
+      }
+      const auto& metrics = this->_temperatureGlyphs[glyph - StatefulDisplay::TEMPERATURE_GLYPHS];
+      if (metrics.width && metrics.height) {
+        minX = std::min<int16_t>(minX, cursor + metrics.xOffset);
+        maxX = std::max<int16_t>(maxX, cursor + metrics.xOffset + metrics.width - 1);
+        minY = std::min<int16_t>(minY, metrics.yOffset);
+        maxY = std::max<int16_t>(maxY, metrics.yOffset + metrics.height - 1);
+      }
+      cursor += metrics.xAdvance;
+    }
+    if (maxX < minX) {
+      return;
+    }
+    int16_t x = this->_display.width() - (maxX - minX + 1) - 6;
+    wanted.bounds = Bounds{(int16_t) (x + minX), (int16_t) (24 + minY), (int16_t) (x + maxX), (int16_t) (24 + maxY)};
+  }
+
+  void cacheTemperatureGlyphs() {
+    const GFXfont& font = FreeSans18pt7b;
+    for (size_t i = 0; StatefulDisplay::TEMPERATURE_GLYPHS[i]; i++) {
+      const GFXglyph& glyph = font.glyph[StatefulDisplay::TEMPERATURE_GLYPHS[i] - font.first];
+      this->_temperatureGlyphs[i] = GlyphMetrics{glyph.xOffset, glyph.yOffset, glyph.width, glyph.height, glyph.xAdvance};
+    }
+  }
+
+  /**
+   * Brings the framebuffer up to date with _wanted. Returns false if nothing
+   * changed.
+   */
+  bool render() {
+    bool dirty[WIDGET_COUNT] = {};
+    bool changed = false;
+    for (int i = 0; i < WIDGET_COUNT; i++) {
+      dirty[i] = strcmp(this->_wanted[i].text, this->_shown[i].text) != 0;
+      changed |= dirty[i];
+    }
+    if (!changed) {
+      return false;
+    }
+    // Clearing a widget clears whatever overlaps it, so those redraw too.
+    for (bool grew = true; grew;) {
+      grew = false;
+      for (int i = 0; i < WIDGET_COUNT; i++) {
+        for (int j = 0; j < WIDGET_COUNT && !dirty[i]; j++) {
+          if (dirty[j] && (StatefulDisplay::intersects(this->_shown[i].bounds, this->_shown[j].bounds)
+                           || StatefulDisplay::intersects(this->_shown[i].bounds, this->_wanted[j].bounds))) {
+            dirty[i] = grew = true;
+          }
+        }
+      }
+    }
+    for (int i = 0; i < WIDGET_COUNT; i++) {
+      if (dirty[i]) {
+        this->erase(this->_shown[i].bounds);
+      }
+    }
+    for (int i = 0; i < WIDGET_COUNT; i++) {
+      if (dirty[i]) {
+        this->draw((Widget) i);
+        this->markDirty(this->_wanted[i].bounds);
+        this->_shown[i] = this->_wanted[i];
+        this->_stats.widgetRenders++;
+      }
+    }
+    return true;
+  }
+
+  void draw(Widget widget) {
+    const char* text = this->_wanted[widget].text;
+    if (!text[0]) {
+      return;
+    }
+    this->_display.setTextColor(SSD1306_WHITE);
+    this->_display.setTextSize(1);
+    this->_display.setTextWrap(false);
+    switch (widget) {
+      case StatefulDisplay::WIFI_STATUS:
+        this->_display.setFont(&TomThumb);
+        this->_display.setCursor(0, 6);
+        break;
+      case StatefulDisplay::TEMPERATURE: {
+        const auto& bounds = this->_wanted[widget].bounds;
+        this->_display.setFont(&FreeSans18pt7b);
+        this->_display.setCursor(this->_display.width() - (bounds.x1 - bounds.x0 + 1) - 6, 24);
+        break;
+      }
+      case StatefulDisplay::UNIT:
+        this->_display.setFont(&TomThumb);
+        this->_display.setCursor(this->_display.width() - 3, 6);
+        break;
+      case StatefulDisplay::PROBES:
+        this->_display.setFont(&TomThumb);
+        this->_display.setCursor(0, 24);
+        break;
+      case StatefulDisplay::CLOCK:
+        this->_display.setFont(&TomThumb);
+        this->_display.setCursor(0, this->_display.height());
+        break;
+      default:
+        return;
+    }
+    this->_display.print(text);
+  }
+
+  void erase(const Bounds& bounds) {
+    if (bounds.x1 < bounds.x0) {
+      return;
+    }
+    this->_display.fillRect(bounds.x0, bounds.y0, bounds.x1 - bounds.x0 + 1, bounds.y1 - bounds.y0 + 1, SSD1306_BLACK);
+    this->markDirty(bounds);
+  }
+
+  void markDirty(const Bounds& bounds) {
+    int16_t x0 = std::max<int16_t>(bounds.x0, 0);
+    int16_t x1 = std::min<int16_t>(bounds.x1, this->_display.width() - 1);
+    int16_t y0 = std::max<int16_t>(bounds.y0, 0);
+    int16_t y1 = std::min<int16_t>(bounds.y1, this->_display.height() - 1);
+    if (x1 < x0 || y1 < y0) {
+      return;
+    }
+    for (int page = y0 / 8; page <= y1 / 8 && page < StatefulDisplay::MAX_PAGES; page++) {
+      this->_dirtyFrom[page] = std::min(this->_dirtyFrom[page], x0);
+      this->_dirtyTo[page] = std::max(this->_dirtyTo[page], x1);
+    }
+  }
+
+  /**
+   * Copies what changed in the back buffer to the front buffer and wakes the
+   * flush task, unless it is still busy with the last frame.
+   */
+  void handOver(bool changed) {
+    int pages = std::min<int>((this->_display.height() + 7) / 8, StatefulDisplay::MAX_PAGES);
+    bool dirty = this->_command != 0;
+    for (int page = 0; page < pages && !dirty; page++) {
+      dirty = this->_dirtyFrom[page] <= this->_dirtyTo[page];
+    }
+    if (!dirty) {
+      return;
+    }
+    if (this->_flushPending.load(std::memory_order_acquire)) {
+      if (changed) {
+        this->_stats.coalescedFrames++;
+      }
+      return;
+    }
+    const uint8_t* back = this->_display.getBuffer();
+    int width = this->_display.width();
+    for (int page = 0; page < pages; page++) {
+      if (this->_dirtyFrom[page] > this->_dirtyTo[page]) {
+        continue;
+      }
+      int offset = page * width + this->_dirtyFrom[page];
+      memcpy(this->_front + offset, back + offset, this->_dirtyTo[page] - this->_dirtyFrom[page] + 1);
+      this->_frontFrom[page] = std::min(this->_frontFrom[page], this->_dirtyFrom[page]);
+      this->_frontTo[page] = std::max(this->_frontTo[page], this->_dirtyTo[page]);
+      this->_dirtyFrom[page] = INT16_MAX;
+      this->_dirtyTo[page] = -1;
+    }
+    this->_frontCommand = this->_command;
+    this->_command = 0;
+    this->_flushPending.store(true, std::memory_order_release);
+    xTaskNotifyGive(this->_flushTask);
+  }
+
+  static void flushTask(void* parameters) {
+    auto self = static_cast<StatefulDisplay*>(parameters);
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      if (self->_flushPending.load(std::memory_order_acquire)) {
+        auto start = esp_timer_get_time();
+        if (!self->flush()) {
+          self->_droppedFrames++;
+        }
+        self->_flushes++;
+        auto elapsed = esp_timer_get_time() - start;
+        self->_flushUs += elapsed;
+        self->_flushLatency.observe((uint32_t) elapsed);
+        self->_flushPending.store(false, std::memory_order_release);
+      }
+    }
+  }
+
+  /**
+   * On the flush task: sends each run of consecutive dirty pages of the
+   * front buffer as one window spanning the columns any of them touched,
+   * then any power command. False if the panel failed to acknowledge.
+   */
+  bool flush() {
+    bool ok = true;
+    int pages = std::min<int>((this->_display.height() + 7) / 8, StatefulDisplay::MAX_PAGES);
+    uint32_t clock = this->_busClock;
+    this->_wire->setClock(clock);
+    for (int page = 0; page < pages;) {
+      if (this->_frontTo[page] < this->_frontFrom[page]) {
+        page++;
+        continue;
+      }
+      int last = page;
+      int16_t from = this->_frontFrom[page];
+      int16_t to = this->_frontTo[page];
+      while (last + 1 < pages && this->_frontFrom[last + 1] <= this->_frontTo[last + 1]) {
+        last++;
+        from = std::min(from, this->_frontFrom[last]);
+        to = std::max(to, this->_frontTo[last]);
+      }
+      ok &= this->sendWindow(page, last, from, to);
+      for (; page <= last; page++) {
+        this->_frontFrom[page] = INT16_MAX;
+        this->_frontTo[page] = -1;
+      }
+    }
+    if (this->_frontCommand) {
+      const uint8_t command[] = {0x00, this->_frontCommand};
+      ok &= this->transmit(command, sizeof(command));
+      this->_frontCommand = 0;
+    }
+    this->_wire->setClock(StatefulDisplay::I2C_IDLE_CLOCK);
+    return ok;
+  }
+
+  bool sendWindow(uint8_t firstPage, uint8_t lastPage, uint8_t firstColumn, uint8_t lastColumn) {
+    const uint8_t addressing[] = {
+      0x00,
+      SSD1306_PAGEADDR, firstPage, lastPage,
+      SSD1306_COLUMNADDR, firstColumn, lastColumn
+    };
+    bool ok = this->transmit(addressing, sizeof(addressing));
+    size_t width = this->_display.width();
+    size_t columns = lastColumn - firstColumn + 1;
+    for (uint8_t page = firstPage; page <= lastPage; page++) {
+      const uint8_t* row = this->_front + page * width + firstColumn;
+      for (size_t sent = 0; sent < columns;) {
+        size_t chunk = std::min(columns - sent, (size_t) StatefulDisplay::WIRE_CHUNK);
+        this->_wire->beginTransmission(this->_i2cAddress);
+        this->_wire->write((uint8_t) 0x40);
+        this->_wire->write(row + sent, chunk);
+        ok &= this->_wire->endTransmission() == 0;
+        this->_bytesSent += chunk + 1;
+        sent += chunk;
+      }
+    }
+    return ok;
+  }
+
+  bool transmit(const uint8_t* data, size_t length) {
+    this->_wire->beginTransmission(this->_i2cAddress);
+    this->_wire->write(data, length);
+    this->_bytesSent += length;
+    return this->_wire->endTransmission() == 0;
+  }
+
+  // After the panel was cleared: every widget is drawn afresh.
+  void forgetPanel() {
+    for (auto& widget : this->_shown) {
+      widget.text[0] = '\0';
+      widget.bounds = StatefulDisplay::emptyBounds();
+    }
+    for (int page = 0; page < StatefulDisplay::MAX_PAGES; page++) {
+      this->_dirtyFrom[page] = INT16_MAX;
+      this->_dirtyTo[page] = -1;
+    }
+    this->_clockTime = 0;
+  }
+
+  static Bounds emptyBounds() {
+    return Bounds{0, 0, -1, -1};
+  }
+
+  static bool intersects(const Bounds& a, const Bounds& b) {
+    return a.x0 <= a.x1 && b.x0 <= b.x1
+        && a.x0 <= b.x1 && b.x0 <= a.x1
+        && a.y0 <= b.y1 && b.y0 <= a.y1;
   }
 
 };
 
-}
\ No newline at end of file
+}
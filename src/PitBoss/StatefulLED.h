@@ -13,10 +13,11 @@ enum State {
   ERROR,
   READY
 };
+static const size_t COUNT = READY + 1;
 
 }
 
-class StatefulLED : public Stateful<StatefulLEDStates::State>, Process {
+class StatefulLED : public Stateful<StatefulLEDStates::State, StatefulLEDStates::COUNT>, Process {
  public:
 
  protected:
@@ -3,7 +3,18 @@
 #include "Process.h"
 #include "Logger.h"
 #include <PitBoss/Stateful.h>
-#include <Adafruit_MAX31855.h>
+#include <PitBoss/MAX31855.h>
+#include <PitBoss/Calibration.h>
+#include <PitBoss/Filter.h>
+#include <PitBoss/Metrics.h>
+#include <PitBoss/Snapshot.h>
+#include <PitBoss/SpscQueue.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 namespace PitBoss {
 
 namespace StatefulThermocoupleStates {
@@ -12,80 +23,465 @@ enum State {
   ERROR,
   READY
 };
+static const size_t COUNT = READY + 1;
 
 }
 
+/**
+ * sequence is the index of the sampling deadline the sample was taken for, so
+ * deadlines that were missed leave gaps in it. frames are the raw readings of
+ * each probe taken at that deadline, probe 0 being the pit; hotJunctions are
+ * the same readings calibrated and through each probe's filter chain, and
+ * like the frames' are meaningless if they have faults.
+ */
+struct ThermocoupleSample {
+  static const size_t MAX_PROBES = MAX31855Bus::MAX_DEVICES;
+
+  uint32_t sequence = 0;
+  int64_t timestamp = 0;
+  uint8_t probes = 0;
+  MAX31855Frame frames[MAX_PROBES];
+  Celsius hotJunctions[MAX_PROBES];
+};
+
+// Spikes go to the median first, so they never reach the averaging stages.
+typedef FilterChain<MedianFilter<FilterConfig::MAX_MEDIAN>, EmaFilter, KalmanFilter> ThermocoupleFilter;
+
+struct SamplingStats {
+  uint32_t samples;
+  // Sweeps of the probes, oversampling included.
+  uint32_t reads;
+  uint32_t missedDeadlines;
+  uint32_t droppedSamples;
+  int32_t lastJitterUs;
+  uint32_t maxJitterUs;
+  uint32_t meanJitterUs;
+};
+
+/**
+ * One probe's state machine and fault counts, driven from
+ * StatefulThermocouple::process() on the loop task. Fault counts may be read
+ * from any task.
+ */
+class ThermocoupleProbe :
+  public Stateful<StatefulThermocoupleStates::State, StatefulThermocoupleStates::COUNT>,
+  public Logger
+{
+  friend class StatefulThermocouple;
+
+ public:
+  // One per fault bit, in bit order.
+  static const size_t FAULT_TYPES = 4;
+
+ protected:
+  size_t _index = 0;
+  uint8_t _faults = MAX31855Faults::Fault::NONE;
+  std::atomic<uint32_t> _faultCounts[FAULT_TYPES] = {};
+
+ public:
+  ThermocoupleProbe() :
+    Logger(&SystemLog)
+  {}
+
+  // Faults of the newest sample.
+  uint8_t getFaults() const {
+    return this->_faults;
+  }
+
+  // Samples that had the fault, one of MAX31855Faults::Fault.
+  uint32_t getFaultCount(uint8_t fault) const {
+    for (size_t i = 0; i < ThermocoupleProbe::FAULT_TYPES; i++) {
+      if (fault == (1 << i)) {
+        return this->_faultCounts[i];
+      }
+    }
+    return 0;
+  }
+
+ protected:
+  void update(const MAX31855Frame& frame) {
+    auto faults = frame.faults();
+    this->_faults = faults;
+    for (size_t i = 0; i < ThermocoupleProbe::FAULT_TYPES; i++) {
+      if (faults & (1 << i)) {
+        this->_faultCounts[i]++;
+      }
+    }
+    if (!this->changeState(faults ? StatefulThermocoupleStates::State::ERROR : StatefulThermocoupleStates::State::READY)) {
+      return;
+    }
+    if (faults & MAX31855Faults::Fault::NO_RESPONSE) {
+      this->_log->error(F("Probe %u: unable to read cold junction temperature. Is the MAX31855 connected correctly?"), this->_index);
+    } else if (faults) {
+      this->_log->error(F("Probe %u: unable to read hot junction temperature (%s). Did you plug the thermocouple in correctly?"), this->_index, MAX31855Frame::describe(faults));
+    }
+  }
+};
+
+/**
+ * Samples are taken by a dedicated task at fixed absolute deadlines
+ * (start + n * readInterval), so a slow loop iteration delays when a sample is
+ * handled but never when it is taken. process() consumes them on the loop
+ * task and drives the state machine from there.
+ *
+ * Each sample is also published to a snapshot as soon as it is taken, which
+ * any task can read without touching the SPI bus or the state machine.
+ *
+ * Every probe is read in one sweep of the SPI bus, and each has its own
+ * state machine; this one's state is the pit probe's (probe 0), as a meat
+ * probe left unplugged is no error.
+ *
+ * Each probe's calibration is applied to every reading before its filter
+ * chain, from a table compiled off the sampling task.
+ *
+ * With oversampling, the probes are read that many times per interval, up
+ * to as fast as the MAX31855 converts, and every reading goes through the
+ * probe's filter chain; the sample carries the filters' output as of its
+ * deadline. Faulted readings reset the chain instead, so a replugged probe
+ * starts afresh.
+ */
 class StatefulThermocouple :
-  public Stateful<StatefulThermocoupleStates::State>,
+  public Stateful<StatefulThermocoupleStates::State, StatefulThermocoupleStates::COUNT>,
   public Process,
   public Logger
 {
  protected:
-  unsigned long _lastReading = 0;
-  double _currentColdJunction = 0;
-  double _currentHotJunction = 0;
+  static const uint32_t SAMPLING_TASK_STACK = 3072;
+  static const UBaseType_t SAMPLING_TASK_PRIORITY = 10;
+  static const BaseType_t SAMPLING_TASK_CORE = APP_CPU_NUM;
+  static const size_t SAMPLE_QUEUE_LENGTH = 8;
+
+  struct CalibrationUpdate {
+    size_t probe;
+    CalibrationTable table;
+  };
+
+  struct SamplingUpdate {
+    FilterConfig filter;
+    unsigned long oversampling;
+  };
+
   unsigned long _startupDelay;
   unsigned long _readInterval;
-  Adafruit_MAX31855 _thermocouple;
+  // Written by the sampling task once running, read from any.
+  std::atomic<unsigned long> _oversampling{1};
+  MAX31855Bus _bus;
+  int _csPins[ThermocoupleSample::MAX_PROBES] = {};
+  size_t _probeCount = 0;
+  ThermocoupleProbe _probes[ThermocoupleSample::MAX_PROBES];
+  ThermocoupleFilter _filters[ThermocoupleSample::MAX_PROBES];
+  // Read by the sampling task only, which takes updates from the queue.
+  CalibrationTable _calibrations[ThermocoupleSample::MAX_PROBES];
+  SpscQueue<CalibrationUpdate, 2> _calibrationUpdates;
+  SpscQueue<SamplingUpdate, 2> _samplingUpdates;
+  Snapshot<ThermocoupleSample> _snapshot;
+  TaskHandle_t _samplingTask = nullptr;
+  SpscQueue<ThermocoupleSample, SAMPLE_QUEUE_LENGTH> _samples;
+  std::vector<std::function<void(const ThermocoupleSample&)>> _sampleListeners;
+  std::function<void()> _sampleQueued;
+
+  // Written by the sampling task only.
+  uint32_t _sequence = 0;
+  int32_t _filtered[ThermocoupleSample::MAX_PROBES] = {};
+  std::atomic<uint32_t> _reads{0};
+  std::atomic<uint32_t> _missedDeadlines{0};
+  std::atomic<uint32_t> _droppedSamples{0};
+  std::atomic<int32_t> _lastJitterUs{0};
+  std::atomic<uint32_t> _maxJitterUs{0};
+  std::atomic<uint64_t> _totalJitterUs{0};
+  std::atomic<uint32_t> _sampleCount{0};
+  std::atomic<uint64_t> _busyUs{0};
+  Histogram _spiLatency;
  public:
-  StatefulThermocouple(Logging* log, unsigned long startupDelay, unsigned long readInterval, int csPin) :
+  StatefulThermocouple(AsyncLog* log, unsigned long startupDelay, unsigned long readInterval,
+                       int clkPin = MAX31855Bus::DEFAULT_CLK_PIN, int misoPin = MAX31855Bus::DEFAULT_MISO_PIN) :
     Logger(log),
     _startupDelay(startupDelay),
     _readInterval(readInterval),
-    _thermocouple(csPin)
-  {}
+    _bus(clkPin, misoPin)
+  {
+    for (size_t i = 0; i < ThermocoupleSample::MAX_PROBES; i++) {
+      this->_probes[i]._log = log;
+      this->_probes[i]._index = i;
+    }
+  }
 
-  StatefulThermocouple(Logging* log, unsigned long startupDelay, unsigned long readInterval, int csPin, int clkPin, int misoPin) :
-    Logger(log),
-    _startupDelay(startupDelay),
-    _readInterval(readInterval),
-    _thermocouple(csPin, clkPin, misoPin)
-  {}
+  // Before setup(): the chip select of each probe, the pit's first.
+  void configureProbes(const int* csPins, size_t count) {
+    this->_probeCount = std::min(count, ThermocoupleSample::MAX_PROBES);
+    for (size_t i = 0; i < this->_probeCount; i++) {
+      this->_csPins[i] = csPins[i];
+    }
+  }
+
+  // Before setup(), and before configureFilter().
+  void configureReadInterval(unsigned long readInterval) {
+    this->_readInterval = readInterval;
+  }
+
+  // Before setup(). An oversampling of 0 reads as fast as the MAX31855
+  // converts.
+  void configureFilter(const FilterConfig& config, unsigned long oversampling) {
+    this->_oversampling = this->limitOversampling(oversampling);
+    for (auto& filter : this->_filters) {
+      filter.configure(config);
+    }
+  }
+
+  // Once running, from one task only. Taken after the next sample, so the
+  // samples keep their deadlines; every filter starts afresh. False if the
+  // last two updates have not been taken yet.
+  bool updateFilter(const FilterConfig& config, unsigned long oversampling) {
+    SamplingUpdate update;
+    update.filter = config;
+    update.oversampling = this->limitOversampling(oversampling);
+    return this->_samplingUpdates.push(update);
+  }
+
+  // Before setup().
+  void configureCalibration(size_t probe, const ProbeCalibration& calibration) {
+    this->_calibrations[probe].compile(calibration);
+  }
+
+  // Once running, from one task only. The probe's filter starts afresh with
+  // the next reading. False if the last two updates have not been taken yet.
+  bool updateCalibration(size_t probe, const ProbeCalibration& calibration) {
+    CalibrationUpdate update;
+    update.probe = probe;
+    update.table.compile(calibration);
+    return this->_calibrationUpdates.push(update);
+  }
 
   void setup() override {
-    this->_lastReading = millis();
-    this->_thermocouple.begin();
+    if (!this->_bus.begin(this->_csPins, this->_probeCount)) {
+      this->_log->error(F("Unable to initialize the SPI bus for the MAX31855."));
+    }
     this->_log->notice(F("Thermocouple initialized. Waiting %d milliseconds for stabilization before verifying operation."), this->_startupDelay);
-    this->_lastReading = millis() + this->_startupDelay;
+    xTaskCreatePinnedToCore(
+      StatefulThermocouple::samplingTask,
+      "thermocouple",
+      StatefulThermocouple::SAMPLING_TASK_STACK,
+      this,
+      StatefulThermocouple::SAMPLING_TASK_PRIORITY,
+      &this->_samplingTask,
+      StatefulThermocouple::SAMPLING_TASK_CORE
+    );
+  }
+
+  StatefulThermocouple &onSample(const std::function<void(const ThermocoupleSample&)> &listener) {
+    this->_sampleListeners.push_back(listener);
+    return *this;
+  }
+
+  // Runs on the sampling task each time a sample is queued for process().
+  StatefulThermocouple &onSampleQueued(const std::function<void()> &callback) {
+    this->_sampleQueued = callback;
+    return *this;
+  }
+
+  unsigned long getReadInterval() const {
+    return this->_readInterval;
+  }
+
+  unsigned long getOversampling() const {
+    return this->_oversampling;
+  }
+
+  size_t getProbeCount() const {
+    return this->_probeCount;
+  }
+
+  ThermocoupleProbe& getProbe(size_t probe) {
+    return this->_probes[probe];
+  }
+
+  const ThermocoupleProbe& getProbe(size_t probe) const {
+    return this->_probes[probe];
   }
 
   void process() override {
-    auto now = millis();
-    if (millis() - this->_lastReading > this->_readInterval) {
-      this->_lastReading = now;
-      if (this->readThermocouple(this->_currentColdJunction, this->_currentHotJunction)) {
-        if (this->_state != StatefulThermocoupleStates::State::READY) {
-          this->setState(StatefulThermocoupleStates::State::READY);
-        }
-      } else {
-        if (this->_state != StatefulThermocoupleStates::State::ERROR) {
-          this->setState(StatefulThermocoupleStates::State::ERROR);
-        }
+    ThermocoupleSample sample;
+    while (this->_samples.pop(sample)) {
+      for (auto &listener : this->_sampleListeners) {
+        listener(sample);
+      }
+      for (size_t i = 0; i < sample.probes; i++) {
+        this->_probes[i].update(sample.frames[i]);
       }
+      this->changeState(this->_probes[0].getState());
     }
   }
 
-  bool readThermocouple(double & coldJunction, double & hotJunction) {
-    coldJunction = this->_thermocouple.readInternal();
-    if (isnan(coldJunction)) {
-      this->_log->error(F("Unable to read cold junction temperature. Is the MAX31855 connected correctly?"));
-      this->setState(StatefulThermocoupleStates::State::ERROR);
-      return false;
+  // Only queued samples make work; onSampleQueued() says when one arrives.
+  unsigned long getNextDeadline() override {
+    return this->_samples.empty() ? Process::IDLE : millis();
+  }
+
+  // Newest sample taken, from any task. False until the first one.
+  bool getSnapshot(ThermocoupleSample& sample) const {
+    return this->_snapshot.read(sample);
+  }
+
+  // Faults of a probe's newest sample, from any task.
+  uint8_t getFaults(size_t probe = 0) const {
+    ThermocoupleSample sample;
+    if (!this->getSnapshot(sample) || probe >= sample.probes) {
+      return MAX31855Faults::Fault::NONE;
     }
-    hotJunction = this->_thermocouple.readCelsius();
-    if (isnan(hotJunction)) {
-      this->_log->error(F("Unable to read hot junction temperature. Did you plug the thermocouple in correctly?"));
-      this->setState(StatefulThermocoupleStates::State::ERROR);
+    return sample.frames[probe].faults();
+  }
+
+  // Newest temperatures of a probe, filtered, from any task. False if not
+  // sampled yet or the newest sample is a fault.
+  bool getTemperatures(Celsius & coldJunction, Celsius & hotJunction, size_t probe = 0) const {
+    ThermocoupleSample sample;
+    if (!this->getSnapshot(sample) || probe >= sample.probes || sample.frames[probe].faults()) {
       return false;
     }
+    coldJunction = sample.frames[probe].coldJunction();
+    hotJunction = sample.hotJunctions[probe];
     return true;
   }
 
-  void getTemperatures(double & coldJunction, double & hotJunction) const {
-    coldJunction = this->_currentColdJunction;
-    hotJunction = this->_currentHotJunction;
+  // Per filter stage of the pit probe's chain, from any task. Every probe's
+  // chain runs the same stages.
+  size_t getFilterStats(FilterStageStats* stats, size_t size) const {
+    return this->_filters[0].getStats(stats, size);
+  }
+
+  TaskHandle_t getSamplingTask() const {
+    return this->_samplingTask;
+  }
+
+  // Time the sampling task has spent running since boot.
+  uint64_t getSamplingBusyMicros() const {
+    return this->_busyUs;
+  }
+
+  // One sweep of the bus, every probe.
+  const Histogram& getSpiLatency() const {
+    return this->_spiLatency;
+  }
+
+  SamplingStats getSamplingStats() const {
+    SamplingStats stats;
+    stats.samples = this->_sampleCount;
+    stats.reads = this->_reads;
+    stats.missedDeadlines = this->_missedDeadlines;
+    stats.droppedSamples = this->_droppedSamples;
+    stats.lastJitterUs = this->_lastJitterUs;
+    stats.maxJitterUs = this->_maxJitterUs;
+    stats.meanJitterUs = stats.samples ? this->_totalJitterUs / stats.samples : 0;
+    return stats;
+  }
+
+ protected:
+  // Reads are spread evenly over each interval; the last of each group is
+  // taken at the sample's deadline.
+  static void samplingTask(void* parameters) {
+    auto self = static_cast<StatefulThermocouple*>(parameters);
+    vTaskDelay(pdMS_TO_TICKS(self->_startupDelay));
+    int64_t period = (int64_t) self->_readInterval * 1000 / self->_oversampling;
+    const int64_t tick = 1000 * portTICK_PERIOD_MS;
+    int64_t deadline = esp_timer_get_time();
+    unsigned long phase = 0;
+    for (;;) {
+      bool due = ++phase == self->_oversampling;
+      if (due) {
+        phase = 0;
+      }
+      self->read(deadline, due);
+      // Between samples the next is one interval away whatever the period.
+      if (due && self->takeSamplingUpdates()) {
+        period = (int64_t) self->_readInterval * 1000 / self->_oversampling;
+      }
+      deadline += period;
+      int64_t now = esp_timer_get_time();
+      // Fell behind by a whole period or more: skip ahead rather than burst.
+      while (deadline <= now) {
+        deadline += period;
+        if (++phase == self->_oversampling) {
+          phase = 0;
+          self->_sequence++;
+          self->_missedDeadlines++;
+        }
+      }
+      vTaskDelay((TickType_t) ((deadline - now + tick - 1) / tick));
+    }
+  }
+
+  unsigned long limitOversampling(unsigned long oversampling) const {
+    unsigned long maxOversampling = std::max(1UL, this->_readInterval / MAX31855Bus::CONVERSION_MS);
+    return oversampling ? std::min(oversampling, maxOversampling) : maxOversampling;
+  }
+
+  bool takeSamplingUpdates() {
+    SamplingUpdate update;
+    bool taken = false;
+    while (this->_samplingUpdates.pop(update)) {
+      this->_oversampling = update.oversampling;
+      for (auto& filter : this->_filters) {
+        filter.configure(update.filter);
+      }
+      taken = true;
+    }
+    return taken;
+  }
+
+  // One sweep of every probe.
+  void read(int64_t deadline, bool due) {
+    auto start = esp_timer_get_time();
+    CalibrationUpdate update;
+    while (this->_calibrationUpdates.pop(update)) {
+      this->_calibrations[update.probe] = update.table;
+      this->_filters[update.probe].reset();
+    }
+    MAX31855Frame frames[ThermocoupleSample::MAX_PROBES];
+    // Probes that could not be read have empty frames, which fault.
+    {
+      Histogram::Timer timer(this->_spiLatency);
+      this->_bus.readFrames(frames);
+    }
+    this->_reads++;
+    for (size_t i = 0; i < this->_probeCount; i++) {
+      if (frames[i].faults()) {
+        this->_filters[i].reset();
+      } else {
+        auto hotJunction = this->_calibrations[i].apply(frames[i].hotJunction().scaled(), frames[i].coldJunction().scaled());
+        this->_filtered[i] = this->_filters[i].update(hotJunction);
+      }
+    }
+    if (due) {
+      this->sample(deadline, start, frames);
+    }
+    this->_busyUs += esp_timer_get_time() - start;
+  }
+
+  void sample(int64_t deadline, int64_t timestamp, const MAX31855Frame* frames) {
+    ThermocoupleSample sample;
+    sample.timestamp = timestamp;
+    sample.sequence = this->_sequence++;
+    sample.probes = this->_probeCount;
+    for (size_t i = 0; i < this->_probeCount; i++) {
+      sample.frames[i] = frames[i];
+      sample.hotJunctions[i] = Celsius::fromScaled(this->_filtered[i]);
+    }
+    this->_snapshot.publish(sample);
+    int32_t jitter = (int32_t) (sample.timestamp - deadline);
+    uint32_t magnitude = jitter < 0 ? -jitter : jitter;
+    this->_lastJitterUs = jitter;
+    this->_totalJitterUs += magnitude;
+    if (magnitude > this->_maxJitterUs) {
+      this->_maxJitterUs = magnitude;
+    }
+    this->_sampleCount++;
+    if (!this->_samples.push(sample)) {
+      this->_droppedSamples++;
+    } else if (this->_sampleQueued) {
+      this->_sampleQueued();
+    }
   }
 
 };
 
-}
\ No newline at end of file
+}
@@ -3,8 +3,12 @@
 #include "Stateful.h"
 #include "Process.h"
 #include "Logger.h"
+#include "LinkMonitor.h"
+#include "LoopScheduler.h"
+#include "WiFiLease.h"
 #include <WiFi.h>
 #include <WiFiManager.h>
+#include <atomic>
 
 namespace PitBoss {
 
@@ -16,11 +20,49 @@ enum State {
   PROVISIONING,
   CONNECTED,
 };
+static const size_t COUNT = CONNECTED + 1;
 
 }
 
+namespace WiFiConnectMethods {
+
+enum Method {
+  // To the leased BSSID and channel, with the leased IP.
+  DIRECT,
+  // Scanning for the SSID, then DHCP; WiFiManager's connects count here.
+  SCAN,
+};
+static const size_t COUNT = SCAN + 1;
+static const char* const NAMES[COUNT] = {"direct", "scan"};
+
+}
+
+struct WiFiConnectStats {
+  uint32_t connects[WiFiConnectMethods::COUNT];
+  // Direct connects that timed out, falling back to a scan.
+  uint32_t fallbacks;
+  // From boot or a drop until connected, in milliseconds.
+  uint32_t lastConnectMs;
+  uint32_t maxConnectMs;
+  uint32_t totalConnectMs;
+};
+
+/**
+ * Connects to the network WiFiManager saved. The first attempt after boot or
+ * a drop goes straight to the access point of the last connection, with its
+ * IP (see WiFiLease), which skips the scan and DHCP; if that has not
+ * connected within FAST_CONNECT_TIMEOUT_MS it falls back to WiFiManager at
+ * boot, or to a scan after a drop. Failed attempts are retried with
+ * exponential backoff. The SDK's own auto reconnect is off, since it neither
+ * backs off nor uses the lease.
+ *
+ * While connected, the RSSI is sampled into a LinkMonitor, whose changes go
+ * to the onLinkChange() listener. A link that has degraded is dropped for a
+ * scan, at most every PROACTIVE_RECONNECT_MIN_MS, so the station can move to
+ * a stronger access point before this one stops answering.
+ */
 class StatefulWiFi :
-  public Stateful<StatefulWiFiStates::State>,
+  public Stateful<StatefulWiFiStates::State, StatefulWiFiStates::COUNT>,
   public Process,
   public Logger
 {
@@ -30,9 +72,51 @@ class StatefulWiFi :
   const char * _ssidPrefix;
   WiFiManager _wifiManager;
   bool _wifiConnected = false;
+  // Read from WiFiManager, which builds a String each time, only at boot and
+  // on connect.
+  char _ssid[33] = {};
+  char _password[65] = {};
+  unsigned long _lastProcess = 0;
+  WiFiLease _lease;
+  bool _leased = false;
+  bool _managerStarted = false;
+  // Since boot or the last drop.
+  unsigned long _disconnectedAt = 0;
+  uint32_t _attempts = 0;
+  // Of _attempts, how many may use the lease.
+  uint32_t _directAttempts = 0;
+  bool _attempting = false;
+  WiFiConnectMethods::Method _attemptMethod = WiFiConnectMethods::Method::SCAN;
+  unsigned long _attemptStartedAt = 0;
+  unsigned long _retryAt = 0;
+  unsigned long _retryDelay = StatefulWiFi::RECONNECT_MIN_MS;
+  std::atomic<uint32_t> _connects[WiFiConnectMethods::COUNT] = {};
+  std::atomic<uint32_t> _fallbacks{0};
+  std::atomic<uint32_t> _lastConnectMs{0};
+  std::atomic<uint32_t> _maxConnectMs{0};
+  std::atomic<uint32_t> _totalConnectMs{0};
+  LinkMonitor _link;
+  unsigned long _lastLinkSample = 0;
+  unsigned long _lastProactiveReconnect = 0;
+  bool _proactivelyReconnected = false;
+  std::atomic<uint32_t> _proactiveReconnects{0};
+  Callback<void(const LinkEvent&)> _onLinkChange;
+  // WiFiManager's portal serves DNS and HTTP from process(), so it is polled
+  // briskly; otherwise connection changes also arrive as WiFi events.
+  static const unsigned long POLL_INTERVAL = 1000;
+  static const unsigned long PORTAL_POLL_INTERVAL = 10;
+  // A direct connect takes a few hundred milliseconds when the lease is good.
+  static const unsigned long FAST_CONNECT_TIMEOUT_MS = 2000;
+  static const unsigned long CONNECT_TIMEOUT_MS = 10 * 1000;
+  static const unsigned long RECONNECT_MIN_MS = 2000;
+  static const unsigned long RECONNECT_MAX_MS = 60 * 1000;
+  // After a drop the access point is most likely rebooting, and comes back
+  // with the same BSSID; at boot nothing says it will come back.
+  static const uint32_t DIRECT_RECONNECT_ATTEMPTS = 3;
+  static const unsigned long PROACTIVE_RECONNECT_MIN_MS = 5 * 60 * 1000;
  public:
 
-  StatefulWiFi(Logging* log, bool debug, wifi_country_t wifiCountry, const char * ssidPrefix) :
+  StatefulWiFi(AsyncLog* log, bool debug, wifi_country_t wifiCountry, const char * ssidPrefix) :
     Logger(log),
     _debug(debug),
     _wifiCountry(wifiCountry),
@@ -40,49 +124,241 @@ class StatefulWiFi :
     _wifiManager()
   {}
 
+  // Before setup().
+  void configureCountry(const wifi_country_t& wifiCountry) {
+    this->_wifiCountry = wifiCountry;
+  }
+
   virtual void setup() {
+    // Direct connects pin the BSSID and channel; keep them out of the
+    // station config WiFiManager saved.
+    WiFi.persistent(false);
     if (!WiFiClass::mode(WIFI_MODE_STA)) {
       this->_log->fatal(F("Unable to initialize WiFi."));
       this->setState(StatefulWiFiStates::State::ERROR);
     }
+    WiFi.setAutoReconnect(false);
+    // Scans only follow a failed direct connect or a degraded link, so they
+    // can afford every channel to find the strongest access point.
+    WiFi.setScanMethod(WIFI_ALL_CHANNEL_SCAN);
+    WiFi.setSortMethod(WIFI_CONNECT_AP_BY_SIGNAL);
+    this->_wifiManager.setWiFiAutoReconnect(false);
     this->_wifiManager.setDebugOutput(this->_debug);
     this->_wifiManager.setCountry(this->_wifiCountry.cc);
     this->_wifiManager.setConfigPortalBlocking(false);
-    if (this->_wifiManager.getWiFiIsSaved()) {
-      this->setState(StatefulWiFiStates::State::DISCONNECTED);
-    } else {
+    this->_disconnectedAt = millis();
+    if (!this->_wifiManager.getWiFiIsSaved()) {
       this->setState(StatefulWiFiStates::State::PROVISIONING);
+      this->startManager();
+      return;
     }
-    this->_wifiManager.autoConnect((String(F("pitboss-")) + String(WIFI_getChipId(), HEX)).c_str());
+    this->setState(StatefulWiFiStates::State::DISCONNECTED);
+    this->readCredentials();
+    this->_leased = WiFiLease::load(this->_lease);
+    this->_directAttempts = 1;
+    this->connect();
   }
 
   virtual void process() {
+    auto now = millis();
+    this->_lastProcess = now;
     this->_wifiManager.process();
     if (WiFi.isConnected()) {
       if (!this->_wifiConnected) {
-        this->_wifiConnected = true;
-        this->setState(StatefulWiFiStates::State::CONNECTED);
+        this->connected(now);
+      } else if (now - this->_lastLinkSample >= LinkMonitor::SAMPLE_INTERVAL_MS) {
+        this->sampleLink(now);
       }
-    } else {
-      if (this->_wifiConnected) {
-        this->_wifiConnected = false;
-        this->setState(StatefulWiFiStates::State::DISCONNECTED);
+      if (this->_link.degraded() && (!this->_proactivelyReconnected
+          || now - this->_lastProactiveReconnect >= StatefulWiFi::PROACTIVE_RECONNECT_MIN_MS)) {
+        this->_proactiveReconnects++;
+        this->_proactivelyReconnected = true;
+        this->_lastProactiveReconnect = now;
+        this->_log->warning(F("WiFi link degraded (%d dBm); reconnecting."), this->_link.getLink().rssi);
+        WiFi.disconnect();
+        // The lease is for the access point that faded.
+        this->dropped(now, 0);
+      }
+      return;
+    }
+    if (this->_wifiConnected) {
+      this->dropped(now, StatefulWiFi::DIRECT_RECONNECT_ATTEMPTS);
+      return;
+    }
+    if (this->_state == StatefulWiFiStates::State::PROVISIONING) {
+      return;
+    }
+    if (this->_attempting) {
+      if (now - this->_attemptStartedAt >= this->getAttemptTimeout()) {
+        this->_attempting = false;
+        if (this->_attemptMethod == WiFiConnectMethods::Method::DIRECT && this->_attempts >= this->_directAttempts) {
+          // Straight on to a scan; the lease was only ever a shortcut.
+          this->_fallbacks++;
+          this->_log->warning(F("Direct WiFi connect timed out; scanning."));
+          this->_retryAt = now;
+        } else {
+          this->_retryAt = now + this->_retryDelay;
+          this->_retryDelay = std::min(this->_retryDelay * 2, StatefulWiFi::RECONNECT_MAX_MS);
+        }
       }
+    } else if ((long) (now - this->_retryAt) >= 0) {
+      this->connect();
+    }
+  }
+
+  unsigned long getNextDeadline() override {
+    if (this->_state == StatefulWiFiStates::State::PROVISIONING) {
+      return this->_lastProcess + StatefulWiFi::PORTAL_POLL_INTERVAL;
     }
+    auto deadline = this->_lastProcess + StatefulWiFi::POLL_INTERVAL;
+    if (this->_wifiConnected) {
+      return LoopScheduler::earliest(deadline, this->_lastLinkSample + LinkMonitor::SAMPLE_INTERVAL_MS, this->_lastProcess);
+    }
+    auto attemptDeadline = this->_attempting ? this->_attemptStartedAt + this->getAttemptTimeout() : this->_retryAt;
+    return LoopScheduler::earliest(deadline, attemptDeadline, this->_lastProcess);
+  }
+
+  // Listens on the task that runs process().
+  void onLinkChange(const Callback<void(const LinkEvent&)>& listener) {
+    this->_onLinkChange = listener;
   }
 
-  int getSignalStrength() {
-    return this->_wifiManager.getRSSIasQuality(WiFi.RSSI());
+  // Of the smoothed RSSI, as of the last sample.
+  int getSignalStrength() const {
+    return this->_link.getLink().quality;
   }
 
-  String getSSID() {
-    return this->_wifiManager.getWiFiSSID();
+  LinkStats getLinkStats() const {
+    return this->_link.getStats();
+  }
+
+  // Links dropped for having degraded.
+  uint32_t getProactiveReconnects() const {
+    return this->_proactiveReconnects;
+  }
+
+  // The network last connected to.
+  const char* getSSID() const {
+    return this->_ssid;
+  }
+
+  // Connections after the first since boot.
+  uint32_t getReconnects() const {
+    uint32_t connects = 0;
+    for (const auto& count : this->_connects) {
+      connects += count;
+    }
+    return connects ? connects - 1 : 0;
+  }
+
+  WiFiConnectStats getConnectStats() const {
+    WiFiConnectStats stats;
+    for (size_t i = 0; i < WiFiConnectMethods::COUNT; i++) {
+      stats.connects[i] = this->_connects[i];
+    }
+    stats.fallbacks = this->_fallbacks;
+    stats.lastConnectMs = this->_lastConnectMs;
+    stats.maxConnectMs = this->_maxConnectMs;
+    stats.totalConnectMs = this->_totalConnectMs;
+    return stats;
   }
 
   void forgetSSID() {
+    WiFiLease::clear();
+    this->_leased = false;
     this->_wifiManager.resetSettings();
   }
 
+ protected:
+  void sampleLink(unsigned long now) {
+    this->_lastLinkSample = now;
+    if (this->_link.sample(WiFi.RSSI()) && this->_onLinkChange) {
+      this->_onLinkChange(this->_link.getLink());
+    }
+  }
+
+  void dropped(unsigned long now, uint32_t directAttempts) {
+    this->_wifiConnected = false;
+    this->_disconnectedAt = now;
+    this->_attempts = 0;
+    this->_directAttempts = directAttempts;
+    this->_retryDelay = StatefulWiFi::RECONNECT_MIN_MS;
+    if (this->_link.reset() && this->_onLinkChange) {
+      this->_onLinkChange(this->_link.getLink());
+    }
+    this->setState(StatefulWiFiStates::State::DISCONNECTED);
+    this->connect();
+  }
+
+  unsigned long getAttemptTimeout() const {
+    return this->_attemptMethod == WiFiConnectMethods::Method::DIRECT
+      ? StatefulWiFi::FAST_CONNECT_TIMEOUT_MS
+      : StatefulWiFi::CONNECT_TIMEOUT_MS;
+  }
+
+  void readCredentials() {
+    snprintf(this->_ssid, sizeof(this->_ssid), "%s", this->_wifiManager.getWiFiSSID().c_str());
+    snprintf(this->_password, sizeof(this->_password), "%s", this->_wifiManager.getWiFiPass().c_str());
+  }
+
+  // Directly for the first _directAttempts, given a lease; then WiFiManager
+  // if it has not run, else by scanning.
+  void connect() {
+    this->_attempting = true;
+    this->_attemptStartedAt = millis();
+    if (this->_leased && this->_attempts++ < this->_directAttempts) {
+      this->_attemptMethod = WiFiConnectMethods::Method::DIRECT;
+      WiFi.config(IPAddress(this->_lease.ip), IPAddress(this->_lease.gateway), IPAddress(this->_lease.subnet), IPAddress(this->_lease.dns));
+      WiFi.begin(this->_ssid, this->_password, this->_lease.channel, this->_lease.bssid);
+      return;
+    }
+    this->_attemptMethod = WiFiConnectMethods::Method::SCAN;
+    if (!this->_managerStarted) {
+      this->startManager();
+      return;
+    }
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    WiFi.begin(this->_ssid, this->_password);
+  }
+
+  void startManager() {
+    this->_managerStarted = true;
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+    if (this->_wifiManager.getWiFiIsSaved()) {
+      // Replaces any BSSID and channel a direct connect left pinned, which
+      // WiFiManager's connect would otherwise reuse.
+      WiFi.begin(this->_ssid, this->_password);
+    }
+    this->_wifiManager.autoConnect((String(F("pitboss-")) + String(WIFI_getChipId(), HEX)).c_str());
+  }
+
+  void connected(unsigned long now) {
+    this->_wifiConnected = true;
+    this->_attempting = false;
+    this->_attempts = 0;
+    this->_retryDelay = StatefulWiFi::RECONNECT_MIN_MS;
+    uint32_t connectMs = now - this->_disconnectedAt;
+    this->_connects[this->_attemptMethod]++;
+    this->_lastConnectMs = connectMs;
+    this->_maxConnectMs = std::max((uint32_t) this->_maxConnectMs, connectMs);
+    this->_totalConnectMs += connectMs;
+    this->_log->notice(F("WiFi connected (%s) in %u ms."), WiFiConnectMethods::NAMES[this->_attemptMethod], connectMs);
+    this->readCredentials();
+    auto bssid = WiFi.BSSID();
+    if (bssid) {
+      memcpy(this->_lease.bssid, bssid, sizeof(this->_lease.bssid));
+      this->_lease.channel = WiFi.channel();
+      this->_lease.ip = WiFi.localIP();
+      this->_lease.gateway = WiFi.gatewayIP();
+      this->_lease.subnet = WiFi.subnetMask();
+      this->_lease.dns = WiFi.dnsIP();
+      WiFiLease::save(this->_lease);
+      this->_leased = true;
+    }
+    this->sampleLink(now);
+    this->setState(StatefulWiFiStates::State::CONNECTED);
+  }
+
 };
 
-}
\ No newline at end of file
+}
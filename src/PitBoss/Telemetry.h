@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <PitBoss/StatefulThermocouple.h>
+
+namespace PitBoss {
+
+/**
+ * Wire format, version 2. All fields little-endian; temperatures are the raw
+ * MAX31855 readings (hot 0.25 C/LSB, cold 0.0625 C/LSB) and are meaningless
+ * when faults is non-zero. Each sample is followed by one reading per probe,
+ * the pit probe's first.
+ */
+struct __attribute__((packed)) TelemetryHeader {
+  uint8_t magic[2];
+  uint8_t version;
+  uint8_t count;
+  uint8_t probes;
+  uint8_t reserved[3];
+  uint32_t deviceId;
+  // Incremented per datagram, so collectors can count losses.
+  uint32_t sequence;
+};
+
+struct __attribute__((packed)) TelemetrySample {
+  // Sampling deadline index; gaps are missed deadlines.
+  uint32_t sequence;
+  // Milliseconds since boot.
+  uint32_t timestampMs;
+};
+
+struct __attribute__((packed)) TelemetryReading {
+  int16_t hotJunction;
+  int16_t coldJunction;
+  uint8_t faults;
+  uint8_t reserved;
+};
+
+struct TelemetryStats {
+  uint32_t datagrams;
+  uint32_t samples;
+  uint32_t sendFailures;
+};
+
+/**
+ * Broadcasts samples as binary datagrams: a header followed by count samples.
+ * One sample is taken every interval milliseconds (0 takes every sample) and
+ * a datagram goes out once batch samples are queued.
+ */
+class Telemetry {
+ public:
+  static const uint8_t VERSION = 2;
+  static const uint8_t MAX_BATCH = 32;
+  static const size_t MAX_SAMPLE_SIZE = sizeof(TelemetrySample) + ThermocoupleSample::MAX_PROBES * sizeof(TelemetryReading);
+
+ protected:
+  AsyncUDP* _udp;
+  uint16_t _port = 0;
+  uint32_t _intervalMs = 0;
+  uint8_t _batch = 1;
+  bool _enabled = false;
+  // As last set, for configure() to apply again.
+  bool _connected = false;
+  int64_t _lastTaken = 0;
+  bool _taken = false;
+  size_t _sampleSize = sizeof(TelemetrySample) + sizeof(TelemetryReading);
+  uint8_t _datagram[sizeof(TelemetryHeader) + MAX_BATCH * MAX_SAMPLE_SIZE];
+  TelemetryHeader* _header = reinterpret_cast<TelemetryHeader*>(_datagram);
+  TelemetryStats _stats = {};
+
+ public:
+  explicit Telemetry(AsyncUDP* udp) :
+    _udp(udp)
+  {}
+
+  // A port of 0 turns telemetry off. May be called again while running, from
+  // the task that appends; a partial batch is discarded.
+  void configure(uint32_t deviceId, uint16_t port, uint32_t intervalMs, uint8_t batch, uint8_t probes) {
+    this->_port = port;
+    this->_intervalMs = intervalMs;
+    this->_batch = std::max<uint8_t>(1, std::min(batch, Telemetry::MAX_BATCH));
+    probes = std::max<uint8_t>(1, std::min<uint8_t>(probes, ThermocoupleSample::MAX_PROBES));
+    this->_sampleSize = sizeof(TelemetrySample) + probes * sizeof(TelemetryReading);
+    this->_header->magic[0] = 'P';
+    this->_header->magic[1] = 'B';
+    this->_header->version = Telemetry::VERSION;
+    this->_header->count = 0;
+    this->_header->probes = probes;
+    memset(this->_header->reserved, 0, sizeof(this->_header->reserved));
+    this->_header->deviceId = deviceId;
+    this->_header->sequence = 0;
+    this->_enabled = this->_connected && this->_port;
+  }
+
+  // Only send while connected; samples taken meanwhile are discarded.
+  void setEnabled(bool enabled) {
+    this->_connected = enabled;
+    this->_enabled = enabled && this->_port;
+    this->_header->count = 0;
+  }
+
+  void append(const ThermocoupleSample& sample) {
+    if (!this->_enabled) {
+      return;
+    }
+    if (this->_taken && sample.timestamp - this->_lastTaken < (int64_t) this->_intervalMs * 1000) {
+      return;
+    }
+    this->_taken = true;
+    this->_lastTaken = sample.timestamp;
+    auto out = this->_datagram + sizeof(TelemetryHeader) + this->_header->count++ * this->_sampleSize;
+    TelemetrySample header;
+    header.sequence = sample.sequence;
+    header.timestampMs = (uint32_t) (sample.timestamp / 1000);
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (size_t i = 0; i < this->_header->probes; i++) {
+      // Probes the sample lacks read as empty frames, so NO_RESPONSE.
+      MAX31855Frame frame;
+      if (i < sample.probes) {
+        frame = sample.frames[i];
+      }
+      TelemetryReading reading;
+      reading.faults = frame.faults();
+      reading.hotJunction = reading.faults ? 0 : frame.hotJunctionRaw();
+      reading.coldJunction = reading.faults ? 0 : frame.coldJunctionRaw();
+      reading.reserved = 0;
+      memcpy(out, &reading, sizeof(reading));
+      out += sizeof(reading);
+    }
+    this->_stats.samples++;
+    if (this->_header->count >= this->_batch) {
+      this->send();
+    }
+  }
+
+  // Sends a partial batch now rather than waiting for it to fill.
+  void flush() {
+    if (this->_enabled && this->_header->count) {
+      this->send();
+    }
+  }
+
+  TelemetryStats getStats() const {
+    return this->_stats;
+  }
+
+ protected:
+  void send() {
+    auto length = sizeof(TelemetryHeader) + this->_header->count * this->_sampleSize;
+    if (this->_udp->broadcastTo(this->_datagram, length, this->_port) == length) {
+      this->_stats.datagrams++;
+    } else {
+      this->_stats.sendFailures++;
+    }
+    this->_header->sequence++;
+    this->_header->count = 0;
+  }
+};
+
+}
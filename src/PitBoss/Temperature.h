@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace PitBoss {
+
+namespace TemperatureUnits {
+
+struct Celsius {
+  static const char SYMBOL = 'C';
+};
+
+struct Fahrenheit {
+  static const char SYMBOL = 'F';
+};
+
+struct Kelvin {
+  static const char SYMBOL = 'K';
+};
+
+}
+
+namespace detail {
+
+// n / d rounded half away from zero, d > 0.
+constexpr int32_t divideRounded(int32_t n, int32_t d) {
+  return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d);
+}
+
+template<typename T_from, typename T_to>
+struct TemperatureConversion;
+
+template<typename T_unit>
+struct TemperatureConversion<T_unit, T_unit> {
+  static constexpr int32_t convert(int32_t value) {
+    return value;
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Celsius, TemperatureUnits::Fahrenheit> {
+  static constexpr int32_t convert(int32_t value) {
+    return value / 5 * 9 + detail::divideRounded(value % 5 * 9, 5) + 320000;
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Fahrenheit, TemperatureUnits::Celsius> {
+  static constexpr int32_t convert(int32_t value) {
+    return detail::divideRounded((value - 320000) * 5, 9);
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Celsius, TemperatureUnits::Kelvin> {
+  static constexpr int32_t convert(int32_t value) {
+    return value + 2731500;
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Kelvin, TemperatureUnits::Celsius> {
+  static constexpr int32_t convert(int32_t value) {
+    return value - 2731500;
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Fahrenheit, TemperatureUnits::Kelvin> {
+  static constexpr int32_t convert(int32_t value) {
+    return TemperatureConversion<TemperatureUnits::Celsius, TemperatureUnits::Kelvin>::convert(
+      TemperatureConversion<TemperatureUnits::Fahrenheit, TemperatureUnits::Celsius>::convert(value));
+  }
+};
+
+template<>
+struct TemperatureConversion<TemperatureUnits::Kelvin, TemperatureUnits::Fahrenheit> {
+  static constexpr int32_t convert(int32_t value) {
+    return TemperatureConversion<TemperatureUnits::Celsius, TemperatureUnits::Fahrenheit>::convert(
+      TemperatureConversion<TemperatureUnits::Kelvin, TemperatureUnits::Celsius>::convert(value));
+  }
+};
+
+}
+
+/**
+ * A temperature in T_unit, held as an integer count of 1/10000 degree. The
+ * ESP32's FPU is single precision only, so this keeps the pipeline off soft
+ * doubles. It is also exact for everything the MAX31855 reports: 0.25 C and
+ * 0.0625 C steps stay whole numbers in Celsius and Fahrenheit, so readings
+ * are only rounded when formatted. Covers +/-214000 degrees.
+ */
+template<typename T_unit>
+class Temperature {
+ public:
+  static const int32_t SCALE = 10000;
+
+ protected:
+  int32_t _value;
+
+  explicit constexpr Temperature(int32_t value) :
+    _value(value)
+  {}
+
+ public:
+  constexpr Temperature() :
+    _value(0)
+  {}
+
+  static constexpr Temperature fromScaled(int32_t value) {
+    return Temperature(value);
+  }
+  static constexpr Temperature fromDegrees(int32_t degrees) {
+    return Temperature(degrees * SCALE);
+  }
+  static constexpr Temperature fromCentiDegrees(int32_t centiDegrees) {
+    return Temperature(centiDegrees * (SCALE / 100));
+  }
+
+  constexpr int32_t scaled() const {
+    return this->_value;
+  }
+  constexpr int32_t centiDegrees() const {
+    return detail::divideRounded(this->_value, SCALE / 100);
+  }
+  constexpr int32_t degrees() const {
+    return detail::divideRounded(this->_value, SCALE);
+  }
+
+  template<typename T_to>
+  constexpr Temperature<T_to> to() const {
+    return Temperature<T_to>::fromScaled(detail::TemperatureConversion<T_unit, T_to>::convert(this->_value));
+  }
+
+  constexpr bool operator==(const Temperature& other) const {
+    return this->_value == other._value;
+  }
+  constexpr bool operator!=(const Temperature& other) const {
+    return this->_value != other._value;
+  }
+  constexpr bool operator<(const Temperature& other) const {
+    return this->_value < other._value;
+  }
+  constexpr bool operator>(const Temperature& other) const {
+    return this->_value > other._value;
+  }
+
+  // Degrees with `decimals` (0 to 4) digits after the point, rounded half
+  // away from zero, without the unit. Returns the length as snprintf would.
+  size_t format(char* buffer, size_t size, unsigned decimals = 2) const {
+    static const int32_t POWERS[] = {1, 10, 100, 1000, 10000};
+    decimals = decimals > 4 ? 4 : decimals;
+    int32_t rounded = detail::divideRounded(this->_value, SCALE / POWERS[decimals]);
+    uint32_t magnitude = rounded < 0 ? -rounded : rounded;
+    const char* sign = rounded < 0 ? "-" : "";
+    int n;
+    if (decimals) {
+      n = snprintf(buffer, size, "%s%lu.%0*lu", sign,
+                   (unsigned long) (magnitude / POWERS[decimals]), (int) decimals,
+                   (unsigned long) (magnitude % POWERS[decimals]));
+    } else {
+      n = snprintf(buffer, size, "%s%lu", sign, (unsigned long) magnitude);
+    }
+    return n < 0 ? 0 : (size_t) n;
+  }
+};
+
+typedef Temperature<TemperatureUnits::Celsius> Celsius;
+typedef Temperature<TemperatureUnits::Fahrenheit> Fahrenheit;
+typedef Temperature<TemperatureUnits::Kelvin> Kelvin;
+
+}
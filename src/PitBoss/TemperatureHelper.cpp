@@ -1,7 +0,0 @@
-namespace PitBoss {
-
-double celsiusToFarenheit(double celsius) {
-  return (celsius * 9.0) / 5.0 + 32;
-}
-
-}
\ No newline at end of file
@@ -1,7 +0,0 @@
-#pragma once
-
-namespace PitBoss {
-
-double celsiusToFarenheit(double celsius);
-
-}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <PitBoss/MAX31855.h>
+#include <PitBoss/StatefulThermocouple.h>
+
+namespace PitBoss {
+
+/**
+ * Fixed-size ring of thermocouple samples, allocated once in begin().
+ *
+ * Each record is 4 bytes: the raw hot and cold junction values exactly as
+ * they came off the MAX31855 (0.25 C and 0.0625 C per LSB). Records are
+ * indexed by sample sequence, so a sample's time is implied by its slot
+ * (origin + sequence * interval) and never stored. A fault or a missed
+ * deadline is stored as hot == FAULT_MARKER with the fault bits (or zero for
+ * a missing sample) in the cold field.
+ *
+ * The loop task appends; web handlers read concurrently. The writer announces
+ * a slot in _reserved before overwriting it and readers re-check the window
+ * against it after copying, so a record overwritten mid-read is discarded.
+ */
+class TemperatureHistory {
+ public:
+  static const uint32_t SPAN_MS = 12UL * 60 * 60 * 1000;
+  static const uint32_t MAX_RECORDS = 24 * 1024;
+  static const int16_t FAULT_MARKER = INT16_MIN;
+
+  struct Record {
+    int16_t hotJunction;
+    uint16_t coldJunction;
+
+    bool valid() const {
+      return this->hotJunction != TemperatureHistory::FAULT_MARKER;
+    }
+    uint8_t faults() const {
+      return this->valid() ? MAX31855Faults::Fault::NONE : (uint8_t) this->coldJunction;
+    }
+    int16_t coldJunctionRaw() const {
+      return (int16_t) this->coldJunction;
+    }
+  };
+
+ protected:
+  std::atomic<uint32_t>* _records = nullptr;
+  uint32_t _capacity = 0;
+  uint32_t _intervalMs = 0;
+  uint32_t _first = 0;
+  std::atomic<uint32_t> _next{0};
+  std::atomic<uint32_t> _reserved{0};
+  int64_t _originUs = 0;
+  bool _started = false;
+
+  static uint32_t pack(const Record& record) {
+    return ((uint32_t) (uint16_t) record.hotJunction << 16) | record.coldJunction;
+  }
+  static Record unpack(uint32_t packed) {
+    return Record{(int16_t) (packed >> 16), (uint16_t) (packed & 0xFFFF)};
+  }
+
+ public:
+  bool begin(uint32_t intervalMs) {
+    this->_intervalMs = intervalMs ? intervalMs : 1;
+    this->_capacity = (TemperatureHistory::SPAN_MS + this->_intervalMs - 1) / this->_intervalMs;
+    if (this->_capacity > TemperatureHistory::MAX_RECORDS) {
+      this->_capacity = TemperatureHistory::MAX_RECORDS;
+    }
+    this->_records = new (std::nothrow) std::atomic<uint32_t>[this->_capacity];
+    return this->_records != nullptr;
+  }
+
+  void append(const ThermocoupleSample& sample) {
+    if (!this->_records) {
+      return;
+    }
+    uint32_t next = this->_next.load(std::memory_order_relaxed);
+    if (!this->_started) {
+      this->_started = true;
+      this->_originUs = sample.timestamp - (int64_t) sample.sequence * this->_intervalMs * 1000;
+      this->_first = next = sample.sequence;
+    }
+    if (sample.sequence < next) {
+      return;
+    }
+    // Missed deadlines; never bother filling more than one lap.
+    if (sample.sequence - next > this->_capacity) {
+      next = sample.sequence - this->_capacity;
+    }
+    for (; next < sample.sequence; next++) {
+      this->store(next, Record{TemperatureHistory::FAULT_MARKER, 0});
+    }
+    // The pit probe's.
+    auto& frame = sample.frames[0];
+    auto faults = frame.faults();
+    if (faults) {
+      this->store(next, Record{TemperatureHistory::FAULT_MARKER, faults});
+    } else {
+      this->store(next, Record{frame.hotJunctionRaw(), (uint16_t) frame.coldJunctionRaw()});
+    }
+    this->_next.store(next + 1, std::memory_order_release);
+  }
+
+  uint32_t capacity() const {
+    return this->_capacity;
+  }
+  uint32_t intervalMs() const {
+    return this->_intervalMs;
+  }
+  // Sequence one past the newest record.
+  uint32_t end() const {
+    return this->_next.load(std::memory_order_acquire);
+  }
+  // Sequence of the oldest record still held.
+  uint32_t begin() const {
+    return this->oldest(this->end());
+  }
+
+  // Milliseconds since boot of the deadline the given sequence belongs to.
+  uint32_t timestampMs(uint32_t sequence) const {
+    return (uint32_t) ((this->_originUs + (int64_t) sequence * this->_intervalMs * 1000) / 1000);
+  }
+
+  // First sequence with a timestamp at or after the given time.
+  uint32_t sequenceAt(uint32_t timestampMs) const {
+    int64_t offsetUs = (int64_t) timestampMs * 1000 - this->_originUs;
+    if (offsetUs <= 0) {
+      return 0;
+    }
+    int64_t periodUs = (int64_t) this->_intervalMs * 1000;
+    return (uint32_t) ((offsetUs + periodUs - 1) / periodUs);
+  }
+
+  bool read(uint32_t sequence, Record& record) const {
+    if (!this->_records || sequence >= this->end() || sequence < this->begin()) {
+      return false;
+    }
+    record = TemperatureHistory::unpack(this->_records[sequence % this->_capacity].load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence >= this->oldest(this->_reserved.load(std::memory_order_relaxed));
+  }
+
+ protected:
+  uint32_t oldest(uint32_t end) const {
+    uint32_t held = end - this->_first;
+    return held > this->_capacity ? end - this->_capacity : this->_first;
+  }
+
+  void store(uint32_t sequence, const Record& record) {
+    this->_reserved.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    this->_records[sequence % this->_capacity].store(TemperatureHistory::pack(record), std::memory_order_relaxed);
+  }
+
+};
+
+}
@@ -0,0 +1,316 @@
+#include <SPIFFS.h>
+#include <ctime>
+#include <PitBoss/TemperatureLog.h>
+#include <PitBoss/TimeHelper.h>
+
+namespace PitBoss {
+
+/**
+ * Payload widths for each prefix code. Code n is n one bits followed by a
+ * zero, except the last which has no terminating zero. Payloads are zigzag
+ * encoded deltas, apart from the hot junction's last code which carries the
+ * fault bits of a failed reading in place of both temperatures.
+ */
+static const uint8_t TIMESTAMP_WIDTHS[] = {0, 7, 12, 20, 32};
+static const uint8_t HOT_JUNCTION_WIDTHS[] = {0, 2, 5, 9, 16, 3};
+static const uint8_t COLD_JUNCTION_WIDTHS[] = {0, 2, 5, 9, 16};
+static const uint8_t TIMESTAMP_LEVELS = sizeof(TIMESTAMP_WIDTHS);
+static const uint8_t HOT_JUNCTION_LEVELS = sizeof(HOT_JUNCTION_WIDTHS);
+static const uint8_t HOT_JUNCTION_FAULT_LEVEL = HOT_JUNCTION_LEVELS - 1;
+static const uint8_t COLD_JUNCTION_LEVELS = sizeof(COLD_JUNCTION_WIDTHS);
+
+String TemperatureLog::segmentPath(uint32_t id) {
+  char path[16];
+  snprintf(path, sizeof(path), TemperatureLog::SEGMENT_PATH_FORMAT, (unsigned) (id % TemperatureLog::MAX_SEGMENTS));
+  return String(path);
+}
+
+void TemperatureLog::begin(uint32_t intervalMs) {
+  this->_intervalMs = intervalMs;
+  bool found = false;
+  uint32_t first = 0;
+  uint32_t last = 0;
+  for (uint32_t slot = 0; slot < TemperatureLog::MAX_SEGMENTS; slot++) {
+    auto file = SPIFFS.open(TemperatureLog::segmentPath(slot));
+    SegmentHeader header;
+    if (!file || file.read((uint8_t*) &header, sizeof(header)) != sizeof(header) || header.magic != TemperatureLog::MAGIC) {
+      continue;
+    }
+    if (!found || (int32_t) (header.id - first) < 0) {
+      first = header.id;
+    }
+    if (!found || (int32_t) (header.id - last) > 0) {
+      last = header.id;
+    }
+    found = true;
+  }
+  if (found) {
+    this->_firstSegment.store(first);
+    this->_nextSegment.store(last + 1);
+  }
+}
+
+void TemperatureLog::append(const ThermocoupleSample& sample) {
+  auto uptimeMs = (uint32_t) (sample.timestamp / 1000);
+  time_t now = time(nullptr);
+  int64_t epochOffsetMs = now > MIN_VALID_EPOCH ? (int64_t) now * 1000 - millis() : 0;
+  // Start over once the clock is set so the rest of the cook has wall time.
+  if (this->_segmentOpen && !this->_header.epochOffsetMs && epochOffsetMs) {
+    this->closeSegment();
+  }
+  if (this->_segmentOpen && this->_segmentBytes + (this->_pendingBits + TemperatureLog::MAX_SAMPLE_BITS + 7) / 8 > TemperatureLog::SEGMENT_SIZE) {
+    this->closeSegment();
+  }
+  if (!this->_segmentOpen && !this->openSegment(uptimeMs, epochOffsetMs)) {
+    return;
+  }
+  if (this->_pendingBits + TemperatureLog::MAX_SAMPLE_BITS > TemperatureLog::PENDING_SIZE * 8) {
+    this->writePending(false);
+  }
+
+  auto delta = (int32_t) (uptimeMs - this->_state.timestampMs);
+  this->writeDelta(TIMESTAMP_WIDTHS, TIMESTAMP_LEVELS, TIMESTAMP_LEVELS, delta - this->_state.timestampDeltaMs);
+  this->_state.timestampMs = uptimeMs;
+  this->_state.timestampDeltaMs = delta;
+  // The pit probe's.
+  auto& frame = sample.frames[0];
+  auto faults = frame.faults();
+  if (faults) {
+    this->writeCode(HOT_JUNCTION_WIDTHS, HOT_JUNCTION_LEVELS, HOT_JUNCTION_FAULT_LEVEL, faults);
+  } else {
+    auto hotJunction = frame.hotJunctionRaw();
+    auto coldJunction = frame.coldJunctionRaw();
+    this->writeDelta(HOT_JUNCTION_WIDTHS, HOT_JUNCTION_LEVELS, HOT_JUNCTION_FAULT_LEVEL, hotJunction - this->_state.hotJunction);
+    this->writeDelta(COLD_JUNCTION_WIDTHS, COLD_JUNCTION_LEVELS, COLD_JUNCTION_LEVELS, coldJunction - this->_state.coldJunction);
+    this->_state.hotJunction = hotJunction;
+    this->_state.coldJunction = coldJunction;
+  }
+  this->_stats.samples++;
+
+  if (millis() - this->_lastFlush >= TemperatureLog::FLUSH_INTERVAL_MS) {
+    this->writePending(false);
+  }
+}
+
+void TemperatureLog::flush() {
+  this->closeSegment();
+}
+
+bool TemperatureLog::openSegment(uint32_t startMs, int64_t epochOffsetMs) {
+  uint32_t id = this->_nextSegment.load();
+  if (!this->makeRoom(id)) {
+    return false;
+  }
+  this->_header = SegmentHeader{TemperatureLog::MAGIC, id, epochOffsetMs, startMs, this->_intervalMs};
+  auto file = SPIFFS.open(TemperatureLog::segmentPath(id), FILE_WRITE);
+  if (!file || file.write((const uint8_t*) &this->_header, sizeof(this->_header)) != sizeof(this->_header)) {
+    this->_stats.writeErrors++;
+    return false;
+  }
+  file.close();
+  this->_state = CodecState{startMs, 0, 0, 0};
+  this->_segmentBytes = sizeof(this->_header);
+  this->_pendingBits = 0;
+  this->_lastFlush = millis();
+  this->_segmentOpen = true;
+  this->_nextSegment.store(id + 1, std::memory_order_release);
+  return true;
+}
+
+void TemperatureLog::closeSegment() {
+  if (!this->_segmentOpen) {
+    return;
+  }
+  this->writePending(true);
+  this->_segmentOpen = false;
+}
+
+/**
+ * Frees the slot the new segment will take, then keeps dropping the oldest
+ * segments while the partition is short of space. The first segment is
+ * advanced before its file goes, so scanners skip rather than misread it.
+ */
+bool TemperatureLog::makeRoom(uint32_t id) {
+  while (this->_firstSegment.load() != id) {
+    uint32_t first = this->_firstSegment.load();
+    bool slotTaken = id - first >= TemperatureLog::MAX_SEGMENTS;
+    bool full = SPIFFS.totalBytes() - SPIFFS.usedBytes() < 2 * TemperatureLog::SEGMENT_SIZE;
+    if (!slotTaken && !full) {
+      break;
+    }
+    this->_firstSegment.store(first + 1);
+    SPIFFS.remove(TemperatureLog::segmentPath(first));
+  }
+  return SPIFFS.totalBytes() - SPIFFS.usedBytes() >= TemperatureLog::SEGMENT_SIZE;
+}
+
+void TemperatureLog::writeBits(uint32_t value, uint8_t count) {
+  for (int i = count - 1; i >= 0; i--) {
+    auto byte = this->_pendingBits / 8;
+    auto bit = this->_pendingBits % 8;
+    if (bit == 0) {
+      this->_pending[byte] = 0;
+    }
+    this->_pending[byte] |= ((value >> i) & 1) << (7 - bit);
+    this->_pendingBits++;
+  }
+}
+
+void TemperatureLog::writeCode(const uint8_t* widths, uint8_t levels, uint8_t level, uint32_t value) {
+  this->writeBits((1UL << level) - 1, level);
+  if (level < levels - 1) {
+    this->writeBits(0, 1);
+  }
+  this->writeBits(value, widths[level]);
+}
+
+void TemperatureLog::writeDelta(const uint8_t* widths, uint8_t levels, uint8_t valueLevels, int32_t delta) {
+  auto value = TemperatureLog::zigzag(delta);
+  uint8_t level = 0;
+  while (level < valueLevels - 1 && widths[level] < 32 && value >= (1UL << widths[level])) {
+    level++;
+  }
+  this->writeCode(widths, levels, level, value);
+}
+
+/**
+ * Appends whole bytes to the segment, carrying a trailing partial byte over
+ * unless padding. Padding is with one bits: no timestamp code can complete
+ * within them, so the decoder stops there.
+ */
+void TemperatureLog::writePending(bool pad) {
+  this->_lastFlush = millis();
+  if (!this->_segmentOpen) {
+    return;
+  }
+  if (pad && this->_pendingBits % 8) {
+    this->writeBits(0xFF, 8 - this->_pendingBits % 8);
+  }
+  auto bytes = this->_pendingBits / 8;
+  if (bytes == 0) {
+    return;
+  }
+  auto file = SPIFFS.open(TemperatureLog::segmentPath(this->_header.id), FILE_APPEND);
+  if (!file || file.write(this->_pending, bytes) != bytes) {
+    // Whatever made it to flash still decodes; carry on in a new segment.
+    this->_stats.writeErrors++;
+    this->_segmentOpen = false;
+    this->_pendingBits = 0;
+    return;
+  }
+  file.close();
+  this->_segmentBytes += bytes;
+  this->_stats.bytesWritten += bytes;
+  this->_stats.flushes++;
+  this->_pending[0] = this->_pending[bytes];
+  this->_pendingBits -= bytes * 8;
+}
+
+TemperatureLog::Scanner::Scanner(const TemperatureLog* log, uint64_t fromMs, uint64_t toMs) :
+  _log(log),
+  _fromMs(fromMs),
+  _toMs(toMs),
+  _segment(log->_firstSegment.load())
+{}
+
+bool TemperatureLog::Scanner::next(Entry& entry) {
+  while (this->_open || this->openNext()) {
+    if (!this->decode(entry)) {
+      this->_file.close();
+      this->_open = false;
+      this->_segment++;
+      continue;
+    }
+    if (entry.timestampMs >= this->_fromMs && entry.timestampMs <= this->_toMs) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TemperatureLog::Scanner::openNext() {
+  while (true) {
+    uint32_t first = this->_log->_firstSegment.load();
+    if ((int32_t) (this->_segment - first) < 0) {
+      this->_segment = first;
+    }
+    if ((int32_t) (this->_segment - this->_log->_nextSegment.load(std::memory_order_acquire)) >= 0) {
+      return false;
+    }
+    this->_file = SPIFFS.open(TemperatureLog::segmentPath(this->_segment));
+    if (this->_file
+        && this->_file.read((uint8_t*) &this->_header, sizeof(this->_header)) == sizeof(this->_header)
+        && this->_header.magic == TemperatureLog::MAGIC
+        && this->_header.id == this->_segment) {
+      this->_state = CodecState{this->_header.startMs, 0, 0, 0};
+      this->_length = 0;
+      this->_bit = 0;
+      this->_open = true;
+      return true;
+    }
+    this->_file.close();
+    this->_segment++;
+  }
+}
+
+bool TemperatureLog::Scanner::readBits(uint8_t count, uint32_t& value) {
+  value = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    if (this->_bit == this->_length * 8) {
+      this->_length = this->_file.read(this->_buffer, sizeof(this->_buffer));
+      this->_bit = 0;
+      if (this->_length == 0) {
+        return false;
+      }
+    }
+    value = (value << 1) | ((this->_buffer[this->_bit / 8] >> (7 - this->_bit % 8)) & 1);
+    this->_bit++;
+  }
+  return true;
+}
+
+bool TemperatureLog::Scanner::readCode(const uint8_t* widths, uint8_t levels, uint8_t& level, uint32_t& value) {
+  level = 0;
+  while (level < levels - 1) {
+    uint32_t bit;
+    if (!this->readBits(1, bit)) {
+      return false;
+    }
+    if (!bit) {
+      break;
+    }
+    level++;
+  }
+  return this->readBits(widths[level], value);
+}
+
+bool TemperatureLog::Scanner::decode(Entry& entry) {
+  uint8_t level;
+  uint32_t value;
+  if (!this->readCode(TIMESTAMP_WIDTHS, TIMESTAMP_LEVELS, level, value)) {
+    return false;
+  }
+  int32_t delta = this->_state.timestampDeltaMs + TemperatureLog::unzigzag(value);
+  this->_state.timestampMs += delta;
+  this->_state.timestampDeltaMs = delta;
+  if (!this->readCode(HOT_JUNCTION_WIDTHS, HOT_JUNCTION_LEVELS, level, value)) {
+    return false;
+  }
+  entry.faults = MAX31855Faults::Fault::NONE;
+  if (level == HOT_JUNCTION_FAULT_LEVEL) {
+    entry.faults = value;
+  } else {
+    this->_state.hotJunction += TemperatureLog::unzigzag(value);
+    if (!this->readCode(COLD_JUNCTION_WIDTHS, COLD_JUNCTION_LEVELS, level, value)) {
+      return false;
+    }
+    this->_state.coldJunction += TemperatureLog::unzigzag(value);
+  }
+  entry.hotJunction = this->_state.hotJunction;
+  entry.coldJunction = this->_state.coldJunction;
+  entry.epoch = this->_header.epochOffsetMs != 0;
+  entry.timestampMs = this->_header.epochOffsetMs + this->_state.timestampMs;
+  return true;
+}
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <FS.h>
+#include <atomic>
+#include <PitBoss/MAX31855.h>
+#include <PitBoss/StatefulThermocouple.h>
+
+namespace PitBoss {
+
+/**
+ * Whole-cook temperature log on SPIFFS.
+ *
+ * Samples are written to fixed-size segment files, each a header followed by
+ * a bit stream. Per sample the stream holds the delta-of-delta of its
+ * timestamp and the deltas of the raw hot and cold junction readings, each as
+ * a short prefix code choosing the payload width. A regular sample at a
+ * steady temperature costs three bits, so a 16 hour cook at 1 Hz fits in a
+ * few tens of KB.
+ *
+ * Segments take MAX_SEGMENTS slots in turn and the oldest is deleted to make
+ * room, so no file is rewritten in place. Encoded bytes are held in RAM and
+ * appended every FLUSH_INTERVAL_MS, or on flush() before sleeping. Each boot
+ * starts a new segment.
+ */
+class TemperatureLog {
+ public:
+  static const uint32_t SEGMENT_SIZE = 4096;
+  static const uint32_t MAX_SEGMENTS = 48;
+  static const uint32_t FLUSH_INTERVAL_MS = 60 * 1000;
+  constexpr static const char* SEGMENT_PATH_FORMAT = "/log%02u.bin";
+
+  struct Entry {
+    // Milliseconds since the epoch, or since boot if the clock was not set.
+    uint64_t timestampMs;
+    bool epoch;
+    uint8_t faults;
+    int16_t hotJunction;
+    int16_t coldJunction;
+  };
+
+  struct Stats {
+    uint32_t segments;
+    uint32_t samples;
+    uint32_t bytesWritten;
+    uint32_t flushes;
+    uint32_t writeErrors;
+  };
+
+ protected:
+  static const uint32_t MAGIC = 0x314C4250;
+  static const size_t PENDING_SIZE = 256;
+  static const uint8_t MAX_SAMPLE_BITS = 4 + 32 + 5 + 16 + 4 + 16;
+
+  struct SegmentHeader {
+    uint32_t magic;
+    uint32_t id;
+    // Wall clock minus uptime when the segment was opened, 0 if unknown.
+    int64_t epochOffsetMs;
+    uint32_t startMs;
+    uint32_t intervalMs;
+  };
+
+  // Running values both the encoder and decoder deltas are taken against.
+  struct CodecState {
+    uint32_t timestampMs;
+    int32_t timestampDeltaMs;
+    int16_t hotJunction;
+    int16_t coldJunction;
+  };
+
+ public:
+  /**
+   * Decodes the log oldest first, one segment open at a time, so a whole cook
+   * can be streamed out with a few dozen bytes of state. Entries still held in
+   * RAM by the writer (at most FLUSH_INTERVAL_MS) are not visible.
+   */
+  class Scanner {
+   protected:
+    const TemperatureLog* _log;
+    uint64_t _fromMs;
+    uint64_t _toMs;
+    uint32_t _segment;
+    bool _open = false;
+    File _file;
+    SegmentHeader _header;
+    CodecState _state;
+    uint8_t _buffer[64];
+    size_t _length = 0;
+    size_t _bit = 0;
+
+   public:
+    Scanner(const TemperatureLog* log, uint64_t fromMs = 0, uint64_t toMs = UINT64_MAX);
+    bool next(Entry& entry);
+
+   protected:
+    bool openNext();
+    bool readBits(uint8_t count, uint32_t& value);
+    bool readCode(const uint8_t* widths, uint8_t levels, uint8_t& level, uint32_t& value);
+    bool decode(Entry& entry);
+  };
+
+ protected:
+  uint32_t _intervalMs = 0;
+  std::atomic<uint32_t> _firstSegment{0};
+  std::atomic<uint32_t> _nextSegment{0};
+  bool _segmentOpen = false;
+  SegmentHeader _header;
+  CodecState _state;
+  uint32_t _segmentBytes = 0;
+  uint8_t _pending[PENDING_SIZE];
+  uint32_t _pendingBits = 0;
+  unsigned long _lastFlush = 0;
+  Stats _stats = {};
+
+ public:
+  void begin(uint32_t intervalMs);
+  void append(const ThermocoupleSample& sample);
+  // Writes out everything encoded so far and closes the segment, e.g. before
+  // deep sleep. The next sample opens a new one.
+  void flush();
+
+  Scanner scan(uint64_t fromMs = 0, uint64_t toMs = UINT64_MAX) const {
+    return Scanner(this, fromMs, toMs);
+  }
+  Stats getStats() const {
+    auto stats = this->_stats;
+    stats.segments = this->_nextSegment.load() - this->_firstSegment.load();
+    return stats;
+  }
+
+ protected:
+  static String segmentPath(uint32_t id);
+  static uint32_t zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+  }
+  static int32_t unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+  }
+
+  bool openSegment(uint32_t startMs, int64_t epochOffsetMs);
+  void closeSegment();
+  bool makeRoom(uint32_t id);
+  void writeBits(uint32_t value, uint8_t count);
+  void writeCode(const uint8_t* widths, uint8_t levels, uint8_t level, uint32_t value);
+  void writeDelta(const uint8_t* widths, uint8_t levels, uint8_t valueLevels, int32_t delta);
+  void writePending(bool pad);
+};
+
+}
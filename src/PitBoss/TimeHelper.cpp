@@ -3,17 +3,19 @@
 
 namespace PitBoss {
 
-String getTime(const char * format = "%c") {
-  time_t rawTime;
-  time(&rawTime);
-  tm * localTime;
-  localTime = localtime(&rawTime);
-  int size = 64;
-  char * buffer = new char[size];
-  while (0 == strftime(buffer, size, format, localTime)) {
-    size *= 2;
-    buffer = new char[size];
+size_t formatTime(char* buffer, size_t size, const char* format, time_t time) {
+  tm localTime;
+  localtime_r(&time, &localTime);
+  auto length = strftime(buffer, size, format, &localTime);
+  if (length == 0 && size) {
+    buffer[0] = '\0';
   }
+  return length;
+}
+
+String getTime(const char * format = "%c") {
+  char buffer[64];
+  formatTime(buffer, sizeof(buffer), format, time(nullptr));
   return String(buffer);
 }
 
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <ctime>
+
 namespace PitBoss {
 
+// Anything earlier means NTP has not set the clock yet.
+static const time_t MIN_VALID_EPOCH = 1577836800;
+
 String getTime(const char * format = "%c");
 
+// strftime of a local time into buffer, without touching the heap.
+size_t formatTime(char* buffer, size_t size, const char* format, time_t time);
+
 }
\ No newline at end of file
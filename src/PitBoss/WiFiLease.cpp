@@ -0,0 +1,69 @@
+#include <PitBoss/WiFiLease.h>
+#include <Preferences.h>
+#include <cstring>
+
+namespace PitBoss {
+
+namespace {
+
+RTC_DATA_ATTR WiFiLease rtcLease;
+
+uint32_t fnv1a(const void* data, size_t length) {
+  auto bytes = static_cast<const uint8_t*>(data);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+}
+
+bool WiFiLease::valid() const {
+  return this->magic == WiFiLease::MAGIC && this->checksum == fnv1a(this, offsetof(WiFiLease, checksum));
+}
+
+void WiFiLease::seal() {
+  this->magic = WiFiLease::MAGIC;
+  this->reserved = 0;
+  this->checksum = fnv1a(this, offsetof(WiFiLease, checksum));
+}
+
+bool WiFiLease::load(WiFiLease& lease) {
+  if (rtcLease.valid()) {
+    lease = rtcLease;
+    return true;
+  }
+  Preferences preferences;
+  preferences.begin(WiFiLease::NVS_NAMESPACE, true);
+  auto length = preferences.getBytes(WiFiLease::NVS_KEY, &lease, sizeof(lease));
+  preferences.end();
+  if (length != sizeof(lease) || !lease.valid()) {
+    return false;
+  }
+  rtcLease = lease;
+  return true;
+}
+
+void WiFiLease::save(WiFiLease& lease) {
+  lease.seal();
+  rtcLease = lease;
+  WiFiLease stored;
+  Preferences preferences;
+  preferences.begin(WiFiLease::NVS_NAMESPACE, false);
+  if (preferences.getBytes(WiFiLease::NVS_KEY, &stored, sizeof(stored)) != sizeof(stored) ||
+      memcmp(&stored, &lease, sizeof(lease)) != 0) {
+    preferences.putBytes(WiFiLease::NVS_KEY, &lease, sizeof(lease));
+  }
+  preferences.end();
+}
+
+void WiFiLease::clear() {
+  memset(&rtcLease, 0, sizeof(rtcLease));
+  Preferences preferences;
+  preferences.begin(WiFiLease::NVS_NAMESPACE, false);
+  preferences.remove(WiFiLease::NVS_KEY);
+  preferences.end();
+}
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace PitBoss {
+
+/**
+ * The access point and IP configuration of the last good connection, so the
+ * next one can skip the scan and DHCP: a direct connect to the BSSID on its
+ * channel with the same address set statically.
+ *
+ * Kept in RTC slow memory, which survives deep sleep, and in NVS, which
+ * survives power loss; NVS is only written when the lease changes.
+ */
+struct WiFiLease {
+  static const uint32_t MAGIC = 0x4C465750;
+  constexpr static const char* NVS_NAMESPACE = "pitboss";
+  constexpr static const char* NVS_KEY = "wifiLease";
+
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  // FNV-1a of the fields above.
+  uint32_t checksum;
+
+  bool valid() const;
+  // Sets magic and checksum.
+  void seal();
+
+  // From RTC memory, else from NVS.
+  static bool load(WiFiLease& lease);
+  static void save(WiFiLease& lease);
+  static void clear();
+};
+
+}
@@ -1,14 +1,18 @@
 #include <Arduino.h>
 #include <PitBoss/App.h>
+#include <PitBoss/SleepLog.h>
 
 using namespace PitBoss;
 
 App* pitboss;
 void setup() {
+  // Returns unless this is a sleep log wake, before the App costs anything.
+  SleepLog::wake();
   pitboss = new App();
   pitboss->setup();
 }
 
 void loop() {
   pitboss->process();
+  pitboss->idle();
 }
@@ -0,0 +1,608 @@
+#include <Arduino.h>
+#include <PitBoss/App.h>
+#include <PitBoss/Hal/Simulation.h>
+#include <PitBoss/SleepLog.h>
+#include <SPIFFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <getopt.h>
+#include <map>
+#include <unistd.h>
+#include <vector>
+
+using namespace PitBoss;
+
+/**
+ * Host benchmark for the App::process() loop. Runs a scripted session against
+ * the simulated hardware on a virtual clock, so every run sees exactly the
+ * same sequence of events, and reports host-side loop cost alongside the
+ * modelled bus and heap usage.
+ */
+
+using benchmarkClock = std::chrono::steady_clock;
+
+static uint64_t nanosSince(benchmarkClock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(benchmarkClock::now() - start).count();
+}
+
+class SimulatedApp : public App {
+ public:
+  // Host time of each UI task pass, if set.
+  std::vector<uint64_t>* uiNanos = nullptr;
+  // Simulated time of each UI task pass, bus waits included.
+  std::vector<uint64_t>* uiMicros = nullptr;
+
+  EventStream& events() {
+    return this->_events;
+  }
+  TemperatureLog& temperatureLog() {
+    return this->_temperatureLog;
+  }
+  AsyncWebServer& webServer() {
+    return this->_webServer;
+  }
+  StatefulThermocouple& thermocouple() {
+    return this->_thermocouple;
+  }
+  StatefulDisplay& display() {
+    return this->_display;
+  }
+  HeapMonitor& heapMonitor() {
+    return this->_heapMonitor;
+  }
+ protected:
+  void processUi() override {
+    auto start = benchmarkClock::now();
+    auto startUs = Simulation::micros();
+    App::processUi();
+    if (this->uiNanos) {
+      this->uiNanos->push_back(nanosSince(start));
+    }
+    if (this->uiMicros) {
+      this->uiMicros->push_back(Simulation::micros() - startUs);
+    }
+  }
+};
+
+struct Event {
+  unsigned long atMs;
+  const char* name;
+  std::function<void()> action;
+};
+
+/**
+ * An EventSource client on /events. Slow ones only read every
+ * pumpIntervalMs, fall behind the event ring and get dropped, then reconnect
+ * as a browser would.
+ */
+struct Subscriber {
+  unsigned long pumpIntervalMs;
+  std::unique_ptr<AsyncWebServer::SimulatedStream> stream;
+  unsigned long nextPump = 0;
+  unsigned long connects = 0;
+  unsigned long drops = 0;
+  unsigned long events = 0;
+  unsigned long bytes = 0;
+};
+
+struct Options {
+  unsigned long durationMs = 40 * 1000;
+  unsigned long tickUs = 1000;
+  unsigned long pollIntervalMs = 1000;
+  int pollClients = 2;
+  int subscribers = 2;
+  int slowSubscribers = 1;
+  bool busyPoll = false;
+  bool verbose = false;
+  // Sleep log wakes to run instead of the session.
+  unsigned long sleepLogWakes = 0;
+  // Thermocouple noise in C, with a spike every SPIKE_EVERY readings.
+  double noise = 0;
+};
+
+static const double HOT_JUNCTION = 107.25;
+static const unsigned SPIKE_EVERY = 7;
+static const double SPIKE = 40;
+static const double MEAT_PROBE = 60.5;
+
+static Options parseOptions(int argc, char** argv) {
+  Options options;
+  int opt;
+  while ((opt = getopt(argc, argv, "d:t:p:c:s:S:n:w:bv")) != -1) {
+    switch (opt) {
+      case 'd':
+        options.durationMs = strtoul(optarg, nullptr, 10);
+        break;
+      case 't':
+        options.tickUs = strtoul(optarg, nullptr, 10);
+        break;
+      case 'p':
+        options.pollIntervalMs = strtoul(optarg, nullptr, 10);
+        break;
+      case 'c':
+        options.pollClients = atoi(optarg);
+        break;
+      case 's':
+        options.subscribers = atoi(optarg);
+        break;
+      case 'S':
+        options.slowSubscribers = atoi(optarg);
+        break;
+      case 'n':
+        options.noise = strtod(optarg, nullptr);
+        break;
+      case 'w':
+        options.sleepLogWakes = strtoul(optarg, nullptr, 10);
+        break;
+      case 'b':
+        options.busyPoll = true;
+        break;
+      case 'v':
+        options.verbose = true;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-d durationMs] [-t tickUs] [-p pollIntervalMs] [-c pollClients] [-s subscribers] [-S slowSubscribers] [-n noise] [-w sleepLogWakes] [-b] [-v]\n", argv[0]);
+        exit(2);
+    }
+  }
+  return options;
+}
+/**
+ * What the clients and the script share with main(). They run as tasks, as
+ * AsyncTCP does on the device, so the loop is free to sleep between its own
+ * deadlines while they carry on.
+ */
+struct Session {
+  const Options* options;
+  SimulatedApp* app;
+  std::vector<Event> script;
+  std::vector<Subscriber> subscribers;
+  std::vector<String> etags;
+  std::vector<uint64_t> httpNanos;
+  std::vector<uint64_t> sseNanos;
+  std::vector<uint64_t> sseDelays;
+  String sseOut;
+  unsigned long httpOk = 0;
+  unsigned long httpNotModified = 0;
+};
+
+static void sleepUntil(unsigned long atMs) {
+  auto now = millis();
+  vTaskDelay(pdMS_TO_TICKS(atMs > now ? atMs - now : 1));
+}
+
+static void scriptTask(void* parameters) {
+  auto session = static_cast<Session*>(parameters);
+  for (auto& event : session->script) {
+    sleepUntil(event.atMs);
+    if (session->options->verbose) {
+      printf("simulation: %lu ms: %s\n", millis(), event.name);
+    }
+    event.action();
+  }
+  vTaskDelete(nullptr);
+}
+
+static void poll(Session* session) {
+  for (int i = 0; i < session->options->pollClients; i++) {
+    auto requestStart = benchmarkClock::now();
+    std::vector<AsyncWebHeader> headers;
+    if (session->etags[i].length()) {
+      headers.emplace_back("If-None-Match", session->etags[i]);
+    }
+    auto response = session->app->webServer().handle(HTTP_GET, "/temperature", String(), headers);
+    session->httpNanos.push_back(nanosSince(requestStart));
+    session->httpOk += response.code == 200;
+    session->httpNotModified += response.code == 304;
+    for (const auto& header : response.headers) {
+      if (header.name() == "ETag") {
+        session->etags[i] = header.value();
+      }
+    }
+  }
+}
+
+static void pump(Session* session, Subscriber& subscriber) {
+  auto requestStart = benchmarkClock::now();
+  if (!subscriber.stream) {
+    subscriber.stream = session->app->webServer().open("/events");
+    if (!subscriber.stream || subscriber.stream->code() != 200) {
+      subscriber.stream.reset();
+      return;
+    }
+    subscriber.connects++;
+  }
+  auto& out = session->sseOut;
+  out.clear();
+  if (!subscriber.stream->pump(out)) {
+    subscriber.stream.reset();
+    subscriber.drops++;
+  }
+  session->sseNanos.push_back(nanosSince(requestStart));
+  subscriber.bytes += out.length();
+  // Delivery delay: when the client got it against when it was sampled.
+  for (int at = out.indexOf("\"timestamp\":"); at >= 0; at = out.indexOf("\"timestamp\":", at + 1)) {
+    subscriber.events++;
+    session->sseDelays.push_back(millis() - strtoul(out.c_str() + at + 12, nullptr, 10));
+  }
+}
+
+// Pollers and EventSource clients, timed apart from the loop.
+static void clientTask(void* parameters) {
+  auto session = static_cast<Session*>(parameters);
+  unsigned long nextPoll = session->options->pollIntervalMs;
+  for (auto now = millis(); now < session->options->durationMs; now = millis()) {
+    if (now >= nextPoll) {
+      nextPoll += session->options->pollIntervalMs;
+      poll(session);
+    }
+    auto next = nextPoll;
+    for (auto& subscriber : session->subscribers) {
+      if (!session->app->webServer().running()) {
+        // Retried as soon as the server is up, like a browser would.
+        next = std::min(next, now + 1);
+        continue;
+      }
+      if (now >= subscriber.nextPump) {
+        subscriber.nextPump = now + std::max(1UL, subscriber.pumpIntervalMs);
+        pump(session, subscriber);
+      }
+      next = std::min(next, subscriber.nextPump);
+    }
+    sleepUntil(next);
+  }
+  vTaskDelete(nullptr);
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min(sorted.size() - 1, (size_t) (p * (sorted.size() - 1) + 0.5))];
+}
+
+static void reportLatency(const char* name, std::vector<uint64_t>& samples, const char* unit = "ns") {
+  std::sort(samples.begin(), samples.end());
+  uint64_t total = 0;
+  for (auto s : samples) {
+    total += s;
+  }
+  printf("%-14s n=%-8zu mean=%-8.0f p50=%-8llu p90=%-8llu p99=%-8llu p99.9=%-8llu max=%llu (%s)\n",
+         name,
+         samples.size(),
+         samples.empty() ? 0.0 : (double) total / samples.size(),
+         (unsigned long long) percentile(samples, 0.5),
+         (unsigned long long) percentile(samples, 0.9),
+         (unsigned long long) percentile(samples, 0.99),
+         (unsigned long long) percentile(samples, 0.999),
+         (unsigned long long) (samples.empty() ? 0 : samples.back()),
+         unit);
+}
+
+/**
+ * State dispatch as it was before the fixed listener tables, kept to compare
+ * against: listeners in a map of vectors, copied out on every notification.
+ */
+template<typename T_state>
+class MapStateful {
+ protected:
+  T_state _state;
+  std::map<T_state, std::vector<std::function<void(void)>>> _stateListeners;
+ public:
+  void onState(T_state state, const std::function<void(void)> &listener) {
+    this->_stateListeners[state].push_back(listener);
+  }
+  void setState(T_state state) {
+    this->_state = state;
+    if (this->_stateListeners.find(this->_state) != this->_stateListeners.end()) {
+      auto listeners = this->_stateListeners.at(this->_state);
+      for (auto &listener : listeners) {
+        listener();
+      }
+    }
+  }
+};
+
+class TableStateful : public Stateful<StatefulThermocoupleStates::State, StatefulThermocoupleStates::COUNT> {
+ public:
+  using Stateful::setState;
+  using Stateful::changeState;
+};
+
+/**
+ * Flips a state back and forth with two listeners on each, as a flapping
+ * thermocouple would, and reports host cost and heap use per notification.
+ */
+template<typename T>
+static void benchmarkDispatch(const char* name, T& stateful, std::function<void(T&, StatefulThermocoupleStates::State)> set) {
+  static const int DISPATCHES = 200000;
+  volatile unsigned long calls = 0;
+  for (auto state : {StatefulThermocoupleStates::State::ERROR, StatefulThermocoupleStates::State::READY}) {
+    stateful.onState(state, [&calls](){ calls = calls + 1; });
+    stateful.onState(state, [&calls](){ calls = calls + 1; });
+  }
+  auto allocations = Simulation::heap().allocations;
+  auto start = benchmarkClock::now();
+  for (int i = 0; i < DISPATCHES; i++) {
+    set(stateful, i & 1 ? StatefulThermocoupleStates::State::READY : StatefulThermocoupleStates::State::ERROR);
+  }
+  auto nanos = nanosSince(start);
+  printf("%-14s %.1f ns/dispatch, %.2f allocations/dispatch\n", name,
+         (double) nanos / DISPATCHES, (double) (Simulation::heap().allocations - allocations) / DISPATCHES);
+}
+
+static void benchmarkStateful() {
+  MapStateful<StatefulThermocoupleStates::State> map;
+  TableStateful table;
+  TableStateful unchanged;
+  benchmarkDispatch<MapStateful<StatefulThermocoupleStates::State>>("state map", map, [](MapStateful<StatefulThermocoupleStates::State>& s, StatefulThermocoupleStates::State state){ s.setState(state); });
+  benchmarkDispatch<TableStateful>("state table", table, [](TableStateful& s, StatefulThermocoupleStates::State state){ s.setState(state); });
+  benchmarkDispatch<TableStateful>("state no-op", unchanged, [](TableStateful& s, StatefulThermocoupleStates::State state){ s.changeState(StatefulThermocoupleStates::State::READY); });
+}
+
+/**
+ * Sleep log mode on its own, as the device runs it: entered as the button
+ * would, then each timer wake runs SleepLog::cycle() as setup() would and the
+ * virtual clock sleeps until the next. The pit climbs past the high alarm
+ * halfway through. The simulated clock only moves for WiFi, so reading wakes
+ * are timed on the host and by their SPI bus time.
+ */
+static void benchmarkSleepLog(const Options& options) {
+  static const int INTERVAL_MS = 30 * 1000;
+  Config config;
+  config.sleepLogInterval = INTERVAL_MS;
+  config.sleepLogAlarmHigh = HOT_JUNCTION + 10;
+  int csPins[] = {Config::DEFAULT_THERMOCOUPLE_CS_PIN};
+  Simulation::setAccessPoint(true, -67);
+  // Powered on, then put to sleep from the button.
+  SleepLog::wake();
+  SleepLog::enter(config, csPins, 1, GPIO_NUM_0, 0);
+  Simulation::advance(INTERVAL_MS);
+  Simulation::resetStats();
+  std::vector<uint64_t> readingNanos;
+  std::vector<uint64_t> uplinkMicros;
+  uint64_t readingSpiUs = 0;
+  for (unsigned long i = 0; i < options.sleepLogWakes; i++) {
+    if (i == options.sleepLogWakes / 2) {
+      Simulation::setThermocouple(HOT_JUNCTION + 20, 22.5);
+    }
+    auto uplinks = SleepLog::getStats().uplinkWakes;
+    auto spiUs = Simulation::spi().busyMicros;
+    auto start = benchmarkClock::now();
+    auto wokeAt = Simulation::micros();
+    auto sleepUs = SleepLog::cycle(wokeAt);
+    if (SleepLog::getStats().uplinkWakes != uplinks) {
+      uplinkMicros.push_back(Simulation::micros() - wokeAt);
+    } else {
+      readingNanos.push_back(nanosSince(start));
+      readingSpiUs += Simulation::spi().busyMicros - spiUs;
+    }
+    Simulation::advanceMicros(sleepUs);
+  }
+  auto stats = SleepLog::getStats();
+  auto& network = Simulation::network();
+  printf("sleep log      %u wakes every %d ms, %u uploading (%u on alarm), %u datagrams, %lu B, %u dropped, %u pending\n",
+         stats.wakes, INTERVAL_MS, stats.uplinkWakes, stats.alarms, (unsigned) network.udpPackets, network.udpBytes,
+         stats.dropped, stats.pending);
+  reportLatency("reading wake", readingNanos);
+  printf("reading spi    %.1f us/wake\n", readingNanos.empty() ? 0.0 : (double) readingSpiUs / readingNanos.size());
+  reportLatency("uplink wake", uplinkMicros, "us");
+  printf("energy         %.1f uJ/sample awake, %.1f uJ/sample asleep (modelled at %u mV)\n",
+         stats.wakes ? (double) stats.awakeEnergyUj / stats.wakes : 0.0,
+         stats.wakes ? (double) stats.asleepEnergyUj / stats.wakes : 0.0, SleepLog::SUPPLY_MV);
+}
+
+int main(int argc, char** argv) {
+  auto options = parseOptions(argc, argv);
+  // Start from empty flash so earlier sessions' logs don't skew the figures.
+  char spiffsDir[] = "/tmp/pitboss-spiffs-XXXXXX";
+  bool scratchSpiffs = !getenv("PITBOSS_SPIFFS_DIR") && mkdtemp(spiffsDir);
+  if (scratchSpiffs) {
+    setenv("PITBOSS_SPIFFS_DIR", spiffsDir, 1);
+  }
+  Simulation::setSerialOutput(options.verbose ? stdout : nullptr);
+  Simulation::setThermocouple(HOT_JUNCTION, 22.5);
+  // Meat probes, if thermocoupleCsPins has any.
+  for (size_t i = 1; i < Simulation::MAX_PROBES; i++) {
+    Simulation::setProbe(i, MEAT_PROBE);
+  }
+  if (options.noise > 0) {
+    Simulation::setThermocoupleNoise(options.noise, SPIKE_EVERY, SPIKE);
+  }
+  if (options.sleepLogWakes) {
+    benchmarkSleepLog(options);
+    return 0;
+  }
+
+  Session session;
+  session.options = &options;
+  session.script = {
+    {2000, "access point up", [](){ Simulation::setAccessPoint(true, -67); }},
+    {12000, "meat probe unplugged", [](){ Simulation::unplugThermocouple(1); }},
+    {16000, "meat probe replugged", [](){ Simulation::plugThermocouple(1); }},
+    {20000, "probe unplugged", [](){ Simulation::unplugThermocouple(); }},
+    {26000, "probe replugged", [](){ Simulation::plugThermocouple(); }},
+    {33000, "button pressed", [](){ Simulation::setButton(true); }},
+    {33300, "button released", [](){ Simulation::setButton(false); }},
+  };
+
+  auto& subscribers = session.subscribers;
+  subscribers.resize(options.subscribers + options.slowSubscribers);
+  for (int i = 0; i < (int) subscribers.size(); i++) {
+    subscribers[i].pumpIntervalMs = i < options.subscribers ? 0 : 15 * 1000;
+  }
+  session.etags.resize(options.pollClients);
+
+  std::vector<uint64_t> loopNanos;
+  std::vector<uint64_t> uiNanos;
+  std::vector<uint64_t> uiMicros;
+  loopNanos.reserve(options.durationMs * 1000 / options.tickUs + 1);
+  uiNanos.reserve(options.durationMs + 1);
+  uiMicros.reserve(options.durationMs + 1);
+  session.httpNanos.reserve(options.durationMs / options.pollIntervalMs * options.pollClients + 1);
+  session.sseNanos.reserve(options.durationMs * subscribers.size() + 1);
+  session.sseDelays.reserve(options.durationMs / 1000 * subscribers.size() + 1);
+  session.sseOut.reserve(AsyncChunkedResponse::CHUNK_SIZE);
+
+  using clock = benchmarkClock;
+  // Everything the benchmark itself holds is allocated by now; heap figures
+  // below are relative to this point.
+  auto baseline = Simulation::heap().liveBytes;
+  auto bootStart = clock::now();
+  // As setup() does; the simulation boots from power on, so it returns.
+  SleepLog::wake();
+  auto app = new SimulatedApp();
+  session.app = app;
+  app->uiNanos = &uiNanos;
+  app->uiMicros = &uiMicros;
+  app->setup();
+  auto bootNanos = nanosSince(bootStart);
+  // Worst error of the raw and filtered hot junction against the true one.
+  static double rawError = 0;
+  static double filteredError = 0;
+  app->thermocouple().onSample([](const ThermocoupleSample& sample){
+    if (!sample.frames[0].faults()) {
+      rawError = std::max(rawError, std::abs(sample.frames[0].hotJunction().scaled() / (double) Celsius::SCALE - HOT_JUNCTION));
+      filteredError = std::max(filteredError, std::abs(sample.hotJunctions[0].scaled() / (double) Celsius::SCALE - HOT_JUNCTION));
+    }
+  });
+  auto bootHeap = Simulation::heap();
+  Simulation::resetStats();
+  xTaskCreate(scriptTask, "script", 4096, &session, 2, nullptr);
+  xTaskCreate(clientTask, "async_tcp", 8192, &session, 3, nullptr);
+
+  auto sessionStart = clock::now();
+  while (millis() < options.durationMs) {
+    auto start = clock::now();
+    app->process();
+    loopNanos.push_back(nanosSince(start));
+    if (options.busyPoll) {
+      Simulation::advanceMicros(options.tickUs);
+    } else {
+      app->idle();
+    }
+  }
+  auto sessionNanos = nanosSince(sessionStart);
+  auto simulatedMs = millis();
+  auto& httpNanos = session.httpNanos;
+  auto& sseNanos = session.sseNanos;
+  auto& sseDelays = session.sseDelays;
+
+  // One full history download followed by an incremental one from the
+  // cursor it returned, as a dashboard would on page load then refresh.
+  auto historyStart = clock::now();
+  auto history = app->webServer().handle(HTTP_GET, "/history");
+  auto historyNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - historyStart).count();
+  if (options.verbose) {
+    printf("simulation: /history: %s\n", history.body.c_str());
+  }
+  auto next = history.body.indexOf("\"next\":");
+  String since = next < 0 ? String("0") : String(strtoul(history.body.c_str() + next + 7, nullptr, 10));
+  Simulation::advance(app->thermocouple().getReadInterval() * 3);
+  app->process();
+  auto incremental = app->webServer().handle(HTTP_GET, String("/history?since=") + since);
+  app->temperatureLog().flush();
+  auto logStart = clock::now();
+  auto log = app->webServer().handle(HTTP_GET, "/log");
+  auto logNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - logStart).count();
+  if (options.verbose) {
+    printf("simulation: /log:\n%s", log.body.c_str());
+  }
+
+  uint64_t loopTotal = 0;
+  for (auto n : loopNanos) {
+    loopTotal += n;
+  }
+  auto heap = Simulation::heap();
+  auto& spi = Simulation::spi();
+  auto& i2c = Simulation::i2c();
+  auto& network = Simulation::network();
+
+  auto dutyCycle = app->getDutyCycleStats();
+  if (options.busyPoll) {
+    printf("session        %lu ms simulated, busy polling every %lu us, %zu iterations\n", simulatedMs, options.tickUs, loopNanos.size());
+  } else {
+    printf("session        %lu ms simulated, scheduled, %zu iterations (%.1f/s), %u woken early\n",
+           simulatedMs, loopNanos.size(), loopNanos.size() * 1000.0 / simulatedMs, dutyCycle.eventWakeups);
+  }
+  printf("ui task        %zu passes (%.1f/s)\n", uiNanos.size(), uiNanos.size() * 1000.0 / simulatedMs);
+  printf("boot           %.3f ms, heap %zu B live\n", bootNanos / 1e6, bootHeap.liveBytes - baseline);
+  printf("throughput     %.0f iterations/s (loop only), %.0f iterations/s (wall)\n",
+         loopTotal ? loopNanos.size() * 1e9 / loopTotal : 0.0,
+         sessionNanos ? loopNanos.size() * 1e9 / sessionNanos : 0.0);
+  reportLatency("loop", loopNanos);
+  reportLatency("ui", uiNanos);
+  reportLatency("ui simulated", uiMicros, "us");
+  reportLatency("http", httpNanos);
+  printf("http           %lu requests, %lu ok, %lu not modified\n", network.httpRequests, session.httpOk, session.httpNotModified);
+  reportLatency("sse pump", sseNanos);
+  std::sort(sseDelays.begin(), sseDelays.end());
+  auto events = app->events().getStats();
+  printf("sse            %u published, %u subscribers open, %u dropped; delivery delay p50=%llu max=%llu (ms)\n",
+         events.published, events.subscribers, events.droppedSubscribers,
+         (unsigned long long) percentile(sseDelays, 0.5), (unsigned long long) (sseDelays.empty() ? 0 : sseDelays.back()));
+  for (size_t i = 0; i < subscribers.size(); i++) {
+    auto& subscriber = subscribers[i];
+    printf("  subscriber %zu %-5s %lu connects, %lu drops, %lu events, %lu B\n",
+           i, subscriber.pumpIntervalMs ? "slow" : "fast", subscriber.connects, subscriber.drops, subscriber.events, subscriber.bytes);
+  }
+  printf("history        full %d %u B in %.3f ms, incremental %d %u B\n",
+         history.code, history.body.length(), historyNanos / 1e6, incremental.code, incremental.body.length());
+  auto logStats = app->temperatureLog().getStats();
+  printf("flash log      %u samples in %u B (%.1f bits/sample), %u segments, %u flushes, %u errors; export %d %u B in %.3f ms\n",
+         logStats.samples, logStats.bytesWritten, logStats.samples ? logStats.bytesWritten * 8.0 / logStats.samples : 0.0,
+         logStats.segments, logStats.flushes, logStats.writeErrors, log.code, log.body.length(), logNanos / 1e6);
+  printf("heap           %zu B live, %zu B peak, %lu allocations (%.2f/s), %lu frees\n",
+         heap.liveBytes - baseline, heap.peakBytes - baseline, heap.allocations,
+         heap.allocations * 1000.0 / simulatedMs, heap.frees);
+  HeapSiteStats sites[HeapMonitor::MAX_SITES];
+  auto siteCount = app->heapMonitor().getSiteStats(sites, HeapMonitor::MAX_SITES);
+  for (size_t i = 0; i < siteCount; i++) {
+    if (sites[i].calls) {
+      printf("  %-12s %7u calls, %5u allocations (%.3f/call), %u once settled\n",
+             sites[i].name, sites[i].calls, sites[i].allocations,
+             (double) sites[i].allocations / sites[i].calls, sites[i].steadyStateAllocations);
+    }
+  }
+  auto sampling = app->thermocouple().getSamplingStats();
+  printf("sampling       %u samples, %u reads, %u missed deadlines, %u dropped, jitter mean=%u max=%u (us)\n",
+         sampling.samples, sampling.reads, sampling.missedDeadlines, sampling.droppedSamples, sampling.meanJitterUs, sampling.maxJitterUs);
+  FilterStageStats filterStats[ThermocoupleFilter::STAGES];
+  auto stages = app->thermocouple().getFilterStats(filterStats, ThermocoupleFilter::STAGES);
+  printf("filter         max error raw=%.2f filtered=%.2f (C);", rawError, filteredError);
+  for (size_t i = 0; i < stages; i++) {
+    if (filterStats[i].enabled) {
+      printf(" %s %u updates, %u cycles/update;", filterStats[i].name, filterStats[i].updates, filterStats[i].meanCycles);
+    }
+  }
+  printf("\n");
+  printf("spi            %lu transactions, %lu B, %lu us bus time (%.1f transactions/sweep)\n",
+         spi.transactions, spi.bytes, spi.busyMicros,
+         sampling.reads ? (double) spi.transactions / sampling.reads : 0.0);
+  printf("i2c            %lu transactions, %lu B, %lu us bus time (%.1f us/ui pass)\n",
+         i2c.transactions, i2c.bytes, i2c.busyMicros,
+         uiNanos.empty() ? 0.0 : (double) i2c.busyMicros / uiNanos.size());
+  auto display = app->display().getStats();
+  printf("display        %u frames, %u unchanged, %u coalesced, %u widget renders\n",
+         display.frames, display.unchangedFrames, display.coalescedFrames, display.widgetRenders);
+  printf("display flush  %u flushes, %u dropped, %u B (%.1f B/flush), %.1f us/flush\n",
+         display.flushes, display.droppedFrames, display.bytesSent,
+         display.flushes ? (double) display.bytesSent / display.flushes : 0.0,
+         display.flushes ? (double) display.flushUs / display.flushes : 0.0);
+  printf("udp            %lu packets, %lu B\n", network.udpPackets, network.udpBytes);
+  printf("serial         %lu B\n", network.serialBytes);
+  benchmarkStateful();
+  // Host threads hide stack use, so stackFree is the configured depth here.
+  TaskStats tasks[8];
+  auto taskCount = app->getTaskStats(tasks, 8);
+  for (size_t i = 0; i < taskCount; i++) {
+    printf("task %-10s core %d, priority %u, %u B stack\n", tasks[i].name, (int) tasks[i].core, tasks[i].priority, tasks[i].stackFree);
+  }
+  if (scratchSpiffs) {
+    SPIFFS.format();
+    rmdir(spiffsDir);
+  }
+  return 0;
+}